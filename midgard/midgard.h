@@ -47,5 +47,7 @@
 #include <midgard/midgard_blob.h>
 #include <midgard/midgard_dbus.h>
 #include <midgard/midgard_sitegroup.h>
+#include <midgard/midgard_index_advisor.h>
+#include <midgard/midgard_query_profiler.h>
 
 #endif /* _MIDGARD_API_H_ */
@@ -476,4 +476,32 @@ extern void midgard_collector_count(
 extern gboolean midgard_collector_execute(
 	MidgardCollector *self);
 
+/**
+ * \ingroup mc
+ *
+ * Function invoked when asynchronous collector's query is executed.
+ *
+ * \param self, MidgardCollector instance
+ * \param executed, the same value #midgard_collector_execute returns
+ * \param user_data, data passed to #midgard_collector_execute_async
+ */
+typedef void (*MidgardCollectorExecuteFunc) (MidgardCollector *self,
+		gboolean executed, gpointer user_data);
+
+/**
+ * \ingroup mc
+ *
+ * Executes collector without blocking caller.
+ *
+ * \param self, MidgardCollector instance
+ * \param context, GMainContext to dispatch result to, or NULL for default one
+ * \param func, function invoked when collector is filled with results
+ * \param user_data, data passed to func
+ * \return TRUE if query has been queued, FALSE otherwise
+ *
+ * See #midgard_connection_query_async for details.
+ */
+extern gboolean midgard_collector_execute_async(MidgardCollector *self,
+		GMainContext *context, MidgardCollectorExecuteFunc func, gpointer user_data);
+
 #endif /* MIDGARD_COLLECTOR_H */
@@ -382,4 +382,56 @@ extern gboolean                midgard_connection_is_enabled_dbus              (
 
 extern void midgard_connection_unref_implicit_user(MidgardConnection *mgd);
 
+/**
+ * \ingroup midgard_connection
+ *
+ * Function invoked when asynchronous query is executed.
+ *
+ * \param mgd, MidgardConnection instance
+ * \param res, query's result or NULL if query returned no rows
+ * \param executed, FALSE if query failed
+ * \param user_data, data passed to #midgard_connection_query_async
+ *
+ * Result is a legacy result handle, the same one returned by mgd_query.
+ * Caller is responsible to release it with mgd_release.
+ */
+typedef void (*MidgardConnectionQueryFunc) (MidgardConnection *mgd, 
+		midgard_res *res, gboolean executed, gpointer user_data);
+
+/**
+ * \ingroup midgard_connection
+ *
+ * Executes SQL query without blocking caller.
+ *
+ * \param self, MidgardConnection instance
+ * \param sql, SQL query
+ * \param context, GMainContext to dispatch result to, or NULL for default one
+ * \param func, function invoked with query's result
+ * \param user_data, data passed to func
+ * \return TRUE if query has been queued, FALSE otherwise
+ *
+ * Query is sent to database by worker thread, using its own database connection.
+ * Func is always invoked in thread which runs given context, so it's safe to 
+ * use connection and create objects there.
+ *
+ * Connection must be opened with configuration, as worker connections are 
+ * created with the same configuration's credentials.
+ * Connection must not be closed while any query is in flight.
+ */
+extern gboolean midgard_connection_query_async(MidgardConnection *self, const gchar *sql,
+		GMainContext *context, MidgardConnectionQueryFunc func, gpointer user_data);
+
+/**
+ * \ingroup midgard_connection
+ *
+ * Sets maximal number of asynchronous queries executed at the same time.
+ *
+ * \param self, MidgardConnection instance
+ * \param workers, number of worker threads
+ *
+ * Every worker keeps its own database connection open, until connection is finalized.
+ * Default value is 4.
+ */
+extern void midgard_connection_set_async_workers(MidgardConnection *self, guint workers);
+
 #endif /* MIDGARD_CONNNECTION_H */
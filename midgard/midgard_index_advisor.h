@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MIDGARD_INDEX_ADVISOR_H
+#define MIDGARD_INDEX_ADVISOR_H
+
+#include <midgard/midgard_connection.h>
+
+/**
+ * \defgroup index_advisor Midgard Index Advisor
+ *
+ * Index advisor collects statistics of properties used in query builders'
+ * constraints and orders, and suggests indexes for tables which are
+ * queried often (or slowly) by properties which are not indexed.
+ */
+
+typedef struct _MidgardIndexAdvice MidgardIndexAdvice;
+
+/**
+ * \ingroup index_advisor
+ *
+ * Suggested index.
+ */
+struct _MidgardIndexAdvice {
+	gchar *classname;	/**< name of class which was queried */
+	gchar *table;		/**< table which should be indexed */
+	gchar *columns;		/**< coma separated columns, in suggested index' order */
+	guint hits;		/**< number of queries which used these columns */
+	gdouble total_time;	/**< total execution time of these queries, in seconds */
+	gdouble max_time;	/**< the longest execution time, in seconds */
+};
+
+/**
+ * \ingroup index_advisor
+ *
+ * Enables or disables statistics' collection.
+ *
+ * \param toggle, TRUE to enable, FALSE to disable
+ *
+ * Statistics are not collected by default.
+ */
+extern void midgard_index_advisor_enable(gboolean toggle);
+
+/**
+ * \ingroup index_advisor
+ *
+ * Discards all collected statistics.
+ */
+extern void midgard_index_advisor_reset(void);
+
+/**
+ * \ingroup index_advisor
+ *
+ * Get suggested indexes.
+ *
+ * \param mgd, MidgardConnection instance
+ * \param min_hits, ignore column sets used less than min_hits times
+ * \param[out] n_advice, number of returned elements
+ * \return NULL terminated array of advice, or NULL
+ *
+ * Advice is sorted by total execution time, the most expensive first.
+ * Column sets which are already covered by existing table's index are
+ * not returned. Free returned array with #midgard_index_advisor_free_advice.
+ */
+extern MidgardIndexAdvice **midgard_index_advisor_get_advice(
+		MidgardConnection *mgd, guint min_hits, guint *n_advice);
+
+/**
+ * \ingroup index_advisor
+ *
+ * Frees array returned by #midgard_index_advisor_get_advice.
+ */
+extern void midgard_index_advisor_free_advice(MidgardIndexAdvice **advice);
+
+/**
+ * \ingroup index_advisor
+ *
+ * Creates suggested index.
+ *
+ * \param mgd, MidgardConnection instance
+ * \param advice, MidgardIndexAdvice to apply
+ * \return TRUE if index has been created or it exists already, FALSE otherwise
+ */
+extern gboolean midgard_index_advisor_apply(
+		MidgardConnection *mgd, MidgardIndexAdvice *advice);
+
+#endif /* MIDGARD_INDEX_ADVISOR_H */
@@ -429,6 +429,17 @@ MGD_API int mgd_copy_object(midgard * mgd, midgard_res * object,
 MGD_API int mgd_move_object(midgard * mgd, const char *table,
 			   const char *upfield, int id, int newup);
 
+/* Moves n records of table, ids[i] to uplink newups[i], in one transaction.
+   Tree is loaded once and all moves are validated together: nothing is
+   moved if any record or uplink does not exist, or if moves would make
+   the tree circular. Database failure during moves is rolled back only
+   if table uses transactional storage engine (InnoDB), records moved
+   before failure stay moved with MyISAM.
+   Returns number of moved records or -1 on failure.
+*/
+MGD_API int mgd_move_objects(midgard * mgd, const char *table,
+			   const char *upfield, const int *ids, const int *newups, int n);
+
 /* Copies topic sub-tree with included articles and return ID of copy 
    of root topic
 */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MIDGARD_QUERY_PROFILER_H
+#define MIDGARD_QUERY_PROFILER_H
+
+#include <glib.h>
+
+/**
+ * \defgroup query_profiler Midgard Query Profiler
+ *
+ * Query profiler measures every SQL query executed by query builder,
+ * collector and legacy mgd_query / mgd_exec functions.
+ * Recent profiles are kept in fixed size ring buffer, and every profile
+ * is also passed to optional hook function.
+ */
+
+/**
+ * \ingroup query_profiler
+ *
+ * API which executed query.
+ */
+typedef enum {
+	MIDGARD_QUERY_ORIGIN_BUILDER = 0,	/**< MidgardQueryBuilder */
+	MIDGARD_QUERY_ORIGIN_COLLECTOR,		/**< MidgardCollector */
+	MIDGARD_QUERY_ORIGIN_LEGACY		/**< mgd_query, mgd_exec and other legacy functions */
+} MidgardQueryOrigin;
+
+typedef struct _MidgardQueryProfile MidgardQueryProfile;
+
+/**
+ * \ingroup query_profiler
+ *
+ * Single query's profile.
+ */
+struct _MidgardQueryProfile {
+	gchar *sql;			/**< executed SQL query */
+	MidgardQueryOrigin origin;	/**< API which executed query */
+	gdouble seconds;		/**< wall time of query execution and results' transfer */
+	guint64 rows;			/**< number of returned (or affected) rows */
+	guint64 bytes;			/**< number of bytes of returned data */
+	gboolean slow;			/**< TRUE if query exceeded slow threshold */
+	gchar *explain;			/**< EXPLAIN output of slow SELECT query, NULL otherwise */
+};
+
+/**
+ * \ingroup query_profiler
+ *
+ * Function invoked for every profiled query.
+ * Profile is owned by profiler and valid only during this call.
+ */
+typedef void (*MidgardQueryProfileFunc) (const MidgardQueryProfile *profile, gpointer user_data);
+
+/**
+ * \ingroup query_profiler
+ *
+ * Enables or disables profiling. Queries are not profiled by default.
+ */
+extern void midgard_query_profiler_enable(gboolean toggle);
+
+/**
+ * \ingroup query_profiler
+ *
+ * Sets slow queries' threshold.
+ *
+ * \param seconds, minimal execution time of slow query, 0 disables EXPLAIN capture
+ *
+ * EXPLAIN output is captured for every SELECT query slower than threshold.
+ * Default threshold is 1 second.
+ */
+extern void midgard_query_profiler_set_slow_threshold(gdouble seconds);
+
+/**
+ * \ingroup query_profiler
+ *
+ * Sets ring buffer's size. Already collected profiles are discarded.
+ * Default size is 100 profiles.
+ */
+extern void midgard_query_profiler_set_buffer_size(guint size);
+
+/**
+ * \ingroup query_profiler
+ *
+ * Sets function invoked for every profiled query.
+ *
+ * \param func, MidgardQueryProfileFunc or NULL to remove hook
+ * \param user_data, data passed to func
+ */
+extern void midgard_query_profiler_set_hook(MidgardQueryProfileFunc func, gpointer user_data);
+
+/**
+ * \ingroup query_profiler
+ *
+ * Get profiles kept in ring buffer.
+ *
+ * \param[out] n_profiles, number of returned profiles
+ * \return NULL terminated array of profiles, the oldest first, or NULL
+ *
+ * Returned profiles are copies, free them with #midgard_query_profiler_free_profiles.
+ */
+extern MidgardQueryProfile **midgard_query_profiler_get_profiles(guint *n_profiles);
+
+/**
+ * \ingroup query_profiler
+ *
+ * Frees array returned by #midgard_query_profiler_get_profiles.
+ */
+extern void midgard_query_profiler_free_profiles(MidgardQueryProfile **profiles);
+
+/**
+ * \ingroup query_profiler
+ *
+ * Discards all profiles kept in ring buffer.
+ */
+extern void midgard_query_profiler_reset(void);
+
+#endif /* MIDGARD_QUERY_PROFILER_H */
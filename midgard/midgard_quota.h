@@ -179,4 +179,31 @@ gboolean midgard_quota_size_is_reached(MgdObject *object, gint size);
  */ 
 guint32 midgard_quota_get_sitegroup_size(midgard *mgd, guint sg);
 
+/**
+ *
+ * \ingroup quota
+ *
+ * Writes pending quota changes to quota table.
+ *
+ * \param mgd midgard struct connection handler
+ *
+ * Quota limits and usage are kept in memory, and changes are written
+ * to quota table in batches. This function forces write. 
+ * It's called implicitly when connection is closed.
+ */
+void midgard_quota_flush(midgard *mgd);
+
+/**
+ *
+ * \ingroup quota
+ *
+ * Reloads quota limits and usage from quota table.
+ *
+ * \param mgd midgard struct connection handler
+ *
+ * Pending changes are written first. Quota records are reloaded periodically
+ * anyway, call this function to see changes made by other processes immediately.
+ */
+void midgard_quota_reconcile(midgard *mgd);
+
 #endif /* MIDGARD_QUOTA_H */
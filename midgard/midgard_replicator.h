@@ -228,6 +228,42 @@ extern gchar *midgard_replicator_export_purged(	MidgardReplicator *self,
  */ 
 extern gchar *midgard_replicator_serialize_blob( MidgardReplicator *self,
 						MgdObject *object);
+
+/**
+ * \ingroup replicator
+ *
+ * Serialize binary data to channel
+ *
+ * \param self, MidgardReplicator instance
+ * \param object, Midgard Object instance
+ * \param channel, GIOChannel opened for writing
+ *
+ * \return TRUE on success, FALSE otherwise
+ *
+ * Writes the same xml as midgard_replicator_serialize_blob() does, but reads
+ * binary data in fixed size chunks and writes every encoded chunk to 
+ * \c channel, so memory used doesn't depend on size of binary data.
+ * Channel is flushed, but not closed.
+ */
+extern gboolean midgard_replicator_serialize_blob_to_channel( MidgardReplicator *self,
+						MgdObject *object, GIOChannel *channel);
+
+/**
+ * \ingroup replicator
+ *
+ * Serialize binary data to file descriptor
+ *
+ * \param self, MidgardReplicator instance
+ * \param object, Midgard Object instance
+ * \param fd, file descriptor opened for writing
+ *
+ * \return TRUE on success, FALSE otherwise
+ *
+ * The same as midgard_replicator_serialize_blob_to_channel().
+ * Descriptor is not closed.
+ */
+extern gboolean midgard_replicator_serialize_blob_to_fd( MidgardReplicator *self,
+						MgdObject *object, gint fd);
 /**
  * \ingroup replicator
  *
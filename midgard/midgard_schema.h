@@ -149,4 +149,26 @@ extern gboolean midgard_schema_type_exists(MidgardSchema *self, const gchar *cla
  */
 extern void midgard_schema_read_file(MidgardSchema *self, const gchar *filename);
 
+/**
+ * \ingroup mgdschema
+ *
+ * Sets directory for compiled schema cache.
+ *
+ * \param dirname full directory path, or NULL to disable cache
+ *
+ * Types parsed from schema files are stored in a binary cache file, one for
+ * every file read with midgard_schema_read_file, midgard_schema_read_dir or
+ * midgard_schema_init. Cache is used instead of xml files if none of them
+ * (including included ones) has been modified since cache was written,
+ * which is checked with modification time, size and hash of contents.
+ * Cache is disabled by default. Connections opened with configuration
+ * enable it if SchemaCacheDir is configured.
+ *
+ * Strings of types loaded from cache are not copied, they point to read only
+ * memory mapped cache file. Such pages are shared by every process which
+ * reads the same cache, and by children of process which read schema before
+ * fork. 
+ */
+extern void midgard_schema_set_cache_dir(const gchar *dirname);
+
 #endif /* MIDGARD_SCHEMA_H */
@@ -43,6 +43,23 @@ extern GType midgard_timestamp_get_type(void);
  */
 extern gchar *midgard_timestamp_dup_string(const GValue *value);
 
+/**
+ * Size of buffer which holds any string written by
+ * midgard_timestamp_format().
+ */
+#define MIDGARD_TIMESTAMP_BUFFER_SIZE 64
+
+/**
+ * Writes the ISO 8601 string representation of this timestamp value
+ * to the given buffer, without allocating memory. The string is the
+ * same as returned by midgard_timestamp_dup_string().
+ *
+ * @param value timestamp value
+ * @param buf buffer of at least MIDGARD_TIMESTAMP_BUFFER_SIZE bytes
+ * @return length of written string
+ */
+extern gsize midgard_timestamp_format(const GValue *value, gchar *buf);
+
 /**
  * Parses the given string for a ISO 8601 datetime and sets the
  * given timestamp to the parsed time.
@@ -87,6 +87,32 @@ typedef struct {
 void mgd_preparse_buffer(const char *buffer, mgd_parser_itf_t *itf);
 void mgd_preparse_file(FILE *f, mgd_parser_itf_t *itf);
 
+/* Output of mgd_preparse_buffer is cached in memory, together with contents
+ * of included elements. Cached output is used when buffer and elements'
+ * contents are the same. */
+typedef struct {
+   guint64 calls;       /* mgd_preparse_buffer calls */
+   guint64 hits;        /* calls served from memory */
+   guint64 disk_hits;   /* calls served from cache directory */
+   guint64 misses;      /* calls preparsed by lexer */
+   guint64 bytes_in;    /* bytes preparsed by lexer */
+   guint64 bytes_out;   /* bytes written by lexer */
+   gdouble lex_seconds; /* time spent in lexer */
+   guint entries;       /* entries cached in memory */
+   gsize size;          /* bytes cached in memory */
+} mgd_preparse_stats_t;
+
+#define MGD_PREPARSE_CACHE_DEFAULT_SIZE (8 * 1024 * 1024)
+
+/* Sets maximal size of cache in bytes, MGD_PREPARSE_CACHE_DEFAULT_SIZE
+ * by default. 0 disables cache. */
+void mgd_preparse_cache_set_size(gsize size);
+/* Persists cached output in given directory. NULL disables persistence. */
+void mgd_preparse_cache_set_dir(const char *dirname);
+void mgd_preparse_cache_clear(void);
+void mgd_preparse_get_stats(mgd_preparse_stats_t *stats);
+void mgd_preparse_reset_stats(void);
+
 void mgd_cache_touch(midgard *mgd, long page);
 int mgd_cache_is_current(midgard *mgd, long host, long page, long style);
 
@@ -155,6 +155,27 @@ extern void midgard_query_builder_set_lang(
 extern void midgard_query_builder_toggle_read_only(
 	MidgardQueryBuilder *builder, gboolean toggle);
 
+/**
+ * \ingroup qb
+ *
+ * Selects only given properties of objects.
+ *
+ * \param builder, MidgardQueryBuilder instance
+ * \param properties, NULL terminated array of properties' names, or NULL
+ * \return TRUE on success, FALSE if any property is not stored in database
+ *
+ * Objects' guid, sitegroup, primary property and metadata are always selected.
+ * Any other property is loaded from database when it's accessed for the first time,
+ * so returned objects can be used the same way as fully selected ones.
+ * Selecting only narrow columns avoids reading wide text columns and lets 
+ * database answer query from covering index.
+ *
+ * Pass NULL to select all properties again.
+ * Projection is ignored in read only mode.
+ */
+extern gboolean midgard_query_builder_select_properties(
+	MidgardQueryBuilder *builder, const gchar **properties);
+
 /**
  * \ingroup qb
  *
@@ -387,4 +408,62 @@ const gchar *midgard_query_builder_get_type_name(MidgardQueryBuilder *builder);
  */
 extern void midgard_query_builder_include_deleted(MidgardQueryBuilder *builder);
 
+/**
+ * \ingroup qb
+ *
+ * Executes many query builders with one database round trip.
+ *
+ * \param builders, array of MidgardQueryBuilder or MidgardCollector instances
+ * \param n_builders, number of builders in array
+ * \param[out] objects, array of n_builders elements, filled with objects
+ * \param[out] holders, optional array of n_builders elements
+ * \return \c TRUE if all queries were executed, \c FALSE otherwise
+ *
+ * Every builder's query is sent to database as a single multiple statements' query.
+ * objects[i] holds NULL terminated objects returned for builders[i], the same
+ * way midgard_query_builder_execute returns them. Collectors are filled with
+ * their own results and corresponding objects' element is set to NULL.
+ * If any query fails, every element of objects is NULL: objects of queries
+ * executed before failed one are freed.
+ *
+ * All builders must be initialized for the same connection.
+ */
+extern gboolean midgard_query_builder_execute_multi(
+		MidgardQueryBuilder **builders, guint n_builders,
+		GObject ***objects, MidgardTypeHolder *holders);
+
+/**
+ * \ingroup qb
+ *
+ * Function invoked when asynchronous query builder's query is executed.
+ *
+ * \param builder, MidgardQueryBuilder instance
+ * \param objects, NULL terminated array of objects or NULL
+ * \param n_objects, number of objects in array
+ * \param user_data, data passed to #midgard_query_builder_execute_async
+ *
+ * Objects array is owned by caller, the same way it's owned when 
+ * midgard_query_builder_execute returns it. 
+ */
+typedef void (*MidgardQueryBuilderExecuteFunc) (MidgardQueryBuilder *builder,
+		GObject **objects, guint n_objects, gpointer user_data);
+
+/**
+ * \ingroup qb
+ *
+ * Executes query builder without blocking caller.
+ *
+ * \param builder, MidgardQueryBuilder instance
+ * \param context, GMainContext to dispatch result to, or NULL for default one
+ * \param func, function invoked with selected objects
+ * \param user_data, data passed to func
+ * \return TRUE if query has been queued, FALSE otherwise
+ *
+ * SQL query is created when this function is invoked, so builder might be 
+ * reused right after. Objects are created in thread which runs given context.
+ * See #midgard_connection_query_async for details.
+ */
+extern gboolean midgard_query_builder_execute_async(MidgardQueryBuilder *builder,
+		GMainContext *context, MidgardQueryBuilderExecuteFunc func, gpointer user_data);
+
 #endif
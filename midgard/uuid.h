@@ -25,7 +25,10 @@
  *
  * Type 1 UUIDs are generated using a random per-process node identifier.
  * This makes the generated UUIDs a bit less unique, but remove the need for
- * persistent state and inter-process synchronization.
+ * persistent state and inter-process synchronization. Threads share the
+ * node identifier and the clock sequence, and take strictly increasing
+ * timestamps from one shared last timestamp, advanced with atomic compare
+ * and swap instead of a lock.
  *
  * Type 3 UUIDs are generated using the special Midgard namespace UUID
  * \c 00dc46a0-0e0c-1085-82bb-0002a5d5fd2e as the namespace.
@@ -58,6 +61,21 @@ extern gboolean midgard_is_uuid(const gchar *uuid);
  */
 extern gchar *midgard_uuid_new(void);
 
+/**
+ * \ingroup uuid
+ * Size of buffer which holds UUID string, including terminating null byte.
+ */
+#define MIDGARD_UUID_BUFFER_SIZE 37
+
+/**
+ * \ingroup uuid
+ * Generates a new UUID string, the same as midgard_uuid_new() does,
+ * into the given buffer. Nothing is allocated.
+ *
+ * \param[out] uuid buffer of at least #MIDGARD_UUID_BUFFER_SIZE bytes
+ */
+extern void midgard_uuid_generate(gchar *uuid);
+
 /**
  * \ingroup uuid
  * Generates a name-based (type 3) UUID string from the given external
@@ -23,22 +23,32 @@
 #include <config.h>
 #include "midgard/midgard_legacy.h"
 #include "midgard/tablenames.h"
+#include "midgard_core_acl.h"
+
+/* Tree walks below read preloaded up, owner and reader columns
+ * (see midgard_core_acl.c), and memoise results for current user */
+#define ACL_FIELD(tree, field, id) \
+	_midgard_core_acl_idfield(mgd, MGD_ACL_TREE_##tree, MGD_ACL_FIELD_##field, id)
 
 int mgd_istopicreader(midgard *mgd, int topic)
 {
-	int reader;
+	int reader, result, id = topic;
 
 	if (mgd_isadmin(mgd))
 		return 1;
 
+	if ((result = _midgard_core_acl_lookup(mgd, MGD_ACL_TOPIC_READER, id)) != -1)
+		return result;
+
 	while (topic) {
-		reader = mgd_idfield(mgd, "reader", "topic", topic);
+		reader = ACL_FIELD(TOPIC, READER, topic);
 		if (reader)
-			return mgd_ismember(mgd, reader);
-		topic = mgd_idfield(mgd, "up", "topic", topic);
+			return _midgard_core_acl_store(mgd, MGD_ACL_TOPIC_READER, id,
+					mgd_ismember(mgd, reader));
+		topic = ACL_FIELD(TOPIC, UP, topic);
 	}
 
-	return 1;
+	return _midgard_core_acl_store(mgd, MGD_ACL_TOPIC_READER, id, 1);
 }
 
 int mgd_isarticlereader(midgard *mgd, int article)
@@ -48,88 +58,105 @@ int mgd_isarticlereader(midgard *mgd, int article)
 			 (mgd, "topic", "article", article));
 }
 
+/* Walks up the tree, TRUE if user is member of any owner */
+static int __is_tree_owner(midgard *mgd, MgdAclTree tree, int id)
+{
+	GHashTable *visited = NULL;
+	int rv = 0;
+
+	for (; id; id = _midgard_core_acl_idfield(mgd, tree, MGD_ACL_FIELD_UP, id)) {
+
+		if (mgd_ismember(mgd, _midgard_core_acl_idfield(mgd, tree, MGD_ACL_FIELD_OWNER, id))) {
+			rv = 1;
+			break;
+		}
+
+		/* Broken tree, stop at the first repeated node */
+		if (visited == NULL)
+			visited = g_hash_table_new(g_direct_hash, g_direct_equal);
+		if (g_hash_table_lookup(visited, GINT_TO_POINTER(id)))
+			break;
+		g_hash_table_insert(visited, GINT_TO_POINTER(id), GINT_TO_POINTER(1));
+	}
+
+	if (visited)
+		g_hash_table_destroy(visited);
+
+	return rv;
+}
+
 int mgd_istopicowner(midgard *mgd, int topic)
 {
+	int result;
+
 	if (mgd_isadmin(mgd))
 		return 1;
 
-	for (; topic; topic = mgd_idfield(mgd, "up", "topic", topic))
-		if (mgd_ismember(mgd,
-				 mgd_idfield(mgd, "owner", "topic",
-					     topic))) return 1;
+	if ((result = _midgard_core_acl_lookup(mgd, MGD_ACL_TOPIC_OWNER, topic)) != -1)
+		return result;
 
-	return 0;
+	return _midgard_core_acl_store(mgd, MGD_ACL_TOPIC_OWNER, topic,
+			__is_tree_owner(mgd, MGD_ACL_TREE_TOPIC, topic));
 }
 
 int mgd_issnippetdirowner(midgard *mgd, int snippetdir)
 {
+	int result;
+
 	if (mgd_isadmin(mgd))
 		return 1;
 
-	for (; snippetdir;
-	     snippetdir =
-	     mgd_idfield(mgd, "up", "snippetdir",
-			 snippetdir)) if (mgd_ismember(mgd,
-						       mgd_idfield(mgd, "owner",
-								   "snippetdir",
-								   snippetdir)))
-			   return 1;
-
-	return 0;
-}
+	if ((result = _midgard_core_acl_lookup(mgd, MGD_ACL_SNIPPETDIR_OWNER, snippetdir)) != -1)
+		return result;
 
-/* Allocate and initialize a Midgard tree node */
-#define GRP_ALLOC_TNODE(pool, node) {\
-  (node) = (grp_tree_node*)mgd_alloc(pool, sizeof(grp_tree_node));\
-  *(node) = grp_zero_node;\
+	return _midgard_core_acl_store(mgd, MGD_ACL_SNIPPETDIR_OWNER, snippetdir,
+			__is_tree_owner(mgd, MGD_ACL_TREE_SNIPPETDIR, snippetdir));
 }
-const grp_tree_node grp_zero_node = { 0, NULL, };
 
 int mgd_isgroupowner(midgard *mgd, int gid)
 {
-midgard_pool *pool;
-grp_tree_node *node, *root_node, *tmp;
-int nodes;
-pool = mgd_alloc_pool();
-GRP_ALLOC_TNODE(pool, root_node);
-nodes=0;
+	GHashTable *visited;
+	int result, id = gid;
 
 	if (mgd_isadmin(mgd))
 		return 1;
 
-   for (; gid; gid = mgd_idfield(mgd, "owner", "grp", gid)) {
-      if (mgd_ismember(mgd, gid)) {
-         return 1;
-      } else {    
-         /* look for it in the grp tree node array */
-         tmp = root_node;
-         while(tmp->child != NULL) {
-            if (tmp->id == gid) {
-               /* found it already! */
-               mgd_free_pool(pool);
-               return 0;
-            }
-
-            tmp = tmp->child;
-         }
-
-         /* ADD A NODE! */
-         GRP_ALLOC_TNODE(pool, node);       
-         tmp->id = gid;
-         tmp->child = node;
-      }      
-   }
+	if ((result = _midgard_core_acl_lookup(mgd, MGD_ACL_GROUP_OWNER, id)) != -1)
+		return result;
 
-	return 0;
+	/* Owner chain of groups might be a loop */
+	visited = g_hash_table_new(g_direct_hash, g_direct_equal);
+	result = 0;
+
+	for (; gid; gid = ACL_FIELD(GRP, OWNER, gid)) {
+		if (mgd_ismember(mgd, gid)) {
+			result = 1;
+			break;
+		}
+
+		if (g_hash_table_lookup(visited, GINT_TO_POINTER(gid)))
+			break;
+		g_hash_table_insert(visited, GINT_TO_POINTER(gid), GINT_TO_POINTER(1));
+	}
+
+	g_hash_table_destroy(visited);
+
+	return _midgard_core_acl_store(mgd, MGD_ACL_GROUP_OWNER, id, result);
 }
 
 int mgd_isgroupreader(midgard *mgd, int gid)
 {
-	return mgd_isadmin(mgd)
-	   || mgd_ismember(mgd,
-			   mgd_idfield(mgd, "owner", "grp", gid))
-	   || mgd_ismember(mgd,
-			   mgd_idfield(mgd, "reader", "grp", gid));
+	int result;
+
+	if (mgd_isadmin(mgd))
+		return 1;
+
+	if ((result = _midgard_core_acl_lookup(mgd, MGD_ACL_GROUP_READER, gid)) != -1)
+		return result;
+
+	return _midgard_core_acl_store(mgd, MGD_ACL_GROUP_READER, gid,
+			mgd_ismember(mgd, ACL_FIELD(GRP, OWNER, gid))
+			|| mgd_ismember(mgd, ACL_FIELD(GRP, READER, gid)));
 }
 
 int mgd_isuserowner(midgard *mgd, int uid)
@@ -190,19 +217,13 @@ int mgd_isarticleowner(midgard *mgd, int article)
 		return 1;
 
 	topic = mgd_idfield(mgd, "topic", "article", article);
-	while (topic) {
-		if (mgd_ismember(mgd,
-				 mgd_idfield(mgd, "owner", "topic",
-					     topic))) return 1;
-		topic = mgd_idfield(mgd, "up", "topic", topic);
-	}
 
-	return 0;
+	return mgd_istopicowner(mgd, topic);
 }
 
 int mgd_iseventowner(midgard *mgd, int event)
 {
-	int parent, locker, creator;
+	int parent, locker, creator, owner;
 
 	if (mgd_isadmin(mgd))
 		return 1;
@@ -216,13 +237,11 @@ int mgd_iseventowner(midgard *mgd, int event)
 		return 1;
 
 	parent = event;
-	while (parent) {
-		if (mgd_ismember(mgd, mgd_idfield(mgd, "owner", "event", parent)))
-			return 1;
-		parent = mgd_idfield(mgd, "up", "event", parent);
-	}
+	if ((owner = _midgard_core_acl_lookup(mgd, MGD_ACL_EVENT_OWNER, parent)) != -1)
+		return owner;
 
-	return 0;
+	return _midgard_core_acl_store(mgd, MGD_ACL_EVENT_OWNER, parent,
+			__is_tree_owner(mgd, MGD_ACL_TREE_EVENT, parent));
 }
 
 int mgd_ishostowner(midgard *mgd, int host)
@@ -300,16 +319,15 @@ int mgd_ispagecontentowner(midgard *mgd, int page, int lang) {
 #endif /* HAVE_MIDGARD_MULTILANG */
 int mgd_isstyleowner(midgard *mgd, int style)
 {
+   int result;
+
    if (mgd_isadmin(mgd)) return 1;
 
-   if (mgd_exists_id(mgd, "style", "id=$d AND owner IN $D", style, mgd_groups(mgd))) return 1;
+   if ((result = _midgard_core_acl_lookup(mgd, MGD_ACL_STYLE_OWNER, style)) != -1)
+      return result;
 
-   style = mgd_idfield(mgd, "up", "style", style);
-   while (style != 0) {
-      if (mgd_exists_id(mgd, "style", "id=$d AND owner IN $D", style, mgd_groups(mgd))) return 1;
-   }
-
-   return 0;
+   return _midgard_core_acl_store(mgd, MGD_ACL_STYLE_OWNER, style,
+         __is_tree_owner(mgd, MGD_ACL_TREE_STYLE, style));
 }
 
 int mgd_lookup_table_id(const char *table)
@@ -3,6 +3,7 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <glib.h>
 #include "md5.h"
 
 /*
@@ -54,22 +55,20 @@
 #define S43 15
 #define S44 21
 
-static void MD5Transform(unsigned int[4], const unsigned char[64]);
-static void Encode(unsigned char *, unsigned int *, unsigned int);
-static void Decode(unsigned int *, const unsigned char *, unsigned int);
-static void MD5_memcpy(void *, void *, unsigned int);
-static void MD5_memset(void *, int, unsigned int);
+static void MD5Transform(unsigned int[4], const unsigned char *);
+static void Encode(unsigned char *, const unsigned int *, unsigned int);
 
-static unsigned char PADDING[64] = {
+static const unsigned char PADDING[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
 /* F, G, H and I are basic MD5 functions.
+   F and G are rewritten with one operation less than in RFC 1321.
  */
-#define F(x, y, z) (((x) & (y)) | ((~x) & (z)))
-#define G(x, y, z) (((x) & (z)) | ((y) & (~z)))
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
 #define H(x, y, z) ((x) ^ (y) ^ (z))
 #define I(x, y, z) ((y) ^ ((x) | (~z)))
 
@@ -77,26 +76,10 @@ static unsigned char PADDING[64] = {
  */
 #define ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32-(n))))
 
-/* FF, GG, HH, and II transformations for rounds 1, 2, 3, and 4.
-   Rotation is separate from addition to prevent recomputation.
+/* STEP is the transformation of rounds 1, 2, 3 and 4 with given function.
  */
-#define FF(a, b, c, d, x, s, ac) { \
- (a) += F ((b), (c), (d)) + (x) + (unsigned int)(ac); \
- (a) = ROTATE_LEFT ((a), (s)); \
- (a) += (b); \
-  }
-#define GG(a, b, c, d, x, s, ac) { \
- (a) += G ((b), (c), (d)) + (x) + (unsigned int)(ac); \
- (a) = ROTATE_LEFT ((a), (s)); \
- (a) += (b); \
-  }
-#define HH(a, b, c, d, x, s, ac) { \
- (a) += H ((b), (c), (d)) + (x) + (unsigned int)(ac); \
- (a) = ROTATE_LEFT ((a), (s)); \
- (a) += (b); \
-  }
-#define II(a, b, c, d, x, s, ac) { \
- (a) += I ((b), (c), (d)) + (x) + (unsigned int)(ac); \
+#define STEP(f, a, b, c, d, x, s, ac) { \
+ (a) += f ((b), (c), (d)) + (x) + (unsigned int)(ac); \
  (a) = ROTATE_LEFT ((a), (s)); \
  (a) += (b); \
   }
@@ -116,12 +99,13 @@ void _MGD_MD5Init(_MGD_MD5_CTX * context)
 
 /* MD5 block update operation. Continues an MD5 message-digest
    operation, processing another message block, and updating the
-   context.
+   context. Whole blocks are transformed in place, only the
+   remainder is buffered.
  */
 void _MGD_MD5Update(_MGD_MD5_CTX * context, const unsigned char *input,
 	       unsigned int inputLen)
 {
-	unsigned int i, index, partLen;
+	unsigned int index, partLen;
 
 	/* Compute number of bytes mod 64 */
 	index = (unsigned int) ((context->count[0] >> 3) & 0x3F);
@@ -132,26 +116,29 @@ void _MGD_MD5Update(_MGD_MD5_CTX * context, const unsigned char *input,
 		context->count[1]++;
 	context->count[1] += ((unsigned int) inputLen >> 29);
 
-	partLen = 64 - index;
+	if (index > 0) {
 
-	/* Transform as many times as possible.
-	 */
-	if (inputLen >= partLen) {
-		MD5_memcpy
-		   ((void *) &context->buffer[index], (void *) input, partLen);
-		MD5Transform(context->state, context->buffer);
+		partLen = 64 - index;
+
+		if (inputLen < partLen) {
+			memcpy(&context->buffer[index], input, inputLen);
+			return;
+		}
 
-		for (i = partLen; i + 63 < inputLen; i += 64)
-			MD5Transform(context->state, &input[i]);
+		memcpy(&context->buffer[index], input, partLen);
+		MD5Transform(context->state, context->buffer);
+		input += partLen;
+		inputLen -= partLen;
+	}
 
-		index = 0;
+	while (inputLen >= 64) {
+		MD5Transform(context->state, input);
+		input += 64;
+		inputLen -= 64;
 	}
-	else
-		i = 0;
 
 	/* Buffer remaining input */
-	MD5_memcpy
-	   ((void *) &context->buffer[index], (void *) &input[i], inputLen - i);
+	memcpy(context->buffer, input, inputLen);
 }
 
 /* MD5 finalization. Ends an MD5 message-digest operation, writing the
@@ -179,109 +166,117 @@ void _MGD_MD5Final(unsigned char digest[16], _MGD_MD5_CTX * context)
 
 	/* Zeroize sensitive information.
 	 */
-	MD5_memset((void *) context, 0, sizeof (*context));
+	memset(context, 0, sizeof (*context));
 }
 
 /* MD5 basic transformation. Transforms state based on block.
+   Block doesn't need to be aligned. On little endian hosts
+   it's read as words with one memcpy.
  */
-static void MD5Transform(state, block)
-     unsigned int state[4];
-     const unsigned char block[64];
+static void MD5Transform(unsigned int state[4], const unsigned char *block)
 {
 	unsigned int a = state[0], b = state[1], c = state[2], d =
 	   state[3], x[16];
 
-	Decode(x, block, 64);
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	memcpy(x, block, 64);
+#else
+	unsigned int i;
+
+	for (i = 0; i < 16; i++, block += 4)
+		x[i] = ((unsigned int) block[0]) |
+		   (((unsigned int) block[1]) << 8) |
+		   (((unsigned int) block[2]) << 16) |
+		   (((unsigned int) block[3]) << 24);
+#endif
 
 	/* Round 1 */
-	FF(a, b, c, d, x[0], S11, 0xd76aa478);	/* 1 */
-	FF(d, a, b, c, x[1], S12, 0xe8c7b756);	/* 2 */
-	FF(c, d, a, b, x[2], S13, 0x242070db);	/* 3 */
-	FF(b, c, d, a, x[3], S14, 0xc1bdceee);	/* 4 */
-	FF(a, b, c, d, x[4], S11, 0xf57c0faf);	/* 5 */
-	FF(d, a, b, c, x[5], S12, 0x4787c62a);	/* 6 */
-	FF(c, d, a, b, x[6], S13, 0xa8304613);	/* 7 */
-	FF(b, c, d, a, x[7], S14, 0xfd469501);	/* 8 */
-	FF(a, b, c, d, x[8], S11, 0x698098d8);	/* 9 */
-	FF(d, a, b, c, x[9], S12, 0x8b44f7af);	/* 10 */
-	FF(c, d, a, b, x[10], S13, 0xffff5bb1);	/* 11 */
-	FF(b, c, d, a, x[11], S14, 0x895cd7be);	/* 12 */
-	FF(a, b, c, d, x[12], S11, 0x6b901122);	/* 13 */
-	FF(d, a, b, c, x[13], S12, 0xfd987193);	/* 14 */
-	FF(c, d, a, b, x[14], S13, 0xa679438e);	/* 15 */
-	FF(b, c, d, a, x[15], S14, 0x49b40821);	/* 16 */
+	STEP(F, a, b, c, d, x[0], S11, 0xd76aa478);	/* 1 */
+	STEP(F, d, a, b, c, x[1], S12, 0xe8c7b756);	/* 2 */
+	STEP(F, c, d, a, b, x[2], S13, 0x242070db);	/* 3 */
+	STEP(F, b, c, d, a, x[3], S14, 0xc1bdceee);	/* 4 */
+	STEP(F, a, b, c, d, x[4], S11, 0xf57c0faf);	/* 5 */
+	STEP(F, d, a, b, c, x[5], S12, 0x4787c62a);	/* 6 */
+	STEP(F, c, d, a, b, x[6], S13, 0xa8304613);	/* 7 */
+	STEP(F, b, c, d, a, x[7], S14, 0xfd469501);	/* 8 */
+	STEP(F, a, b, c, d, x[8], S11, 0x698098d8);	/* 9 */
+	STEP(F, d, a, b, c, x[9], S12, 0x8b44f7af);	/* 10 */
+	STEP(F, c, d, a, b, x[10], S13, 0xffff5bb1);	/* 11 */
+	STEP(F, b, c, d, a, x[11], S14, 0x895cd7be);	/* 12 */
+	STEP(F, a, b, c, d, x[12], S11, 0x6b901122);	/* 13 */
+	STEP(F, d, a, b, c, x[13], S12, 0xfd987193);	/* 14 */
+	STEP(F, c, d, a, b, x[14], S13, 0xa679438e);	/* 15 */
+	STEP(F, b, c, d, a, x[15], S14, 0x49b40821);	/* 16 */
 
 	/* Round 2 */
-	GG(a, b, c, d, x[1], S21, 0xf61e2562);	/* 17 */
-	GG(d, a, b, c, x[6], S22, 0xc040b340);	/* 18 */
-	GG(c, d, a, b, x[11], S23, 0x265e5a51);	/* 19 */
-	GG(b, c, d, a, x[0], S24, 0xe9b6c7aa);	/* 20 */
-	GG(a, b, c, d, x[5], S21, 0xd62f105d);	/* 21 */
-	GG(d, a, b, c, x[10], S22, 0x2441453);	/* 22 */
-	GG(c, d, a, b, x[15], S23, 0xd8a1e681);	/* 23 */
-	GG(b, c, d, a, x[4], S24, 0xe7d3fbc8);	/* 24 */
-	GG(a, b, c, d, x[9], S21, 0x21e1cde6);	/* 25 */
-	GG(d, a, b, c, x[14], S22, 0xc33707d6);	/* 26 */
-	GG(c, d, a, b, x[3], S23, 0xf4d50d87);	/* 27 */
-	GG(b, c, d, a, x[8], S24, 0x455a14ed);	/* 28 */
-	GG(a, b, c, d, x[13], S21, 0xa9e3e905);	/* 29 */
-	GG(d, a, b, c, x[2], S22, 0xfcefa3f8);	/* 30 */
-	GG(c, d, a, b, x[7], S23, 0x676f02d9);	/* 31 */
-	GG(b, c, d, a, x[12], S24, 0x8d2a4c8a);	/* 32 */
+	STEP(G, a, b, c, d, x[1], S21, 0xf61e2562);	/* 17 */
+	STEP(G, d, a, b, c, x[6], S22, 0xc040b340);	/* 18 */
+	STEP(G, c, d, a, b, x[11], S23, 0x265e5a51);	/* 19 */
+	STEP(G, b, c, d, a, x[0], S24, 0xe9b6c7aa);	/* 20 */
+	STEP(G, a, b, c, d, x[5], S21, 0xd62f105d);	/* 21 */
+	STEP(G, d, a, b, c, x[10], S22, 0x2441453);	/* 22 */
+	STEP(G, c, d, a, b, x[15], S23, 0xd8a1e681);	/* 23 */
+	STEP(G, b, c, d, a, x[4], S24, 0xe7d3fbc8);	/* 24 */
+	STEP(G, a, b, c, d, x[9], S21, 0x21e1cde6);	/* 25 */
+	STEP(G, d, a, b, c, x[14], S22, 0xc33707d6);	/* 26 */
+	STEP(G, c, d, a, b, x[3], S23, 0xf4d50d87);	/* 27 */
+	STEP(G, b, c, d, a, x[8], S24, 0x455a14ed);	/* 28 */
+	STEP(G, a, b, c, d, x[13], S21, 0xa9e3e905);	/* 29 */
+	STEP(G, d, a, b, c, x[2], S22, 0xfcefa3f8);	/* 30 */
+	STEP(G, c, d, a, b, x[7], S23, 0x676f02d9);	/* 31 */
+	STEP(G, b, c, d, a, x[12], S24, 0x8d2a4c8a);	/* 32 */
 
 	/* Round 3 */
-	HH(a, b, c, d, x[5], S31, 0xfffa3942);	/* 33 */
-	HH(d, a, b, c, x[8], S32, 0x8771f681);	/* 34 */
-	HH(c, d, a, b, x[11], S33, 0x6d9d6122);	/* 35 */
-	HH(b, c, d, a, x[14], S34, 0xfde5380c);	/* 36 */
-	HH(a, b, c, d, x[1], S31, 0xa4beea44);	/* 37 */
-	HH(d, a, b, c, x[4], S32, 0x4bdecfa9);	/* 38 */
-	HH(c, d, a, b, x[7], S33, 0xf6bb4b60);	/* 39 */
-	HH(b, c, d, a, x[10], S34, 0xbebfbc70);	/* 40 */
-	HH(a, b, c, d, x[13], S31, 0x289b7ec6);	/* 41 */
-	HH(d, a, b, c, x[0], S32, 0xeaa127fa);	/* 42 */
-	HH(c, d, a, b, x[3], S33, 0xd4ef3085);	/* 43 */
-	HH(b, c, d, a, x[6], S34, 0x4881d05);	/* 44 */
-	HH(a, b, c, d, x[9], S31, 0xd9d4d039);	/* 45 */
-	HH(d, a, b, c, x[12], S32, 0xe6db99e5);	/* 46 */
-	HH(c, d, a, b, x[15], S33, 0x1fa27cf8);	/* 47 */
-	HH(b, c, d, a, x[2], S34, 0xc4ac5665);	/* 48 */
+	STEP(H, a, b, c, d, x[5], S31, 0xfffa3942);	/* 33 */
+	STEP(H, d, a, b, c, x[8], S32, 0x8771f681);	/* 34 */
+	STEP(H, c, d, a, b, x[11], S33, 0x6d9d6122);	/* 35 */
+	STEP(H, b, c, d, a, x[14], S34, 0xfde5380c);	/* 36 */
+	STEP(H, a, b, c, d, x[1], S31, 0xa4beea44);	/* 37 */
+	STEP(H, d, a, b, c, x[4], S32, 0x4bdecfa9);	/* 38 */
+	STEP(H, c, d, a, b, x[7], S33, 0xf6bb4b60);	/* 39 */
+	STEP(H, b, c, d, a, x[10], S34, 0xbebfbc70);	/* 40 */
+	STEP(H, a, b, c, d, x[13], S31, 0x289b7ec6);	/* 41 */
+	STEP(H, d, a, b, c, x[0], S32, 0xeaa127fa);	/* 42 */
+	STEP(H, c, d, a, b, x[3], S33, 0xd4ef3085);	/* 43 */
+	STEP(H, b, c, d, a, x[6], S34, 0x4881d05);	/* 44 */
+	STEP(H, a, b, c, d, x[9], S31, 0xd9d4d039);	/* 45 */
+	STEP(H, d, a, b, c, x[12], S32, 0xe6db99e5);	/* 46 */
+	STEP(H, c, d, a, b, x[15], S33, 0x1fa27cf8);	/* 47 */
+	STEP(H, b, c, d, a, x[2], S34, 0xc4ac5665);	/* 48 */
 
 	/* Round 4 */
-	II(a, b, c, d, x[0], S41, 0xf4292244);	/* 49 */
-	II(d, a, b, c, x[7], S42, 0x432aff97);	/* 50 */
-	II(c, d, a, b, x[14], S43, 0xab9423a7);	/* 51 */
-	II(b, c, d, a, x[5], S44, 0xfc93a039);	/* 52 */
-	II(a, b, c, d, x[12], S41, 0x655b59c3);	/* 53 */
-	II(d, a, b, c, x[3], S42, 0x8f0ccc92);	/* 54 */
-	II(c, d, a, b, x[10], S43, 0xffeff47d);	/* 55 */
-	II(b, c, d, a, x[1], S44, 0x85845dd1);	/* 56 */
-	II(a, b, c, d, x[8], S41, 0x6fa87e4f);	/* 57 */
-	II(d, a, b, c, x[15], S42, 0xfe2ce6e0);	/* 58 */
-	II(c, d, a, b, x[6], S43, 0xa3014314);	/* 59 */
-	II(b, c, d, a, x[13], S44, 0x4e0811a1);	/* 60 */
-	II(a, b, c, d, x[4], S41, 0xf7537e82);	/* 61 */
-	II(d, a, b, c, x[11], S42, 0xbd3af235);	/* 62 */
-	II(c, d, a, b, x[2], S43, 0x2ad7d2bb);	/* 63 */
-	II(b, c, d, a, x[9], S44, 0xeb86d391);	/* 64 */
+	STEP(I, a, b, c, d, x[0], S41, 0xf4292244);	/* 49 */
+	STEP(I, d, a, b, c, x[7], S42, 0x432aff97);	/* 50 */
+	STEP(I, c, d, a, b, x[14], S43, 0xab9423a7);	/* 51 */
+	STEP(I, b, c, d, a, x[5], S44, 0xfc93a039);	/* 52 */
+	STEP(I, a, b, c, d, x[12], S41, 0x655b59c3);	/* 53 */
+	STEP(I, d, a, b, c, x[3], S42, 0x8f0ccc92);	/* 54 */
+	STEP(I, c, d, a, b, x[10], S43, 0xffeff47d);	/* 55 */
+	STEP(I, b, c, d, a, x[1], S44, 0x85845dd1);	/* 56 */
+	STEP(I, a, b, c, d, x[8], S41, 0x6fa87e4f);	/* 57 */
+	STEP(I, d, a, b, c, x[15], S42, 0xfe2ce6e0);	/* 58 */
+	STEP(I, c, d, a, b, x[6], S43, 0xa3014314);	/* 59 */
+	STEP(I, b, c, d, a, x[13], S44, 0x4e0811a1);	/* 60 */
+	STEP(I, a, b, c, d, x[4], S41, 0xf7537e82);	/* 61 */
+	STEP(I, d, a, b, c, x[11], S42, 0xbd3af235);	/* 62 */
+	STEP(I, c, d, a, b, x[2], S43, 0x2ad7d2bb);	/* 63 */
+	STEP(I, b, c, d, a, x[9], S44, 0xeb86d391);	/* 64 */
 
 	state[0] += a;
 	state[1] += b;
 	state[2] += c;
 	state[3] += d;
-
-	/* Zeroize sensitive information. */
-	MD5_memset((void *) x, 0, sizeof (x));
 }
 
 /* Encodes input (unsigned int) into output (unsigned char). Assumes len is
    a multiple of 4.
  */
-static void Encode(output, input, len)
-     unsigned char *output;
-     unsigned int *input;
-     unsigned int len;
+static void Encode(unsigned char *output, const unsigned int *input,
+		unsigned int len)
 {
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+	memcpy(output, input, len);
+#else
 	unsigned int i, j;
 
 	for (i = 0, j = 0; j < len; i++, j += 4) {
@@ -290,53 +285,5 @@ static void Encode(output, input, len)
 		output[j + 2] = (unsigned char) ((input[i] >> 16) & 0xff);
 		output[j + 3] = (unsigned char) ((input[i] >> 24) & 0xff);
 	}
-}
-
-/* Decodes input (unsigned char) into output (unsigned int). Assumes len is
-   a multiple of 4.
- */
-static void Decode(output, input, len)
-     unsigned int *output;
-     const unsigned char *input;
-     unsigned int len;
-{
-	unsigned int i, j;
-
-	for (i = 0, j = 0; j < len; i++, j += 4)
-		output[i] =
-		   ((unsigned int) input[j]) | (((unsigned int) input[j + 1]) <<
-						8) |
-		   (((unsigned int) input[j + 2]) << 16) |
-		   (((unsigned int) input[j + 3]) << 24);
-}
-
-/* Note: Replace "for loop" with standard memcpy if possible.
- */
-
-static void MD5_memcpy(output, input, len)
-     void *output;
-     void *input;
-     unsigned int len;
-{
-/*	unsigned int i; */
-
-	memmove(output, input, len * sizeof (void));
-	/* for (i = 0; i < len; i++)
-	   output[i] = input[i]; */
-}
-
-/* Note: Replace "for loop" with standard memset if possible.
- */
-static void MD5_memset(output, value, len)
-     void *output;
-     int value;
-     unsigned int len;
-{
-	memset(output, (char) value, len);
-/*	
-	unsigned int i;
-
-	for (i = 0; i < len; i++)
-		((char *) output)[i] = (char) value;
-*/
+#endif
 }
@@ -24,6 +24,7 @@
 #include "schema.h"
 #include "midgard_core_object.h"
 #include "midgard_core_object_class.h"
+#include "midgard_core_schema_cache.h"
 #include <libxml/parser.h>
 #include <libxml/parserInternals.h>
 
@@ -62,7 +63,8 @@ MgdSchemaPropertyAttr *_mgd_schema_property_attr_new(){
 	prop->is_link = FALSE;
 	prop->is_linked = FALSE;
 	prop->description = g_strdup ("");
-	prop->user_fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	prop->user_fields = g_hash_table_new_full(g_str_hash, g_str_equal, 
+			_midgard_core_schema_string_free, _midgard_core_schema_string_free);
 	
 	return prop; 
 }
@@ -73,21 +75,21 @@ void _mgd_schema_property_attr_free(gpointer data)
 
 	MgdSchemaPropertyAttr *prop = (MgdSchemaPropertyAttr *)data;
 
-	g_free((gchar *)prop->type);
-	g_free((gchar *)prop->dbtype);
-	g_free((gchar *)prop->field);
-	g_free((gchar *)prop->table);
+	_midgard_core_schema_string_free((gchar *)prop->type);
+	_midgard_core_schema_string_free((gchar *)prop->dbtype);
+	_midgard_core_schema_string_free((gchar *)prop->field);
+	_midgard_core_schema_string_free((gchar *)prop->table);
 	
 	if(prop->tablefield != NULL)
-		g_free((gchar *) prop->tablefield);
+		_midgard_core_schema_string_free((gchar *) prop->tablefield);
 
-	g_free((gchar *)prop->upfield);
-	g_free((gchar *)prop->parentfield);
-	g_free((gchar *)prop->primaryfield);
-	g_free((gchar *)prop->link);
-	g_free((gchar *)prop->link_target);
+	_midgard_core_schema_string_free((gchar *)prop->upfield);
+	_midgard_core_schema_string_free((gchar *)prop->parentfield);
+	_midgard_core_schema_string_free((gchar *)prop->primaryfield);
+	_midgard_core_schema_string_free((gchar *)prop->link);
+	_midgard_core_schema_string_free((gchar *)prop->link_target);
 
-	g_free((gchar *)prop->description);
+	_midgard_core_schema_string_free((gchar *)prop->description);
 	prop->description = NULL;
 
 	g_hash_table_destroy(prop->user_fields);
@@ -105,7 +107,7 @@ void _destroy_property_hash(gpointer key, gpointer value, gpointer userdata)
 		_mgd_schema_property_attr_free(prop);
 
 	if(name)
-		g_free(name);
+		_midgard_core_schema_string_free(name);
 }
 
 MgdSchemaTypeQuery *_mgd_schema_type_query_new()
@@ -135,15 +137,15 @@ void _mgd_schema_type_query_free(MgdSchemaTypeQuery *query)
 	if(query->select_full != NULL)
 		g_free((gchar *)query->select_full);
 
-	g_free((gchar *)query->primary);
+	_midgard_core_schema_string_free((gchar *)query->primary);
 	if(query->link != NULL)
-		g_free((gchar *)query->link);
+		_midgard_core_schema_string_free((gchar *)query->link);
 	if(query->tables != NULL)
 		g_free((gchar *)query->tables);
 	if(query->parentfield != NULL)
-		g_free((gchar *)query->parentfield);
+		_midgard_core_schema_string_free((gchar *)query->parentfield);
 	if(query->upfield != NULL)
-		g_free((gchar *)query->upfield);
+		_midgard_core_schema_string_free((gchar *)query->upfield);
 
 	if(query)
 		g_free(query);
@@ -177,14 +179,15 @@ MgdSchemaTypeAttr *_mgd_schema_type_attr_new()
 	type->use_lang = FALSE;
 	type->tables = g_hash_table_new(g_str_hash, g_str_equal);
 	type->prophash = g_hash_table_new_full(g_str_hash, g_str_equal, 
-			g_free, _mgd_schema_property_attr_free);
+			_midgard_core_schema_string_free, _mgd_schema_property_attr_free);
 	type->query = _mgd_schema_type_query_new();
 	type->childs = NULL;
 	type->metadata = 
 		g_hash_table_new_full(g_str_hash, g_str_equal,
 				g_free, (GDestroyNotify) _mgd_schema_property_attr_free);
 
-	type->user_values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	type->user_values = g_hash_table_new_full(g_str_hash, g_str_equal, 
+			_midgard_core_schema_string_free, _midgard_core_schema_string_free);
 	return type;
 }
 
@@ -192,11 +195,11 @@ void _mgd_schema_type_attr_free(MgdSchemaTypeAttr *type)
 {
 	g_assert(type != NULL);
 
-	g_free((gchar *)type->table);
-	g_free((gchar *)type->parent);
-	g_free((gchar *)type->primary);
-	g_free((gchar *)type->property_up);
-	g_free((gchar *)type->property_parent);
+	_midgard_core_schema_string_free((gchar *)type->table);
+	_midgard_core_schema_string_free((gchar *)type->parent);
+	_midgard_core_schema_string_free((gchar *)type->primary);
+	_midgard_core_schema_string_free((gchar *)type->property_up);
+	_midgard_core_schema_string_free((gchar *)type->property_parent);
 
 	g_hash_table_foreach(type->tables, _destroy_query_hash, NULL);
 	g_hash_table_destroy(type->tables);	
@@ -386,6 +389,40 @@ _get_type_attributes(xmlNode * node, MgdSchemaTypeAttr *type_attr)
 	}
 }
 
+/* Returns MGD_TYPE_* for schema's property type name, G_TYPE_NONE if name is NULL or unknown */
+GType _midgard_core_schema_gtype_from_name(const gchar *name)
+{
+	if(name == NULL)
+		return G_TYPE_NONE;
+
+	if(g_str_equal(name, "string"))
+		return MGD_TYPE_STRING;
+
+	if(g_str_equal(name, "integer"))
+		return MGD_TYPE_INT;
+
+	if(g_str_equal(name, "unsigned integer"))
+		return MGD_TYPE_UINT;
+
+	/* FIXME, return MGD_TYPE_DOUBLE for double once mgdschema supports it */
+	if(g_str_equal(name, "float") || g_str_equal(name, "double"))
+		return MGD_TYPE_FLOAT;
+
+	if(g_str_equal(name, "boolean") || g_str_equal(name, "bool"))
+		return MGD_TYPE_BOOLEAN;
+
+	if(g_str_equal(name, "datetime"))
+		return MGD_TYPE_TIMESTAMP;
+
+	if(g_str_equal(name, "longtext") || g_str_equal(name, "text"))
+		return MGD_TYPE_LONGTEXT;
+
+	if(g_str_equal(name, "guid"))
+		return MGD_TYPE_GUID;
+
+	return G_TYPE_NONE;
+}
+
 static void _midgard_core_schema_get_property_type(xmlNode *node, 
 		MgdSchemaTypeAttr *type_attr, MgdSchemaPropertyAttr *prop_attr)
 {
@@ -409,41 +446,8 @@ static void _midgard_core_schema_get_property_type(xmlNode *node,
 					typeisset = TRUE;
 					
 					prop_attr->type = g_strdup((const gchar*)attrval);
-			
-					if(g_str_equal(attrval, "string"))
-						prop_attr->gtype = MGD_TYPE_STRING;
-
-					if(g_str_equal(attrval, "integer"))
-						prop_attr->gtype = MGD_TYPE_INT;
-
-					if(g_str_equal(attrval, "unsigned integer"))
-						prop_attr->gtype = MGD_TYPE_UINT;
-
-					if(g_str_equal(attrval, "float"))
-						prop_attr->gtype = MGD_TYPE_FLOAT;
-					
-					/* FIXME, change to MGD_TYPE_DOUBLE once mgdschema supports it */
-					if(g_str_equal(attrval, "double"))
-						prop_attr->gtype = MGD_TYPE_FLOAT;
-
-					if(g_str_equal(attrval, "boolean"))
-						prop_attr->gtype = MGD_TYPE_BOOLEAN;
-
-					if(g_str_equal(attrval, "bool"))
-						prop_attr->gtype = MGD_TYPE_BOOLEAN;
-				
-					if(g_str_equal(attrval, "datetime"))
-						prop_attr->gtype = MGD_TYPE_TIMESTAMP;
-				
-					if(g_str_equal(attrval, "longtext"))
-						prop_attr->gtype = MGD_TYPE_LONGTEXT;
-				
-					if(g_str_equal(attrval, "text"))
-						prop_attr->gtype = MGD_TYPE_LONGTEXT;				
+					prop_attr->gtype = _midgard_core_schema_gtype_from_name(prop_attr->type);
 
-					if(g_str_equal(attrval, "guid"))
-						prop_attr->gtype = MGD_TYPE_GUID;
-				
 				} else {
 
 					prop_attr->type = g_strdup("string");
@@ -904,7 +908,7 @@ void __get_pdata_foreach(gpointer key, gpointer value, gpointer user_data)
 		} else {
 			tmpstr = g_strjoin(".", ext_table, pname,NULL);
 			if(prop_attr->field != NULL)
-				g_free((gchar *)prop_attr->field);
+				_midgard_core_schema_string_free((gchar *)prop_attr->field);
 			prop_attr->field = g_strdup(pname);
 		}
 		nick = g_strdup(tmpstr);
@@ -937,7 +941,7 @@ void __get_pdata_foreach(gpointer key, gpointer value, gpointer user_data)
 	
 	if (ext_table == NULL) {
 		tmpstr = NULL;	
-		if(prop_attr->table != NULL) g_free((gchar *)prop_attr->table);
+		if(prop_attr->table != NULL) _midgard_core_schema_string_free((gchar *)prop_attr->table);
 		prop_attr->table = g_strdup(table);
 		fname = prop_attr->field;
 		if ( (fname == NULL ) && ((upfield == NULL) && (parentfield == NULL)) 
@@ -1423,15 +1427,54 @@ gboolean midgard_schema_type_exists(MidgardSchema *self, const gchar *classname)
 	return FALSE;
 }
 
+static void __collect_type_name(gpointer key, gpointer value, gpointer user_data)
+{
+	g_hash_table_insert((GHashTable *) user_data, key, key);
+}
+
+typedef struct {
+	GHashTable *known;
+	GSList *names;
+} NewTypeNames;
+
+static void __collect_new_type_name(gpointer key, gpointer value, gpointer user_data)
+{
+	NewTypeNames *new_types = (NewTypeNames *) user_data;
+
+	if(!g_hash_table_lookup(new_types->known, key))
+		new_types->names = g_slist_prepend(new_types->names, key);
+}
+
 void midgard_schema_read_file(
 		MidgardSchema *schema, const gchar *filename) 
 {
 	g_assert(schema != NULL);
         g_assert(filename != NULL);
 
-        GHashTable *files = read_schema_files(filename);
-        g_hash_table_foreach(files, parse_schema, schema);
-        g_hash_table_destroy(files);
+	if(!_midgard_core_schema_cache_load(schema, filename)) {
+
+		GHashTable *known = NULL;
+		if(_midgard_core_schema_cache_is_enabled()) {
+
+			known = g_hash_table_new(g_str_hash, g_str_equal);
+			g_hash_table_foreach(schema->types, __collect_type_name, known);
+		}
+
+		GHashTable *files = read_schema_files(filename);
+		g_hash_table_foreach(files, parse_schema, schema);
+
+		if(known != NULL) {
+
+			/* Cache types which were not in schema before parsing */
+			NewTypeNames new_types = { known, NULL };
+			g_hash_table_foreach(schema->types, __collect_new_type_name, &new_types);
+			_midgard_core_schema_cache_save(schema, filename, files, new_types.names);
+			g_slist_free(new_types.names);
+			g_hash_table_destroy(known);
+		}
+
+		g_hash_table_destroy(files);
+	}
 
         /* register types */
         g_hash_table_foreach(schema->types, __get_tdata_foreach, schema);
@@ -1649,7 +1692,7 @@ static void
 _schema_instance_init(GTypeInstance *instance, gpointer g_class)
 {
 	MidgardSchema *self = (MidgardSchema *) instance;
-	self->types = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	self->types = g_hash_table_new_full(g_str_hash, g_str_equal, _midgard_core_schema_string_free, NULL);
 }
 
 /* Finalize  */
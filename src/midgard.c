@@ -78,7 +78,9 @@
 #include "midgard/midgard_datatypes.h"
 #include "midgard/midgard_timestamp.h"
 #include "midgard_core_object.h"
+#include "midgard_core_profiler.h"
 #include "midgard_core_query.h"
+#include "midgard_core_acl.h"
 
 static FILE *_log_file = NULL;
 
@@ -585,6 +587,9 @@ void mgd_clear(midgard * mgd, int clearflags)
 
 	mgd->current_user->member_of = NULL;
 
+	/* New request, do not trust access checks of the previous one */
+	_midgard_core_acl_reset(mgd);
+
 	/* we automaticaly select first parser to avoid confusion */
 	if (clearflags & MGD_CLEAR_PARSER) 
 		mgd->parser = mgd_parser_list(); 
@@ -614,6 +619,10 @@ void mgd_close(midgard * mgd)
 		mgd_free_pool(mgd->pool);
 	mgd->pool = NULL;
 
+	/* Write pending quota changes while connection is still open */
+	if(mgd->_mgd != NULL && G_IS_OBJECT(mgd->_mgd))
+		midgard_quota_flush(mgd);
+
 	/* Free low level members */
 	if(!mgd->is_copy) {
 		
@@ -1204,6 +1213,8 @@ fallback:
 		mgd_release(res);
 	}
 
+	_midgard_core_acl_reset(mgd);
+
 	grant = (rootuser && mgd->current_user->is_root);
 	if (!grant && !rootuser && !mgd->current_user->is_root) {
 		if (host_sitegroup != 0 && req_sitegroup == host_sitegroup)
@@ -1474,6 +1485,9 @@ int mgd_ismember(midgard * mgd, int group)
 
 	assert(mgd);
 
+   /* Hash set of groups, if connection keeps one */
+   if ((i = _midgard_core_acl_is_member(mgd, group)) != -1) return i;
+
    member_of = mgd->current_user->member_of;
 
 	if (member_of == NULL) return 0;
@@ -1500,7 +1514,6 @@ midgard_res *mgd_query(midgard * mgd, const char *query, ...)
 
 midgard_res *mgd_vquery(midgard * mgd, const char *query, va_list args)
 {
-	midgard_res *res;
 	midgard_pool *pool = NULL;
 	MYSQL_RES *mres;
 	int rv;
@@ -1526,6 +1539,7 @@ midgard_res *mgd_vquery(midgard * mgd, const char *query, va_list args)
 
    	g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "query=%s", fquery); 
 
+	GTimer *timer = _midgard_core_profiler_is_enabled() ? g_timer_new() : NULL;
 	rv = mysql_query(mgd->msql->mysql, fquery);
 	
 	if (rv != 0) {
@@ -1535,14 +1549,30 @@ midgard_res *mgd_vquery(midgard * mgd, const char *query, va_list args)
 				"QUERY: \n"
 				"%s", 
 				mysql_error(mgd->msql->mysql), fquery);
+		if(timer)
+			g_timer_destroy(timer);
 		return NULL;
 	}
 
+	/* get results */
+	mres = mysql_store_result(mgd->msql->mysql);
+
+	if(timer) {
+		_midgard_core_profiler_record(mgd->msql->mysql, fquery, 
+				MIDGARD_QUERY_ORIGIN_LEGACY, g_timer_elapsed(timer, NULL), mres);
+		g_timer_destroy(timer);
+	}
+
 	if(pool)
 		mgd_free_pool(pool);	
 	
-	/* get results */
-	mres = mysql_store_result(mgd->msql->mysql);
+	return _mgd_legacy_res_new(mgd, mres);
+}
+
+midgard_res *_mgd_legacy_res_new(midgard *mgd, MYSQL_RES *mres)
+{
+	midgard_res *res;
+
 	if (!mres)
 		return NULL;
 	if (mysql_num_rows(mres) == 0) {
@@ -2147,12 +2177,19 @@ int mgd_vexec(midgard * mgd, const char *command, va_list args)
 	}
 	
     	g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "query=%s", fcommand);
+	GTimer *timer = _midgard_core_profiler_is_enabled() ? g_timer_new() : NULL;
 	rv = mysql_query(mgd->msql->mysql, fcommand);
 
 	if (rv != 0) {
 		g_warning("\n\nQUERY FAILED: \n %s \n QUERY: \n %s\n",
 				mysql_error(mgd->msql->mysql), fcommand);
-	}	
+	} else if (timer) {
+		_midgard_core_profiler_record(mgd->msql->mysql, fcommand, 
+				MIDGARD_QUERY_ORIGIN_LEGACY, g_timer_elapsed(timer, NULL), NULL);
+	}
+
+	if (timer)
+		g_timer_destroy(timer);
 	
 	mgd_free_pool(pool);
 	return rv ? 0 : 1;
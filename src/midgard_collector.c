@@ -21,6 +21,9 @@
 #include "midgard/query_builder.h"
 #include "midgard/midgard_object.h"
 #include "midgard_core_query_builder.h"
+#include "midgard_core_advisor.h"
+#include "midgard_core_profiler.h"
+#include "midgard_core_rowset.h"
 #include "midgard_mysql.h"
 
 struct _MidgardCollectorPrivate{
@@ -624,141 +627,153 @@ void midgard_collector_count(
 	return;
 }
 
-static void __set_value(GValue *val, gchar *field_value)
+/* Columns are looked up once, values of every row are set for its key */
+static gboolean __set_from_rowset(MidgardCollector *self, MgdRowSet *rows)
 {
-	switch(G_VALUE_TYPE(val)){
-		
-		case G_TYPE_STRING:
-			g_value_set_string(val, (gchar *)field_value);
-			break;
-		
-		case G_TYPE_UINT:
-			g_value_set_uint(val, atoi(field_value));
-			break;
-		
-		case G_TYPE_INT:
-			g_value_set_int(val, atoi(field_value));
-			break;
-		
-		case G_TYPE_FLOAT:
-			g_value_set_float(val, g_ascii_strtod(field_value, NULL));
-			break;
-		
-		case G_TYPE_BOOLEAN:
-			g_value_set_boolean(val, atoi(field_value));
-			break;
+	guint n_fields = _midgard_core_rowset_num_fields(rows);
+	GParamSpec **pspecs = g_new0(GParamSpec *, n_fields);
+	GParamSpec *pspec;
+	GValue *pval = NULL;
+	guint j;
+
+	if (_midgard_core_rowset_num_rows(rows) == 0) {
+		g_free(pspecs);
+		return FALSE;
 	}
+
+	MidgardMetadataClass *mklass = NULL;
+
+	for (j = 0; j < n_fields; j++) {
+
+		const gchar *name = _midgard_core_rowset_field_name(rows, j);
+		pspecs[j] = g_object_class_find_property(
+				(GObjectClass *)self->private->klass, name);
+
+		if (pspecs[j] == NULL && n_fields > 1) {
+
+			if (mklass == NULL)
+				mklass = (MidgardMetadataClass*) g_type_class_peek(g_type_from_name("midgard_metadata"));
+			pspecs[j] = g_object_class_find_property(G_OBJECT_CLASS(mklass), name);
+		}
+	}
+
+	while (_midgard_core_rowset_fetch(rows)) {
+
+		const gchar *key = _midgard_core_rowset_get_string(rows, 0);
+
+		for (j = 0; j < n_fields; j++) {
+
+			pspec = pspecs[j];
+
+			if (pspec != NULL) {
+			
+				pval = g_new0(GValue, 1);
+				g_value_init(pval, pspec->value_type);
+				
+				_midgard_core_rowset_set_value(rows, j, pval);
+
+				midgard_collector_set(self, key,
+						_midgard_core_rowset_field_name(rows, j), pval);
+
+			} else if (n_fields == 1) {
+				
+				midgard_collector_set(self, key, NULL, NULL);
+			}
+		}
+	}
+
+	g_free(pspecs);
+
+	return TRUE;
 }
 
-gboolean midgard_collector_execute(
-		MidgardCollector *self)
+MidgardQueryBuilder *_midgard_core_collector_get_builder(MidgardCollector *self)
+{
+	g_assert(self);
+
+	return self->private->builder;
+}
+
+gchar *_midgard_core_collector_get_sql(MidgardCollector *self)
 {
 	g_assert(self);
 
 	if(!self->private->keyname){
 		g_warning("Collector's key is not set. Call set_key_property method");
-		return FALSE;
+		return NULL;
 	}
 
 	if(!self->private->values)
-		return FALSE;
+		return NULL;
 
-        GList *list =
-		g_list_reverse(self->private->values);
+	/* values are prepended, so walk them from the tail */
+	GList *list = g_list_last(self->private->values);
 	GString *sgs = g_string_new("");
 	guint i = 0;
-	for( ; list; list = list->next){
+	for( ; list; list = list->prev){
 		if(i > 0)
 			g_string_append(sgs, ", ");
 		g_string_append(sgs, list->data);
 		i++;
 	} 
 
-	GValue *pval = NULL;
-
 	gchar *select = g_string_free(sgs, FALSE);
-	gchar *sql = _midgard_core_qb_get_sql( 
-			self->private->builder, MQB_SELECT_FIELD, 
-			select, TRUE);
+	
+	return _midgard_core_qb_get_sql(self->private->builder, MQB_SELECT_FIELD, select, TRUE);
+}
+
+gboolean midgard_collector_execute(
+		MidgardCollector *self)
+{
+	g_assert(self);
+
+	gchar *sql = _midgard_core_collector_get_sql(self);
 	
 	g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "query=%s", sql);
 	if(!sql)
 		return FALSE;
-	
-	gint sq = mysql_query(self->private->builder->priv->mgd->msql->mysql, sql);
 
-	if (sq != 0) {
-		g_warning("\nQUERY FAILED: \n %s \nQUERY: \n %s",
-				mysql_error(self->private->builder->priv->mgd->msql->mysql),
-				sql);
+	MYSQL *mysql = self->private->builder->priv->mgd->msql->mysql;
+	GTimer *timer = (_midgard_core_advisor_is_enabled() || _midgard_core_profiler_is_enabled()) ? 
+		g_timer_new() : NULL;
+
+	MgdRowSet *rows = _midgard_core_rowset_query(mysql, sql,
+			_midgard_core_rowset_use_prepared(self->private->builder->priv->mgd->_mgd));
+	gdouble elapsed = timer ? g_timer_elapsed(timer, NULL) : 0;
+
+	if (!rows) {
 		g_free(sql);
+		if(timer)
+			g_timer_destroy(timer);
 		return FALSE;
 	}
-	g_free(sql);
 
-	i = 0;
-	guint ret_rows, ret_fields, j;
-	MYSQL_ROW row;
-	MYSQL_FIELD *field;
-	MYSQL_RES *results = mysql_store_result(self->private->builder->priv->mgd->msql->mysql);
-	GParamSpec *pspec;
-	//GValue pval = {0, };
+	gboolean rv = __set_from_rowset(self, rows);
 
-	if (!results)
-		return FALSE;
-	
-	if ((ret_rows = mysql_num_rows(results)) == 0) {
-		mysql_free_result(results);
-		return FALSE;
+	if(timer) {
+		_midgard_core_advisor_record(self->private->builder, elapsed);
+		_midgard_core_profiler_record_rows(mysql, sql, MIDGARD_QUERY_ORIGIN_COLLECTOR, elapsed,
+				_midgard_core_rowset_num_rows(rows), _midgard_core_rowset_bytes(rows));
+		g_timer_destroy(timer);
 	}
-	
-	for(i = 0; i < ret_rows; i++){
-		row = mysql_fetch_row(results);
-		ret_fields =  mysql_num_fields(results);
-	
-		for (j = 0; j < ret_fields; j++){
-			field = mysql_fetch_field_direct(results, j);
-			
-			if ((pspec = g_object_class_find_property(
-							(GObjectClass *)self->private->klass, 
-							field->name)) != NULL) {
-			
-				pval = g_new0(GValue, 1);
-				g_value_init(pval, pspec->value_type);
-				
-				__set_value(pval, (gchar *)row[j]);
 
-				midgard_collector_set(self,
-					(gchar *) row[0],
-					field->name,
-					pval);
+	_midgard_core_rowset_free(rows);
+	g_free(sql);
 
-			} else if (ret_fields == 1) {
-				
-				midgard_collector_set(self, (gchar *) row[0], NULL, NULL);
+	return rv;
+}
 
-			} else {
+/* Takes ownership of results and frees it before return */
+gboolean _midgard_core_collector_set_from_result(MidgardCollector *self, MYSQL_RES *results)
+{
+	g_assert(self);
+	g_assert(results);
 
-				MidgardMetadataClass *mklass = 
-					(MidgardMetadataClass*) g_type_class_peek(g_type_from_name("midgard_metadata"));
-				pspec = g_object_class_find_property(G_OBJECT_CLASS(mklass), field->name);
-				
-				if(pspec) {
-					
-					pval = g_new0(GValue, 1);
-					g_value_init(pval, pspec->value_type);
-					
-					__set_value(pval, (gchar *)row[j]);
-					
-					midgard_collector_set(self,
-							(gchar *) row[0], field->name, pval);
-				}
-			}
-		}
-	}
+	MgdRowSet *rows = _midgard_core_rowset_new(results);
+	gboolean rv = __set_from_rowset(self, rows);
+	_midgard_core_rowset_free(rows);
 
-	mysql_free_result(results);
-	return TRUE;
+	return rv;
 }
 
 /* GOBJECT ROUTINES */
@@ -29,6 +29,7 @@
 #include "src/midgard_core_query.h"
 #include "midgard/midgard_defs.h"
 #include "midgard_core_config.h"
+#include "midgard_core_pagecache.h"
 #include "midgard/query.h"
 
 /* Properties */
@@ -60,6 +61,11 @@ static MidgardConfigPrivate *midgard_config_private_new(void)
         config_private->keyfile = NULL;
 	config_private->log_channel = NULL;
 	config_private->configname = NULL;
+	config_private->pagecache = MGD_PAGECACHE_DATABASE;
+	config_private->pagecache_file = NULL;
+	config_private->compactguids = FALSE;
+	config_private->schemacache_dir = NULL;
+	config_private->preparedstatements = FALSE;
 
 	return config_private;
 }
@@ -388,6 +394,40 @@ gboolean midgard_config_read_file(MidgardConfig *self, const gchar *filename, gb
 	tmpbool = g_key_file_get_boolean(keyfile, "Database", "GdaThreads", NULL);
 	self->gdathreads = tmpbool;
 
+	/* Get page cache storage */
+	tmpstr = g_key_file_get_string(keyfile, "Database", "PageCache", NULL);
+	if(tmpstr != NULL) {
+
+		if(g_str_equal(tmpstr, "Database")) {
+			self->private->pagecache = MGD_PAGECACHE_DATABASE;
+		} else if(g_str_equal(tmpstr, "Memory")) {
+			self->private->pagecache = MGD_PAGECACHE_MEMORY;
+		} else if(g_str_equal(tmpstr, "Shared")) {
+			self->private->pagecache = MGD_PAGECACHE_SHARED;
+		} else {
+			g_warning("Unknown '%s' page cache. Using Database", tmpstr);
+		}
+		g_free(tmpstr);
+	}
+
+	/* Get shared page cache file */
+	g_free(self->private->pagecache_file);
+	self->private->pagecache_file = 
+		g_key_file_get_string(keyfile, "Database", "PageCacheFile", NULL);
+
+	/* Get guid columns storage */
+	tmpbool = g_key_file_get_boolean(keyfile, "Database", "CompactGuids", NULL);
+	self->private->compactguids = tmpbool;
+
+	/* Get compiled schema cache directory */
+	g_free(self->private->schemacache_dir);
+	self->private->schemacache_dir = 
+		g_key_file_get_string(keyfile, "Database", "SchemaCacheDir", NULL);
+
+	/* Get query builder and collector protocol */
+	tmpbool = g_key_file_get_boolean(keyfile, "Database", "PreparedStatements", NULL);
+	self->private->preparedstatements = tmpbool;
+
 	/* We will free it when config is unref */
 	self->private->keyfile = keyfile;
 
@@ -843,6 +883,12 @@ void __midgard_config_struct_free(MidgardConfig *self, gboolean object)
 		g_free(self->private->configname);
 	self->private->configname = NULL;
 
+	g_free(self->private->pagecache_file);
+	self->private->pagecache_file = NULL;
+
+	g_free(self->private->schemacache_dir);
+	self->private->schemacache_dir = NULL;
+
 	g_free(self->private);
 	self->private = NULL;
 
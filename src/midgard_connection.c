@@ -23,6 +23,10 @@
 #include "midgard_core_object.h"
 #include "fmt_russian.h"
 #include "midgard/midgard_user.h"
+#include "midgard_core_async.h"
+#include "midgard_core_quota.h"
+#include "midgard_core_pagecache.h"
+#include "midgard_core_acl.h"
 
 static void _midgard_connection_finalize(GObject *object)
 {
@@ -34,6 +38,11 @@ static void _midgard_connection_finalize(GObject *object)
 
 	self->errstr = NULL;
 
+	_midgard_core_async_shutdown(self);
+	_midgard_core_quota_ledger_free(self);
+	_midgard_core_pagecache_free(self);
+	_midgard_core_acl_free(self);
+
 	self->priv->loghandler = 0;
 	if(self->priv->sitegroup)
 		g_free((gchar *) self->priv->sitegroup);
@@ -161,6 +170,14 @@ static void _midgard_connection_instance_init(
 	self->priv->enable_dbus = TRUE;
 	self->priv->enable_quota = TRUE;
 
+	self->priv->async_pool = NULL;
+	self->priv->async_connections = NULL;
+	self->priv->async_workers = MIDGARD_ASYNC_DEFAULT_WORKERS;
+
+	self->priv->quota_ledger = NULL;
+	self->priv->pagecache = NULL;
+	self->priv->acl = NULL;
+
 	/* Sitegroup cache */
 	self->priv->sg_ids = NULL;
 	
@@ -238,6 +255,8 @@ gboolean __midgard_connection_open(
 
 	if(g_type_from_name("midgard_article") <= 0) {
 		MidgardSchema *schema = g_object_new(MIDGARD_TYPE_SCHEMA, NULL);
+		if(mgd->priv->config->private->schemacache_dir)
+			midgard_schema_set_cache_dir(mgd->priv->config->private->schemacache_dir);
 		midgard_schema_init(schema);
 		midgard_schema_read_dir(schema, MIDGARD_LSCHEMA_DIR);
 		mgd->priv->schema = schema;
@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <stdlib.h>
+#include "midgard_core_acl.h"
+#include "midgard_mysql.h"
+
+/* ACL CACHE
+ *
+ * Access checks climb trees with one mgd_idfield query per level.
+ * Instead, every connection loads up, owner and reader columns of
+ * table's records which are not deleted and belong to current or
+ * 0 sitegroup, with one query. Records which are not loaded, are read
+ * with mgd_idfield. Results of checks for current user are memoised,
+ * and current user's groups are kept in a hash set.
+ *
+ * Trees are reused within request only, so changes made by other
+ * processes are seen by the next request. Everything is dropped when
+ * connection is cleared for new request, when user authenticates,
+ * when objects of preloaded classes are written by this process,
+ * when cache gets older than MIDGARD_ACL_MAX_AGE and when sitegroup
+ * changes. Memoised results and membership are dropped when current
+ * user changes. */
+
+typedef struct {
+	gint up;
+	gint owner;
+	gint reader;
+} MgdAclRow;
+
+typedef struct {
+	guint generation;
+	GTimer *age;
+
+	/* Identity of current user whose results are memoised */
+	mgd_userinfo *user;
+	gint user_id;
+	gint *member_of;
+	gint sitegroup;
+
+	/* Set of current user's groups, NULL if not built */
+	GHashTable *members;
+	/* id, result + 1 */
+	GHashTable *results[MGD_ACL_N_CHECKS];
+	/* id, MgdAclRow. NULL if not loaded */
+	GHashTable *trees[MGD_ACL_N_TREES];
+	/* Sitegroup of loaded trees */
+	gint trees_sitegroup;
+} MgdAcl;
+
+typedef struct {
+	const gchar *table;
+	/* id, up, owner and reader columns */
+	const gchar *fields;
+	/* mgd_idfield columns */
+	const gchar *up;
+	const gchar *owner;
+	const gchar *reader;
+} MgdAclTreeSpec;
+
+static const MgdAclTreeSpec acl_trees[MGD_ACL_N_TREES] = {
+	{ "topic", "id,up,owner,reader", "up", "owner", "reader" },
+	{ "snippetdir", "id,up,owner,0", "up", "owner", NULL },
+	{ "grp", "id,0,owner,reader", NULL, "owner", "reader" },
+	{ "event", "id,up,owner,0", "up", "owner", NULL },
+	{ "style", "id,up,owner,0", "up", "owner", NULL }
+};
+
+/* Classes whose writes invalidate cache */
+static const gchar *acl_classes[] = {
+	"midgard_topic",
+	"midgard_snippetdir",
+	"midgard_group",
+	"midgard_event",
+	"midgard_style",
+	NULL
+};
+
+static volatile gint acl_generation = 0;
+
+static void __acl_clear_user(MgdAcl *acl)
+{
+	guint i;
+
+	if(acl->members) {
+		g_hash_table_destroy(acl->members);
+		acl->members = NULL;
+	}
+
+	for(i = 0; i < MGD_ACL_N_CHECKS; i++)
+		g_hash_table_remove_all(acl->results[i]);
+}
+
+static void __acl_clear(MgdAcl *acl)
+{
+	guint i;
+
+	__acl_clear_user(acl);
+
+	for(i = 0; i < MGD_ACL_N_TREES; i++) {
+
+		if(acl->trees[i]) {
+			g_hash_table_destroy(acl->trees[i]);
+			acl->trees[i] = NULL;
+		}
+	}
+
+	g_timer_start(acl->age);
+}
+
+static MgdAcl *__acl_get(midgard *mgd)
+{
+	MidgardConnection *cnc = mgd->_mgd;
+	guint i;
+
+	if(cnc == NULL || mgd->current_user == NULL)
+		return NULL;
+
+	MgdAcl *acl = cnc->priv->acl;
+	guint generation = (guint) g_atomic_int_get(&acl_generation);
+
+	if(acl == NULL) {
+
+		acl = g_new0(MgdAcl, 1);
+		acl->generation = generation;
+		acl->age = g_timer_new();
+
+		for(i = 0; i < MGD_ACL_N_CHECKS; i++)
+			acl->results[i] = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+		cnc->priv->acl = acl;
+
+	} else if(acl->generation != generation
+			|| g_timer_elapsed(acl->age, NULL) > MIDGARD_ACL_MAX_AGE) {
+
+		__acl_clear(acl);
+		acl->generation = generation;
+	}
+
+	mgd_userinfo *user = mgd->current_user;
+
+	if(acl->user != user
+			|| acl->user_id != user->id
+			|| acl->member_of != user->member_of
+			|| acl->sitegroup != user->sitegroup) {
+
+		__acl_clear_user(acl);
+		acl->user = user;
+		acl->user_id = user->id;
+		acl->member_of = user->member_of;
+		acl->sitegroup = user->sitegroup;
+	}
+
+	return acl;
+}
+
+static GHashTable *__tree_load(midgard *mgd, MgdAclTree tree)
+{
+	const MgdAclTreeSpec *spec = &acl_trees[tree];
+
+	/* Deleted records and other sitegroups are rarely reached,
+	 * mgd_idfield reads them when they are */
+	midgard_res *res = mgd_ungrouped_select(mgd, spec->fields, spec->table,
+			"sitegroup IN (0,$d) AND metadata_deleted=0", NULL, mgd_sitegroup(mgd));
+
+	if(res == NULL && mysql_errno(mgd->msql->mysql) != 0)
+		return NULL;
+
+	GHashTable *rows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+	while(res && mgd_fetch(res)) {
+
+		MgdAclRow *row = g_new(MgdAclRow, 1);
+		row->up = atoi(mgd_colvalue(res, 1));
+		row->owner = atoi(mgd_colvalue(res, 2));
+		row->reader = atoi(mgd_colvalue(res, 3));
+
+		g_hash_table_insert(rows, GINT_TO_POINTER(atoi(mgd_colvalue(res, 0))), row);
+	}
+
+	if(res)
+		mgd_release(res);
+
+	return rows;
+}
+
+gint _midgard_core_acl_idfield(midgard *mgd, MgdAclTree tree, MgdAclField field, gint id)
+{
+	g_assert(mgd != NULL);
+	g_return_val_if_fail(tree < MGD_ACL_N_TREES, 0);
+
+	const MgdAclTreeSpec *spec = &acl_trees[tree];
+	const gchar *column = field == MGD_ACL_FIELD_UP ? spec->up :
+		field == MGD_ACL_FIELD_OWNER ? spec->owner : spec->reader;
+
+	g_return_val_if_fail(column != NULL, 0);
+
+	if(id == 0)
+		return 0;
+
+	MgdAcl *acl = __acl_get(mgd);
+
+	if(acl != NULL && acl->trees_sitegroup != mgd_sitegroup(mgd)) {
+
+		__acl_clear(acl);
+		acl->trees_sitegroup = mgd_sitegroup(mgd);
+	}
+
+	if(acl != NULL && acl->trees[tree] == NULL)
+		acl->trees[tree] = __tree_load(mgd, tree);
+
+	if(acl == NULL || acl->trees[tree] == NULL)
+		return mgd_idfield(mgd, column, spec->table, id);
+
+	const MgdAclRow *row = g_hash_table_lookup(acl->trees[tree], GINT_TO_POINTER(id));
+
+	if(row == NULL)
+		return mgd_idfield(mgd, column, spec->table, id);
+
+	switch(field) {
+
+		case MGD_ACL_FIELD_UP:
+			return row->up;
+
+		case MGD_ACL_FIELD_OWNER:
+			return row->owner;
+
+		case MGD_ACL_FIELD_READER:
+			return row->reader;
+	}
+
+	return 0;
+}
+
+gint _midgard_core_acl_lookup(midgard *mgd, MgdAclCheck check, gint id)
+{
+	g_assert(mgd != NULL);
+	g_return_val_if_fail(check < MGD_ACL_N_CHECKS, -1);
+
+	MgdAcl *acl = __acl_get(mgd);
+
+	if(acl == NULL)
+		return -1;
+
+	gpointer result = g_hash_table_lookup(acl->results[check], GINT_TO_POINTER(id));
+
+	if(result == NULL)
+		return -1;
+
+	return GPOINTER_TO_INT(result) - 1;
+}
+
+gboolean _midgard_core_acl_store(midgard *mgd, MgdAclCheck check, gint id, gboolean result)
+{
+	g_assert(mgd != NULL);
+	g_return_val_if_fail(check < MGD_ACL_N_CHECKS, result);
+
+	MgdAcl *acl = __acl_get(mgd);
+
+	if(acl != NULL)
+		g_hash_table_insert(acl->results[check], GINT_TO_POINTER(id),
+				GINT_TO_POINTER((result ? 1 : 0) + 1));
+
+	return result;
+}
+
+gint _midgard_core_acl_is_member(midgard *mgd, gint group)
+{
+	g_assert(mgd != NULL);
+
+	MgdAcl *acl = __acl_get(mgd);
+
+	if(acl == NULL)
+		return -1;
+
+	if(acl->members == NULL) {
+
+		gint i;
+		gint *member_of = mgd->current_user->member_of;
+		acl->members = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+		for(i = 0; member_of && member_of[i]; i++)
+			g_hash_table_insert(acl->members,
+					GINT_TO_POINTER(member_of[i]), GINT_TO_POINTER(TRUE));
+	}
+
+	return g_hash_table_lookup(acl->members, GINT_TO_POINTER(group)) != NULL;
+}
+
+void _midgard_core_acl_reset(midgard *mgd)
+{
+	g_assert(mgd != NULL);
+
+	if(mgd->_mgd == NULL || mgd->_mgd->priv->acl == NULL)
+		return;
+
+	MgdAcl *acl = mgd->_mgd->priv->acl;
+
+	/* New request, do not trust trees loaded by the previous one */
+	__acl_clear(acl);
+	acl->user = NULL;
+}
+
+void _midgard_core_acl_class_changed(const gchar *typename)
+{
+	g_return_if_fail(typename != NULL);
+
+	guint i;
+
+	for(i = 0; acl_classes[i] != NULL; i++) {
+
+		if(g_str_equal(typename, acl_classes[i])) {
+			g_atomic_int_inc(&acl_generation);
+			return;
+		}
+	}
+}
+
+void _midgard_core_acl_free(MidgardConnection *mgd)
+{
+	g_assert(mgd != NULL);
+
+	MgdAcl *acl = mgd->priv->acl;
+	guint i;
+
+	if(acl == NULL)
+		return;
+
+	__acl_clear(acl);
+
+	for(i = 0; i < MGD_ACL_N_CHECKS; i++)
+		g_hash_table_destroy(acl->results[i]);
+
+	g_timer_destroy(acl->age);
+	g_free(acl);
+
+	mgd->priv->acl = NULL;
+}
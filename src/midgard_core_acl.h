@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_ACL_H
+#define MIDGARD_CORE_ACL_H
+
+#include "midgard/midgard_legacy.h"
+#include "midgard_core_object.h"
+
+/* Seconds after which preloaded trees and memoised results are dropped.
+ * Changes made by other processes are seen after this time. */
+#define MIDGARD_ACL_MAX_AGE 5.0
+
+/* Memoised checks */
+typedef enum {
+	MGD_ACL_TOPIC_READER = 0,
+	MGD_ACL_TOPIC_OWNER,
+	MGD_ACL_SNIPPETDIR_OWNER,
+	MGD_ACL_GROUP_OWNER,
+	MGD_ACL_GROUP_READER,
+	MGD_ACL_EVENT_OWNER,
+	MGD_ACL_STYLE_OWNER,
+	MGD_ACL_N_CHECKS
+} MgdAclCheck;
+
+/* Preloaded tables */
+typedef enum {
+	MGD_ACL_TREE_TOPIC = 0,
+	MGD_ACL_TREE_SNIPPETDIR,
+	MGD_ACL_TREE_GRP,
+	MGD_ACL_TREE_EVENT,
+	MGD_ACL_TREE_STYLE,
+	MGD_ACL_N_TREES
+} MgdAclTree;
+
+/* Preloaded columns */
+typedef enum {
+	MGD_ACL_FIELD_UP = 0,
+	MGD_ACL_FIELD_OWNER,
+	MGD_ACL_FIELD_READER
+} MgdAclField;
+
+/* Returns the same value as mgd_idfield for tree's table.
+ * Up, owner and reader columns of current sitegroup's records are loaded
+ * with one query when table is used for the first time.
+ * mgd_idfield is used if table can not be loaded, or record is not loaded. */
+extern gint _midgard_core_acl_idfield(midgard *mgd, MgdAclTree tree, MgdAclField field, gint id);
+
+/* Returns memoised result of check for current user, or -1 */
+extern gint _midgard_core_acl_lookup(midgard *mgd, MgdAclCheck check, gint id);
+
+/* Memoises result of check for current user, returns result */
+extern gboolean _midgard_core_acl_store(midgard *mgd, MgdAclCheck check, gint id, gboolean result);
+
+/* Returns 1 if current user is member of group, 0 if not,
+ * and -1 if membership can not be cached */
+extern gint _midgard_core_acl_is_member(midgard *mgd, gint group);
+
+/* Drops connection's preloaded trees, memoised results and membership.
+ * Call it when new request starts, and whenever current user's groups change. */
+extern void _midgard_core_acl_reset(midgard *mgd);
+
+/* Drops preloaded trees and memoised results of all connections
+ * in this process, if objects of given class are preloaded */
+extern void _midgard_core_acl_class_changed(const gchar *typename);
+
+/* Frees connection's ACL cache */
+extern void _midgard_core_acl_free(MidgardConnection *mgd);
+
+#endif /* MIDGARD_CORE_ACL_H */
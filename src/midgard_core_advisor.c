@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <string.h>
+#include "midgard_core_advisor.h"
+#include "midgard/midgard_legacy.h"
+#include "midgard_core_query_builder.h"
+#include "midgard_core_query.h"
+#include "query_constraint.h"
+#include "group_constraint.h"
+#include "query_order.h"
+
+/* Statistics are kept per "classname:table:columns" key.
+ * Columns are ordered the way composite index should be created:
+ * equality predicates first, then range predicates, then orders. */
+
+G_LOCK_DEFINE_STATIC(advisor);
+
+static gboolean advisor_enabled = FALSE;
+static GHashTable *advisor_stats = NULL;
+
+static void __advice_free(MidgardIndexAdvice *advice)
+{
+	if(advice == NULL)
+		return;
+
+	g_free(advice->classname);
+	g_free(advice->table);
+	g_free(advice->columns);
+	g_free(advice);
+}
+
+void midgard_index_advisor_enable(gboolean toggle)
+{
+	G_LOCK(advisor);
+
+	advisor_enabled = toggle;
+	if(toggle && advisor_stats == NULL)
+		advisor_stats = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify) __advice_free);
+
+	G_UNLOCK(advisor);
+}
+
+void midgard_index_advisor_reset(void)
+{
+	G_LOCK(advisor);
+
+	if(advisor_stats)
+		g_hash_table_remove_all(advisor_stats);
+
+	G_UNLOCK(advisor);
+}
+
+gboolean _midgard_core_advisor_is_enabled(void)
+{
+	return advisor_enabled;
+}
+
+static gboolean __operator_is_equality(const gchar *op)
+{
+	if(op == NULL)
+		return FALSE;
+
+	return (g_str_equal(op, "=") || g_ascii_strcasecmp(op, "IN") == 0);
+}
+
+/* Adds constraint's column to table's equality or range list */
+static void __add_constraint_column(GHashTable *tables, MidgardQueryConstraint *constraint, gboolean order)
+{
+	MgdSchemaPropertyAttr *attr = constraint->priv->prop_left;
+
+	if(attr == NULL || attr->table == NULL || attr->field == NULL)
+		return;
+
+	GSList **lists = g_hash_table_lookup(tables, attr->table);
+	if(lists == NULL) {
+		/* equality, range and order columns */
+		lists = g_new0(GSList *, 3);
+		g_hash_table_insert(tables, (gpointer) attr->table, lists);
+	}
+
+	guint idx = 2;
+	if(!order)
+		idx = __operator_is_equality(constraint->priv->condition_operator) ? 0 : 1;
+
+	guint i;
+	for(i = 0; i < 3; i++) {
+		if(g_slist_find_custom(lists[i], attr->field, (GCompareFunc) strcmp))
+			return;
+	}
+
+	lists[idx] = g_slist_append(lists[idx], (gpointer) attr->field);
+}
+
+static void __add_group_columns(GHashTable *tables, MidgardGroupConstraint *group)
+{
+	/* OR groups can not use one composite index */
+	if(group->type == NULL || g_ascii_strcasecmp(group->type, "AND") != 0)
+		return;
+
+	GSList *l;
+	for(l = group->constraints; l != NULL; l = l->next)
+		__add_constraint_column(tables, MIDGARD_QUERY_CONSTRAINT(l->data), FALSE);
+
+	for(l = group->nested; l != NULL; l = l->next)
+		__add_group_columns(tables, MIDGARD_GROUP_CONSTRAINT(l->data));
+}
+
+typedef struct {
+	const gchar *classname;
+	gdouble seconds;
+} _advisor_record;
+
+static void __record_table(gpointer key, gpointer value, gpointer userdata)
+{
+	const gchar *table = (const gchar *) key;
+	GSList **lists = (GSList **) value;
+	_advisor_record *record = (_advisor_record *) userdata;
+
+	GString *columns = g_string_new("");
+	GSList *l;
+	guint i, n = 0;
+
+	for(i = 0; i < 3 && n < MIDGARD_ADVISOR_MAX_COLUMNS; i++) {
+
+		for(l = lists[i]; l != NULL && n < MIDGARD_ADVISOR_MAX_COLUMNS; l = l->next) {
+
+			if(n > 0)
+				g_string_append_c(columns, ',');
+			g_string_append(columns, (const gchar *) l->data);
+			n++;
+
+			/* Columns after the first range predicate can not be used by index */
+			if(i == 1)
+				break;
+		}
+
+		if(i == 1 && lists[1] != NULL)
+			break;
+	}
+
+	if(n == 0) {
+		g_string_free(columns, TRUE);
+		return;
+	}
+
+	gchar *stat_key = g_strconcat(record->classname, ":", table, ":", columns->str, NULL);
+	MidgardIndexAdvice *advice = g_hash_table_lookup(advisor_stats, stat_key);
+
+	if(advice == NULL) {
+
+		advice = g_new0(MidgardIndexAdvice, 1);
+		advice->classname = g_strdup(record->classname);
+		advice->table = g_strdup(table);
+		advice->columns = g_string_free(columns, FALSE);
+		g_hash_table_insert(advisor_stats, stat_key, advice);
+
+	} else {
+
+		g_free(stat_key);
+		g_string_free(columns, TRUE);
+	}
+
+	advice->hits++;
+	advice->total_time += record->seconds;
+	if(record->seconds > advice->max_time)
+		advice->max_time = record->seconds;
+}
+
+static void __free_table_lists(gpointer data)
+{
+	GSList **lists = (GSList **) data;
+	guint i;
+
+	for(i = 0; i < 3; i++)
+		g_slist_free(lists[i]);
+	g_free(lists);
+}
+
+void _midgard_core_advisor_record(MidgardQueryBuilder *builder, gdouble seconds)
+{
+	g_return_if_fail(builder != NULL);
+
+	if(!advisor_enabled)
+		return;
+
+	GHashTable *tables = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, __free_table_lists);
+	GSList *l;
+
+	for(l = builder->priv->constraints; l != NULL; l = l->next)
+		__add_constraint_column(tables, MIDGARD_QUERY_CONSTRAINT(l->data), FALSE);
+
+	for(l = builder->priv->groups; l != NULL; l = l->next)
+		__add_group_columns(tables, MIDGARD_GROUP_CONSTRAINT(l->data));
+
+	for(l = builder->priv->orders; l != NULL; l = l->next)
+		__add_constraint_column(tables, ((MidgardQueryOrder *)l->data)->constraint, TRUE);
+
+	_advisor_record record;
+	record.classname = g_type_name(builder->priv->type);
+	record.seconds = seconds;
+
+	G_LOCK(advisor);
+	if(advisor_stats)
+		g_hash_table_foreach(tables, __record_table, &record);
+	G_UNLOCK(advisor);
+
+	g_hash_table_destroy(tables);
+}
+
+/* Returns table's indexes as "col1,col2" strings, in index' columns order */
+static GSList *__get_table_indexes(MidgardConnection *mgd, const gchar *table)
+{
+	gchar *sql = g_strconcat("SHOW INDEX FROM ", table, NULL);
+	midgard_res *res = mgd_vquery(mgd->mgd, sql, NULL);
+	g_free(sql);
+
+	if(!res)
+		return NULL;
+
+	GHashTable *keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	GSList *indexes = NULL;
+	GString *columns;
+
+	/* Columns are returned in Seq_in_index order */
+	while(mgd_fetch(res)) {
+
+		const gchar *key_name = mgd_colvalue(res, 2);
+		const gchar *column = mgd_colvalue(res, 4);
+
+		columns = g_hash_table_lookup(keys, key_name);
+		if(columns == NULL) {
+			columns = g_string_new(column);
+			g_hash_table_insert(keys, g_strdup(key_name), columns);
+			indexes = g_slist_prepend(indexes, columns);
+		} else {
+			g_string_append_printf(columns, ",%s", column);
+		}
+	}
+
+	mgd_release(res);
+	g_hash_table_destroy(keys);
+
+	GSList *l;
+	for(l = indexes; l != NULL; l = l->next)
+		l->data = g_string_free((GString *) l->data, FALSE);
+
+	return indexes;
+}
+
+/* Index covers advice if advice's columns are its leading ones */
+static gboolean __index_covers(const gchar *index, const gchar *columns)
+{
+	gsize len = strlen(columns);
+
+	if(strncmp(index, columns, len) != 0)
+		return FALSE;
+
+	return (index[len] == '\0' || index[len] == ',');
+}
+
+static gint __advice_cmp(gconstpointer a, gconstpointer b)
+{
+	const MidgardIndexAdvice *aa = *(MidgardIndexAdvice **) a;
+	const MidgardIndexAdvice *ab = *(MidgardIndexAdvice **) b;
+
+	if(aa->total_time > ab->total_time)
+		return -1;
+	if(aa->total_time < ab->total_time)
+		return 1;
+
+	return ab->hits - aa->hits;
+}
+
+static void __collect_advice(gpointer key, gpointer value, gpointer userdata)
+{
+	MidgardIndexAdvice *advice = (MidgardIndexAdvice *) value;
+	GPtrArray *array = (GPtrArray *) userdata;
+
+	MidgardIndexAdvice *copy = g_new(MidgardIndexAdvice, 1);
+	*copy = *advice;
+	copy->classname = g_strdup(advice->classname);
+	copy->table = g_strdup(advice->table);
+	copy->columns = g_strdup(advice->columns);
+
+	g_ptr_array_add(array, copy);
+}
+
+MidgardIndexAdvice **midgard_index_advisor_get_advice(
+		MidgardConnection *mgd, guint min_hits, guint *n_advice)
+{
+	g_return_val_if_fail(mgd != NULL, NULL);
+
+	if(n_advice)
+		*n_advice = 0;
+
+	GPtrArray *all = g_ptr_array_new();
+
+	/* Copy statistics, we do not want to keep lock while querying database */
+	G_LOCK(advisor);
+	if(advisor_stats)
+		g_hash_table_foreach(advisor_stats, __collect_advice, all);
+	G_UNLOCK(advisor);
+
+	GHashTable *table_indexes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	GPtrArray *array = g_ptr_array_new();
+	guint i;
+
+	for(i = 0; i < all->len; i++) {
+
+		MidgardIndexAdvice *advice = g_ptr_array_index(all, i);
+		gboolean covered = FALSE;
+
+		if(advice->hits < min_hits) {
+			__advice_free(advice);
+			continue;
+		}
+
+		GSList *indexes = NULL;
+		if(!g_hash_table_lookup_extended(table_indexes, advice->table, NULL, (gpointer *) &indexes)) {
+			indexes = __get_table_indexes(mgd, advice->table);
+			g_hash_table_insert(table_indexes, g_strdup(advice->table), indexes);
+		}
+
+		GSList *l;
+		for(l = indexes; l != NULL; l = l->next) {
+			if(__index_covers((const gchar *) l->data, advice->columns)) {
+				covered = TRUE;
+				break;
+			}
+		}
+
+		if(covered)
+			__advice_free(advice);
+		else
+			g_ptr_array_add(array, advice);
+	}
+
+	GList *tlist = g_hash_table_get_values(table_indexes);
+	GList *tl;
+	for(tl = tlist; tl != NULL; tl = tl->next) {
+		GSList *l;
+		for(l = (GSList *) tl->data; l != NULL; l = l->next)
+			g_free(l->data);
+		g_slist_free((GSList *) tl->data);
+	}
+	g_list_free(tlist);
+
+	g_hash_table_destroy(table_indexes);
+	g_ptr_array_free(all, TRUE);
+
+	if(array->len == 0) {
+		g_ptr_array_free(array, TRUE);
+		return NULL;
+	}
+
+	g_ptr_array_sort(array, __advice_cmp);
+
+	if(n_advice)
+		*n_advice = array->len;
+
+	g_ptr_array_add(array, NULL);
+
+	return (MidgardIndexAdvice **) g_ptr_array_free(array, FALSE);
+}
+
+void midgard_index_advisor_free_advice(MidgardIndexAdvice **advice)
+{
+	if(advice == NULL)
+		return;
+
+	guint i;
+	for(i = 0; advice[i] != NULL; i++)
+		__advice_free(advice[i]);
+
+	g_free(advice);
+}
+
+gboolean midgard_index_advisor_apply(MidgardConnection *mgd, MidgardIndexAdvice *advice)
+{
+	g_return_val_if_fail(mgd != NULL, FALSE);
+	g_return_val_if_fail(advice != NULL, FALSE);
+
+	/* col1_col2_idx, the same convention single column indexes use */
+	gchar **cols = g_strsplit(advice->columns, ",", 0);
+	gchar *joined = g_strjoinv("_", cols);
+	g_strfreev(cols);
+
+	gchar *index_name = g_strconcat(joined, "_idx", NULL);
+	g_free(joined);
+
+	/* MySQL identifiers' limit */
+	if(strlen(index_name) > 64)
+		index_name[64] = '\0';
+
+	gboolean rv = _midgard_core_query_add_table_index(mgd, advice->table, index_name, advice->columns);
+	g_free(index_name);
+
+	return rv;
+}
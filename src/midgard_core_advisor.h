@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_ADVISOR_H
+#define MIDGARD_CORE_ADVISOR_H
+
+#include "midgard/midgard_index_advisor.h"
+#include "midgard/query_builder.h"
+
+/* The widest composite index suggested */
+#define MIDGARD_ADVISOR_MAX_COLUMNS 3
+
+/* TRUE if statistics are collected. Check it before timing queries. */
+extern gboolean _midgard_core_advisor_is_enabled(void);
+
+/* Records builder's constraints and orders with query execution time */
+extern void _midgard_core_advisor_record(MidgardQueryBuilder *builder, gdouble seconds);
+
+#endif /* MIDGARD_CORE_ADVISOR_H */
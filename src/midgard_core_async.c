@@ -0,0 +1,380 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <string.h>
+#include "midgard_core_async.h"
+#include "midgard/midgard_error.h"
+#include "midgard/midgard_collector.h"
+#include "midgard_core_object.h"
+#include "midgard_core_query_builder.h"
+
+/* Asynchronous queries.
+ *
+ * SQL query is created in caller's thread, sent to database by one of worker
+ * threads and its result is dispatched back to caller's GMainContext.
+ * Every worker uses its own MySQL connection, taken from connection's idle pool,
+ * so many queries can be in flight at the same time without blocking main loop.
+ * Objects are always created and callbacks always invoked in main context's thread. */
+
+typedef enum {
+	MGD_ASYNC_SQL = 0,
+	MGD_ASYNC_BUILDER,
+	MGD_ASYNC_COLLECTOR
+} MgdAsyncType;
+
+typedef struct {
+	MgdAsyncType type;
+	MidgardConnection *mgd;
+	GObject *builder;
+	gchar *sql;
+	GMainContext *context;
+	gpointer func;
+	gpointer user_data;
+
+	/* Set by worker thread */
+	MYSQL_RES *results;
+	gchar *error;
+} MgdAsyncQuery;
+
+static MgdAsyncQuery *__async_query_new(MidgardConnection *mgd, MgdAsyncType type,
+		GObject *builder, gchar *sql, GMainContext *context, gpointer func, gpointer user_data)
+{
+	MgdAsyncQuery *query = g_new0(MgdAsyncQuery, 1);
+
+	query->type = type;
+	query->mgd = g_object_ref(mgd);
+	query->builder = builder ? g_object_ref(builder) : NULL;
+	query->sql = sql;
+	query->context = context ? g_main_context_ref(context) : NULL;
+	query->func = func;
+	query->user_data = user_data;
+
+	return query;
+}
+
+static void __async_query_free(gpointer data)
+{
+	MgdAsyncQuery *query = (MgdAsyncQuery *) data;
+
+	if(query->results)
+		mysql_free_result(query->results);
+
+	if(query->builder)
+		g_object_unref(query->builder);
+
+	if(query->context)
+		g_main_context_unref(query->context);
+
+	g_free(query->sql);
+	g_free(query->error);
+	g_object_unref(query->mgd);
+
+	g_free(query);
+}
+
+static MYSQL *__async_mysql_connect(MidgardConfig *config, gchar **error)
+{
+	MYSQL *mysql = mysql_init(NULL);
+
+	if(mysql == NULL) {
+
+		*error = g_strdup("Can not initialize MySQL connection handler");
+		return NULL;
+	}
+
+	/* Keep the same character set as main connection does */
+	mysql_options(mysql, MYSQL_SET_CHARSET_NAME, "utf8");
+
+	if(!mysql_real_connect(mysql, config->host, config->dbuser, config->dbpass,
+				config->database, 0, NULL, 0)) {
+
+		*error = g_strdup_printf("%s@%s://%s connection failed: %s",
+				config->dbuser, config->host, config->database, mysql_error(mysql));
+		mysql_close(mysql);
+		return NULL;
+	}
+
+	return mysql;
+}
+
+static gboolean __async_dispatch(gpointer data)
+{
+	MgdAsyncQuery *query = (MgdAsyncQuery *) data;
+	MidgardConnection *mgd = query->mgd;
+	MYSQL_RES *results = query->results;
+
+	/* Result is owned by the one who hydrates it */
+	query->results = NULL;
+
+	if(query->error) {
+
+		g_warning("\nASYNC QUERY FAILED: \n %s \n QUERY: \n %s", query->error, query->sql);
+		midgard_set_error(mgd, MGD_GENERIC_ERROR, MGD_ERR_INTERNAL, " %s", query->error);
+
+	} else {
+
+		MIDGARD_ERRNO_SET(mgd->mgd, MGD_ERR_OK);
+	}
+
+	switch(query->type) {
+
+		case MGD_ASYNC_SQL:
+			{
+				midgard_res *res = NULL;
+
+				if(results)
+					res = _mgd_legacy_res_new(mgd->mgd, results);
+
+				((MidgardConnectionQueryFunc) query->func) (mgd, res,
+					query->error == NULL, query->user_data);
+			}
+			break;
+
+		case MGD_ASYNC_BUILDER:
+			{
+				MidgardQueryBuilder *builder = MIDGARD_QUERY_BUILDER(query->builder);
+				GObject **objects = NULL;
+				guint n_objects = 0;
+
+				if(results) {
+
+					GList *list = _midgard_core_qb_set_object_from_result(builder,
+							MQB_SELECT_OBJECT, NULL, results);
+					GList *l;
+					n_objects = g_list_length(list);
+
+					if(n_objects > 0) {
+
+						guint i = 0;
+						objects = g_new(GObject *, n_objects+1);
+						for(l = list; l; l = l->next)
+							objects[i++] = G_OBJECT(l->data);
+						objects[i] = NULL;
+					}
+
+					g_list_free(list);
+				}
+
+				((MidgardQueryBuilderExecuteFunc) query->func) (builder,
+					objects, n_objects, query->user_data);
+			}
+			break;
+
+		case MGD_ASYNC_COLLECTOR:
+			{
+				MidgardCollector *mc = MIDGARD_COLLECTOR(query->builder);
+				gboolean executed = FALSE;
+
+				if(results)
+					executed = _midgard_core_collector_set_from_result(mc, results);
+
+				((MidgardCollectorExecuteFunc) query->func) (mc,
+					executed, query->user_data);
+			}
+			break;
+	}
+
+	return FALSE;
+}
+
+/* Pool threads might be created after main connection, so client library
+ * is initialized once in every one of them, and its thread state is
+ * released when thread exits */
+static void __async_thread_end(gpointer data)
+{
+	mysql_thread_end();
+}
+
+#if GLIB_CHECK_VERSION(2,32,0)
+static GPrivate async_thread_key = G_PRIVATE_INIT(__async_thread_end);
+#define ASYNC_THREAD_KEY (&async_thread_key)
+#else
+static GPrivate *async_thread_key = NULL;
+#define ASYNC_THREAD_KEY (async_thread_key)
+#endif
+
+static void __async_thread_init(void)
+{
+	if(g_private_get(ASYNC_THREAD_KEY) != NULL)
+		return;
+
+	mysql_thread_init();
+	g_private_set(ASYNC_THREAD_KEY, GINT_TO_POINTER(TRUE));
+}
+
+static void __async_worker(gpointer data, gpointer user_data)
+{
+	MgdAsyncQuery *query = (MgdAsyncQuery *) data;
+	MidgardConnectionPrivate *priv = (MidgardConnectionPrivate *) user_data;
+
+	__async_thread_init();
+
+	MYSQL *mysql = (MYSQL *) g_async_queue_try_pop(priv->async_connections);
+
+	if(mysql == NULL)
+		mysql = __async_mysql_connect(priv->config, &query->error);
+
+	if(mysql != NULL) {
+
+		if(mysql_real_query(mysql, query->sql, strlen(query->sql)) != 0) {
+
+			query->error = g_strdup(mysql_error(mysql));
+
+		} else {
+
+			query->results = mysql_store_result(mysql);
+
+			if(query->results == NULL && mysql_field_count(mysql) != 0)
+				query->error = g_strdup(mysql_error(mysql));
+		}
+
+		g_async_queue_push(priv->async_connections, mysql);
+	}
+
+	GSource *source = g_idle_source_new();
+	g_source_set_callback(source, __async_dispatch, query, __async_query_free);
+	g_source_attach(source, query->context);
+	g_source_unref(source);
+}
+
+static gboolean __async_push(MidgardConnection *mgd, MgdAsyncQuery *query)
+{
+	MidgardConnectionPrivate *priv = mgd->priv;
+
+	if(priv->config == NULL) {
+
+		g_warning("Asynchronous queries require connection opened with configuration");
+		__async_query_free(query);
+		return FALSE;
+	}
+
+	if(priv->async_pool == NULL) {
+
+#if !GLIB_CHECK_VERSION(2,32,0)
+		if(!g_thread_supported())
+			g_thread_init(NULL);
+
+		static gsize key_init = 0;
+		if(g_once_init_enter(&key_init)) {
+			async_thread_key = g_private_new(__async_thread_end);
+			g_once_init_leave(&key_init, 1);
+		}
+#endif
+		GError *error = NULL;
+		priv->async_connections = g_async_queue_new();
+		priv->async_pool = g_thread_pool_new(__async_worker, priv,
+				priv->async_workers, FALSE, &error);
+
+		if(priv->async_pool == NULL) {
+
+			g_warning("Can not create asynchronous queries' pool: %s",
+					error ? error->message : "Unknown reason");
+			g_clear_error(&error);
+			g_async_queue_unref(priv->async_connections);
+			priv->async_connections = NULL;
+			__async_query_free(query);
+			return FALSE;
+		}
+	}
+
+	g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "async query=%s", query->sql);
+	g_thread_pool_push(priv->async_pool, query, NULL);
+
+	return TRUE;
+}
+
+void _midgard_core_async_shutdown(MidgardConnection *mgd)
+{
+	MidgardConnectionPrivate *priv = mgd->priv;
+
+	if(priv->async_pool == NULL)
+		return;
+
+	/* Every queued query holds connection's reference, so there should be
+	 * nothing left to do here. Wait for running workers anyway. */
+	g_thread_pool_free(priv->async_pool, FALSE, TRUE);
+	priv->async_pool = NULL;
+
+	MYSQL *mysql;
+	while((mysql = (MYSQL *) g_async_queue_try_pop(priv->async_connections)) != NULL)
+		mysql_close(mysql);
+
+	g_async_queue_unref(priv->async_connections);
+	priv->async_connections = NULL;
+}
+
+void midgard_connection_set_async_workers(MidgardConnection *self, guint workers)
+{
+	g_return_if_fail(self != NULL);
+	g_return_if_fail(workers > 0);
+
+	self->priv->async_workers = workers;
+
+	if(self->priv->async_pool)
+		g_thread_pool_set_max_threads(self->priv->async_pool, workers, NULL);
+}
+
+gboolean midgard_connection_query_async(MidgardConnection *self, const gchar *sql,
+		GMainContext *context, MidgardConnectionQueryFunc func, gpointer user_data)
+{
+	g_return_val_if_fail(self != NULL, FALSE);
+	g_return_val_if_fail(sql != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	MgdAsyncQuery *query = __async_query_new(self, MGD_ASYNC_SQL, NULL, g_strdup(sql),
+			context, func, user_data);
+
+	return __async_push(self, query);
+}
+
+gboolean midgard_query_builder_execute_async(MidgardQueryBuilder *builder,
+		GMainContext *context, MidgardQueryBuilderExecuteFunc func, gpointer user_data)
+{
+	g_return_val_if_fail(builder != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	if(!_midgard_core_qb_is_executable(builder))
+		return FALSE;
+
+	gchar *sql = _midgard_core_qb_get_object_sql(builder, MQB_SELECT_OBJECT);
+	if(!sql)
+		return FALSE;
+
+	MidgardConnection *mgd = builder->priv->mgd->_mgd;
+	MgdAsyncQuery *query = __async_query_new(mgd, MGD_ASYNC_BUILDER, G_OBJECT(builder),
+			sql, context, func, user_data);
+
+	return __async_push(mgd, query);
+}
+
+gboolean midgard_collector_execute_async(MidgardCollector *self,
+		GMainContext *context, MidgardCollectorExecuteFunc func, gpointer user_data)
+{
+	g_return_val_if_fail(self != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	gchar *sql = _midgard_core_collector_get_sql(self);
+	if(!sql)
+		return FALSE;
+
+	MidgardConnection *mgd = _midgard_core_collector_get_builder(self)->priv->mgd->_mgd;
+	MgdAsyncQuery *query = __async_query_new(mgd, MGD_ASYNC_COLLECTOR, G_OBJECT(self),
+			sql, context, func, user_data);
+
+	return __async_push(mgd, query);
+}
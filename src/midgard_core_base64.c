@@ -0,0 +1,509 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <string.h>
+#include "midgard_core_base64.h"
+
+/* BASE64
+ *
+ * Blobs are replicated as base64 text, so they are encoded and decoded
+ * in blocks of 12 (SSSE3) or 24 (AVX2) bytes at once when CPU supports it.
+ * Vector code is compiled for its target only, and chosen at runtime,
+ * so the library still runs on any x86 CPU. Everything else, including
+ * padding, partial blocks and blocks with whitespace or invalid
+ * characters, goes through scalar code which is glib's one.
+ *
+ * Vector code is based on algorithms by Wojciech Mula and Alfred Klomp. */
+
+#if (defined(__x86_64__) || defined(__i386__)) \
+	&& (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define MGD_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+/* Encodes as many whole blocks as possible, returns number of bytes consumed */
+typedef gsize (*MgdBase64EncodeFunc) (const guchar *in, gsize len, gchar *out);
+
+/* Decodes as many valid blocks as possible, returns number of chars consumed.
+ * Output buffer must have len * 3 / 4 bytes. */
+typedef gsize (*MgdBase64DecodeFunc) (const guchar *in, gsize len, guchar *out);
+
+static const gchar base64_alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const guchar base64_rank[256] = {
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255, 62,255,255,255, 63,
+	 52, 53, 54, 55, 56, 57, 58, 59, 60, 61,255,255,255,  0,255,255,
+	255,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,255,255,255,255,255,
+	255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+	255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
+};
+
+static gsize __encode_scalar(const guchar *in, gsize len, gchar *out)
+{
+	const guchar *inptr = in;
+	const guchar *inend = in + len - len % 3;
+
+	while(inptr < inend) {
+
+		guint32 v = (inptr[0] << 16) | (inptr[1] << 8) | inptr[2];
+
+		out[0] = base64_alphabet[v >> 18];
+		out[1] = base64_alphabet[(v >> 12) & 0x3f];
+		out[2] = base64_alphabet[(v >> 6) & 0x3f];
+		out[3] = base64_alphabet[v & 0x3f];
+
+		inptr += 3;
+		out += 4;
+	}
+
+	return inptr - in;
+}
+
+#ifdef MGD_BASE64_X86
+
+/* Spreads 3 bytes of every 32 bit lane into 4 sextets */
+__attribute__ ((target("ssse3")))
+static inline __m128i __enc_reshuffle_ssse3(__m128i in, __m128i shuffle)
+{
+	in = _mm_shuffle_epi8(in, shuffle);
+
+	return _mm_or_si128(
+			_mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+				_mm_set1_epi32(0x04000040)),
+			_mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+				_mm_set1_epi32(0x01000010)));
+}
+
+__attribute__ ((target("ssse3")))
+static inline __m128i __enc_translate_ssse3(__m128i in)
+{
+	const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+			-4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	__m128i mask = _mm_cmpgt_epi8(in, _mm_set1_epi8(25));
+
+	indices = _mm_sub_epi8(indices, mask);
+
+	return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+__attribute__ ((target("ssse3")))
+static gsize __encode_ssse3(const guchar *in, gsize len, gchar *out)
+{
+	const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const guchar *inptr = in;
+
+	/* 16 bytes are loaded, 12 are encoded */
+	while(len - (inptr - in) >= 16) {
+
+		__m128i str = _mm_loadu_si128((const __m128i *) inptr);
+
+		str = __enc_reshuffle_ssse3(str, shuffle);
+		_mm_storeu_si128((__m128i *) out, __enc_translate_ssse3(str));
+
+		inptr += 12;
+		out += 16;
+	}
+
+	return (inptr - in) + __encode_scalar(inptr, len - (inptr - in), out);
+}
+
+__attribute__ ((target("avx2")))
+static inline __m256i __enc_reshuffle_avx2(__m256i in, __m256i shuffle)
+{
+	in = _mm256_shuffle_epi8(in, shuffle);
+
+	return _mm256_or_si256(
+			_mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+				_mm256_set1_epi32(0x04000040)),
+			_mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+				_mm256_set1_epi32(0x01000010)));
+}
+
+__attribute__ ((target("avx2")))
+static inline __m256i __enc_translate_avx2(__m256i in)
+{
+	const __m256i lut = _mm256_setr_epi8(
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	__m256i indices = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+	__m256i mask = _mm256_cmpgt_epi8(in, _mm256_set1_epi8(25));
+
+	indices = _mm256_sub_epi8(indices, mask);
+
+	return _mm256_add_epi8(in, _mm256_shuffle_epi8(lut, indices));
+}
+
+__attribute__ ((target("avx2")))
+static gsize __encode_avx2(const guchar *in, gsize len, gchar *out)
+{
+	const __m256i shuffle = _mm256_setr_epi8(
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const guchar *inptr = in;
+
+	/* Lanes are loaded from 0 and 12, 28 bytes are read, 24 are encoded */
+	while(len - (inptr - in) >= 28) {
+
+		__m256i str = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) inptr)),
+				_mm_loadu_si128((const __m128i *) (inptr + 12)), 1);
+
+		str = __enc_reshuffle_avx2(str, shuffle);
+		_mm256_storeu_si256((__m256i *) out, __enc_translate_avx2(str));
+
+		inptr += 24;
+		out += 32;
+	}
+
+	return (inptr - in) + __encode_ssse3(inptr, len - (inptr - in), out);
+}
+
+__attribute__ ((target("ssse3")))
+static gsize __decode_ssse3(const guchar *in, gsize len, guchar *out)
+{
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+			0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f = _mm_set1_epi8(0x2f);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const guchar *inptr = in;
+
+	/* 16 chars are decoded into 12 bytes, 16 are stored */
+	while(len - (inptr - in) >= 24) {
+
+		__m128i str = _mm_loadu_si128((const __m128i *) inptr);
+		__m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+		__m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+		__m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+		__m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+
+		/* Whitespace, padding or invalid character */
+		if(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())))
+			break;
+
+		__m128i roll = _mm_shuffle_epi8(lut_roll,
+				_mm_add_epi8(_mm_cmpeq_epi8(str, mask_2f), hi_nibbles));
+		str = _mm_add_epi8(str, roll);
+
+		str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+		str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+		_mm_storeu_si128((__m128i *) out, _mm_shuffle_epi8(str, pack));
+
+		inptr += 16;
+		out += 12;
+	}
+
+	return inptr - in;
+}
+
+__attribute__ ((target("avx2")))
+static gsize __decode_avx2(const guchar *in, gsize len, guchar *out)
+{
+	const __m256i lut_lo = _mm256_setr_epi8(
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i lut_hi = _mm256_setr_epi8(
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(
+			0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+	const __m256i pack = _mm256_setr_epi8(
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	const guchar *inptr = in;
+
+	/* 32 chars are decoded into 24 bytes, 32 are stored */
+	while(len - (inptr - in) >= 48) {
+
+		__m256i str = _mm256_loadu_si256((const __m256i *) inptr);
+		__m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+		__m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+		__m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		__m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+
+		if(!_mm256_testz_si256(lo, hi))
+			break;
+
+		__m256i roll = _mm256_shuffle_epi8(lut_roll,
+				_mm256_add_epi8(_mm256_cmpeq_epi8(str, mask_2f), hi_nibbles));
+		str = _mm256_add_epi8(str, roll);
+
+		str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+		str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+		str = _mm256_shuffle_epi8(str, pack);
+		_mm256_storeu_si256((__m256i *) out, _mm256_permutevar8x32_epi32(str, lanes));
+
+		inptr += 32;
+		out += 24;
+	}
+
+	return (inptr - in) + __decode_ssse3(inptr, len - (inptr - in), out);
+}
+
+#endif /* MGD_BASE64_X86 */
+
+static MgdBase64Impl base64_impl = MGD_BASE64_AUTO;
+static MgdBase64EncodeFunc base64_encode = NULL;
+static MgdBase64DecodeFunc base64_decode = NULL;
+
+static gboolean __impl_supported(MgdBase64Impl impl)
+{
+	switch(impl) {
+
+		case MGD_BASE64_SCALAR:
+			return TRUE;
+#ifdef MGD_BASE64_X86
+		case MGD_BASE64_SSSE3:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("ssse3");
+
+		case MGD_BASE64_AVX2:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return FALSE;
+	}
+}
+
+gboolean _midgard_core_base64_set_impl(MgdBase64Impl impl)
+{
+	if(impl == MGD_BASE64_AUTO) {
+
+		impl = MGD_BASE64_SCALAR;
+
+		if(__impl_supported(MGD_BASE64_AVX2))
+			impl = MGD_BASE64_AVX2;
+		else if(__impl_supported(MGD_BASE64_SSSE3))
+			impl = MGD_BASE64_SSSE3;
+	}
+
+	if(!__impl_supported(impl))
+		return FALSE;
+
+	/* Functions are set before implementation, so any thread
+	 * which sees implementation set sees its functions too.
+	 * Racing threads pick the same ones. */
+	switch(impl) {
+#ifdef MGD_BASE64_X86
+		case MGD_BASE64_AVX2:
+			base64_encode = __encode_avx2;
+			base64_decode = __decode_avx2;
+			break;
+
+		case MGD_BASE64_SSSE3:
+			base64_encode = __encode_ssse3;
+			base64_decode = __decode_ssse3;
+			break;
+#endif
+		default:
+			base64_encode = __encode_scalar;
+			base64_decode = NULL;
+			break;
+	}
+
+	g_atomic_int_set((gint *) &base64_impl, impl);
+
+	return TRUE;
+}
+
+MgdBase64Impl _midgard_core_base64_get_impl(void)
+{
+	if(g_atomic_int_get((gint *) &base64_impl) == MGD_BASE64_AUTO)
+		_midgard_core_base64_set_impl(MGD_BASE64_AUTO);
+
+	return (MgdBase64Impl) g_atomic_int_get((gint *) &base64_impl);
+}
+
+gsize _midgard_core_base64_encode_step(const guchar *in, gsize len,
+		gchar *out, gint *state, gint *save)
+{
+	guchar *saved = (guchar *) save;
+	gchar *outptr = out;
+
+	_midgard_core_base64_get_impl();
+
+	if(len == 0)
+		return 0;
+
+	/* Complete triple saved by previous step */
+	if(saved[0] > 0) {
+
+		while(saved[0] < 3 && len > 0) {
+			saved[1 + saved[0]] = *in++;
+			saved[0]++;
+			len--;
+		}
+
+		if(saved[0] < 3)
+			return 0;
+
+		saved[0] = 0;
+		outptr += __encode_scalar(saved + 1, 3, outptr) / 3 * 4;
+	}
+
+	gsize done = base64_encode(in, len, outptr);
+	outptr += done / 3 * 4;
+
+	/* Save the rest, at most two bytes */
+	for(; done < len; done++) {
+		saved[1 + saved[0]] = in[done];
+		saved[0]++;
+	}
+
+	return outptr - out;
+}
+
+gsize _midgard_core_base64_encode_close(gchar *out, gint *state, gint *save)
+{
+	guchar *saved = (guchar *) save;
+	gsize written = 0;
+
+	if(saved[0] > 0) {
+
+		guint c1 = saved[1];
+		guint c2 = saved[0] == 2 ? saved[2] : 0;
+
+		out[0] = base64_alphabet[c1 >> 2];
+		out[1] = base64_alphabet[((c1 & 0x3) << 4) | (c2 >> 4)];
+		out[2] = saved[0] == 2 ? base64_alphabet[(c2 & 0x0f) << 2] : '=';
+		out[3] = '=';
+		written = 4;
+	}
+
+	*save = 0;
+	*state = 0;
+
+	return written;
+}
+
+gsize _midgard_core_base64_decode_step(const gchar *in, gsize len,
+		guchar *out, gint *state, guint *save)
+{
+	const guchar *inptr = (const guchar *) in;
+	const guchar *inend = inptr + len;
+	guchar *outptr = out;
+	guchar last[2] = { 0, 0 };
+	guint v = *save;
+	gint i = *state;
+
+	/* Negative state means previous step ended with padding,
+	 * as in glib. Quad split after its first '=' is decoded correctly. */
+	if(i < 0) {
+		i = -i;
+		last[0] = '=';
+	}
+
+	_midgard_core_base64_get_impl();
+
+	while(inptr < inend) {
+
+		/* Vector code decodes whole quads only */
+		if(i == 0 && base64_decode != NULL) {
+
+			gsize done = base64_decode(inptr, inend - inptr, outptr);
+
+			if(done > 0) {
+				inptr += done;
+				outptr += done / 4 * 3;
+				last[0] = last[1] = 0;
+			}
+		}
+
+		/* Scalar code for the rest of block vector code stopped at */
+		const guchar *stop = inend - inptr > 32 ? inptr + 32 : inend;
+
+		while(inptr < stop) {
+
+			guchar c = *inptr++;
+			guchar rank = base64_rank[c];
+
+			if(rank == 0xff)
+				continue;
+
+			last[1] = last[0];
+			last[0] = c;
+			v = (v << 6) | rank;
+
+			if(++i == 4) {
+
+				*outptr++ = v >> 16;
+				if(last[1] != '=')
+					*outptr++ = v >> 8;
+				if(last[0] != '=')
+					*outptr++ = v;
+				i = 0;
+			}
+		}
+	}
+
+	*save = v;
+	*state = last[0] == '=' ? -i : i;
+
+	return outptr - out;
+}
+
+gchar *_midgard_core_base64_encode(const guchar *data, gsize len)
+{
+	gint state = 0, save = 0;
+	gchar *out = g_malloc((len + 2) / 3 * 4 + 1);
+	gsize outlen;
+
+	outlen = _midgard_core_base64_encode_step(data, len, out, &state, &save);
+	outlen += _midgard_core_base64_encode_close(out + outlen, &state, &save);
+	out[outlen] = '\0';
+
+	return out;
+}
+
+guchar *_midgard_core_base64_decode(const gchar *text, gsize len, gsize *out_len)
+{
+	g_return_val_if_fail(text != NULL, NULL);
+	g_return_val_if_fail(out_len != NULL, NULL);
+
+	gint state = 0;
+	guint save = 0;
+	guchar *out = g_malloc(len * 3 / 4 + 1);
+
+	*out_len = _midgard_core_base64_decode_step(text, len, out, &state, &save);
+
+	return out;
+}
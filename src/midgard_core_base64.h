@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_BASE64_H
+#define MIDGARD_CORE_BASE64_H
+
+#include <glib.h>
+
+/* Base64 implementations, chosen at runtime */
+typedef enum {
+	MGD_BASE64_AUTO = 0,
+	MGD_BASE64_SCALAR,
+	MGD_BASE64_SSSE3,
+	MGD_BASE64_AVX2
+} MgdBase64Impl;
+
+/* Forces implementation, MGD_BASE64_AUTO picks the fastest one CPU supports.
+ * Returns FALSE, and keeps current one, if CPU does not support it. */
+extern gboolean _midgard_core_base64_set_impl(MgdBase64Impl impl);
+
+/* Returns implementation in use */
+extern MgdBase64Impl _midgard_core_base64_get_impl(void);
+
+/* The same as g_base64_encode_step, without line breaks.
+ * Output buffer must be at least (len + 2) / 3 * 4 bytes long. */
+extern gsize _midgard_core_base64_encode_step(const guchar *in, gsize len,
+		gchar *out, gint *state, gint *save);
+
+/* The same as g_base64_encode_close, without line breaks */
+extern gsize _midgard_core_base64_encode_close(gchar *out, gint *state, gint *save);
+
+/* The same as g_base64_decode_step.
+ * Output buffer must be at least len * 3 / 4 bytes long. */
+extern gsize _midgard_core_base64_decode_step(const gchar *in, gsize len,
+		guchar *out, gint *state, guint *save);
+
+/* The same as g_base64_encode */
+extern gchar *_midgard_core_base64_encode(const guchar *data, gsize len);
+
+/* The same as g_base64_decode, for len bytes of text */
+extern guchar *_midgard_core_base64_decode(const gchar *text, gsize len, gsize *out_len);
+
+#endif /* MIDGARD_CORE_BASE64_H */
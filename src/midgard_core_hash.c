@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <string.h>
+#include "midgard_core_hash.h"
+
+/* XXH64
+ *
+ * xxHash 64 bit variant by Yann Collet, following its specification.
+ * Input is consumed in 32 bytes stripes by four accumulators,
+ * tail and avalanche mix the rest. */
+
+#define XXH_PRIME64_1 G_GUINT64_CONSTANT(0x9E3779B185EBCA87)
+#define XXH_PRIME64_2 G_GUINT64_CONSTANT(0xC2B2AE3D27D4EB4F)
+#define XXH_PRIME64_3 G_GUINT64_CONSTANT(0x165667B19E3779F9)
+#define XXH_PRIME64_4 G_GUINT64_CONSTANT(0x85EBCA77C2B2AE63)
+#define XXH_PRIME64_5 G_GUINT64_CONSTANT(0x27D4EB2F165667C5)
+
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline guint64 __read64(const guchar *p)
+{
+	guint64 v;
+	memcpy(&v, p, sizeof(v));
+	return GUINT64_FROM_LE(v);
+}
+
+static inline guint32 __read32(const guchar *p)
+{
+	guint32 v;
+	memcpy(&v, p, sizeof(v));
+	return GUINT32_FROM_LE(v);
+}
+
+static inline guint64 __xxh64_round(guint64 acc, guint64 input)
+{
+	acc += input * XXH_PRIME64_2;
+	acc = XXH_ROTL64(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static inline guint64 __xxh64_merge(guint64 acc, guint64 val)
+{
+	acc ^= __xxh64_round(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void __xxh64_init(guint64 v[4], guint64 seed)
+{
+	v[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+	v[1] = seed + XXH_PRIME64_2;
+	v[2] = seed;
+	v[3] = seed - XXH_PRIME64_1;
+}
+
+/* Consumes whole stripes, returns number of bytes consumed */
+static gsize __xxh64_stripes(guint64 v[4], const guchar *p, gsize len)
+{
+	if(len < 32)
+		return 0;
+
+	const guchar *start = p;
+	const guchar *limit = p + len - 32;
+	guint64 v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+
+	do {
+		v1 = __xxh64_round(v1, __read64(p));
+		v2 = __xxh64_round(v2, __read64(p + 8));
+		v3 = __xxh64_round(v3, __read64(p + 16));
+		v4 = __xxh64_round(v4, __read64(p + 24));
+		p += 32;
+	} while(p <= limit);
+
+	v[0] = v1; v[1] = v2; v[2] = v3; v[3] = v4;
+
+	return p - start;
+}
+
+static guint64 __xxh64_finish(const guint64 v[4], guint64 seed, guint64 total,
+		const guchar *p, gsize len)
+{
+	guint64 h;
+
+	if(total >= 32) {
+
+		h = XXH_ROTL64(v[0], 1) + XXH_ROTL64(v[1], 7)
+			+ XXH_ROTL64(v[2], 12) + XXH_ROTL64(v[3], 18);
+		h = __xxh64_merge(h, v[0]);
+		h = __xxh64_merge(h, v[1]);
+		h = __xxh64_merge(h, v[2]);
+		h = __xxh64_merge(h, v[3]);
+
+	} else {
+
+		h = seed + XXH_PRIME64_5;
+	}
+
+	h += total;
+
+	for(; len >= 8; p += 8, len -= 8) {
+		h ^= __xxh64_round(0, __read64(p));
+		h = XXH_ROTL64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+	}
+
+	if(len >= 4) {
+		h ^= (guint64) __read32(p) * XXH_PRIME64_1;
+		h = XXH_ROTL64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+		len -= 4;
+	}
+
+	for(; len > 0; p++, len--) {
+		h ^= (*p) * XXH_PRIME64_5;
+		h = XXH_ROTL64(h, 11) * XXH_PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+guint64 _midgard_core_hash_xxh64(const guchar *data, gsize len, guint64 seed)
+{
+	g_return_val_if_fail(data != NULL || len == 0, 0);
+
+	guint64 v[4];
+	__xxh64_init(v, seed);
+
+	gsize done = __xxh64_stripes(v, data, len);
+
+	return __xxh64_finish(v, seed, len, data + done, len - done);
+}
+
+/* HASH */
+
+gsize _midgard_core_hash_length(MgdHashType type)
+{
+	return type == MGD_HASH_MD5 ? 16 : 8;
+}
+
+void _midgard_core_hash_init(MgdHash *hash, MgdHashType type)
+{
+	g_return_if_fail(hash != NULL);
+
+	hash->type = type;
+
+	if(type == MGD_HASH_MD5) {
+		_MGD_MD5Init(&hash->ctx.md5);
+		return;
+	}
+
+	__xxh64_init(hash->ctx.xxh64.v, 0);
+	hash->ctx.xxh64.total = 0;
+	hash->ctx.xxh64.buffered = 0;
+}
+
+void _midgard_core_hash_update(MgdHash *hash, const guchar *data, gsize len)
+{
+	g_return_if_fail(hash != NULL);
+	g_return_if_fail(data != NULL || len == 0);
+
+	if(hash->type == MGD_HASH_MD5) {
+
+		/* MD5 takes unsigned int lengths */
+		while(len > G_MAXINT) {
+			_MGD_MD5Update(&hash->ctx.md5, data, G_MAXINT);
+			data += G_MAXINT;
+			len -= G_MAXINT;
+		}
+
+		_MGD_MD5Update(&hash->ctx.md5, data, len);
+		return;
+	}
+
+	guint buffered = hash->ctx.xxh64.buffered;
+	guchar *buffer = hash->ctx.xxh64.buffer;
+
+	hash->ctx.xxh64.total += len;
+
+	if(buffered + len < 32) {
+		memcpy(buffer + buffered, data, len);
+		hash->ctx.xxh64.buffered += len;
+		return;
+	}
+
+	if(buffered > 0) {
+		memcpy(buffer + buffered, data, 32 - buffered);
+		__xxh64_stripes(hash->ctx.xxh64.v, buffer, 32);
+		data += 32 - buffered;
+		len -= 32 - buffered;
+	}
+
+	gsize done = __xxh64_stripes(hash->ctx.xxh64.v, data, len);
+
+	memcpy(buffer, data + done, len - done);
+	hash->ctx.xxh64.buffered = len - done;
+}
+
+gsize _midgard_core_hash_final(MgdHash *hash, guchar *digest)
+{
+	g_return_val_if_fail(hash != NULL, 0);
+	g_return_val_if_fail(digest != NULL, 0);
+
+	if(hash->type == MGD_HASH_MD5) {
+		_MGD_MD5Final(digest, &hash->ctx.md5);
+		return 16;
+	}
+
+	guint64 h = __xxh64_finish(hash->ctx.xxh64.v, 0, hash->ctx.xxh64.total,
+			hash->ctx.xxh64.buffer, hash->ctx.xxh64.buffered);
+
+	h = GUINT64_TO_BE(h);
+	memcpy(digest, &h, sizeof(h));
+
+	return 8;
+}
+
+gsize _midgard_core_hash_digest(MgdHashType type,
+		const guchar *data, gsize len, guchar *digest)
+{
+	g_return_val_if_fail(digest != NULL, 0);
+
+	if(type == MGD_HASH_XXH64) {
+
+		guint64 h = GUINT64_TO_BE(_midgard_core_hash_xxh64(data, len, 0));
+		memcpy(digest, &h, sizeof(h));
+		return 8;
+	}
+
+	MgdHash hash;
+	_midgard_core_hash_init(&hash, type);
+	_midgard_core_hash_update(&hash, data, len);
+
+	return _midgard_core_hash_final(&hash, digest);
+}
+
+gchar *_midgard_core_hash_hex(MgdHashType type, const guchar *data, gsize len)
+{
+	static const gchar hex[] = "0123456789abcdef";
+	guchar digest[MGD_HASH_MAX_LENGTH];
+	gsize i, dlen = _midgard_core_hash_digest(type, data, len, digest);
+	gchar *str = g_malloc(dlen * 2 + 1);
+
+	for(i = 0; i < dlen; i++) {
+		str[i * 2] = hex[digest[i] >> 4];
+		str[i * 2 + 1] = hex[digest[i] & 0x0f];
+	}
+
+	str[dlen * 2] = '\0';
+
+	return str;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_HASH_H
+#define MIDGARD_CORE_HASH_H
+
+#include <glib.h>
+#include "md5.h"
+
+/* Longest digest of all hash types */
+#define MGD_HASH_MAX_LENGTH 16
+
+/* Hash types.
+ * XXH64 is not cryptographic. Use it for cache keys and content
+ * comparison, never for passwords or anything an attacker controls. */
+typedef enum {
+	MGD_HASH_MD5 = 0,
+	MGD_HASH_XXH64
+} MgdHashType;
+
+typedef struct {
+	MgdHashType type;
+	union {
+		_MGD_MD5_CTX md5;
+		struct {
+			guint64 v[4];
+			guint64 total;
+			guchar buffer[32];
+			guint buffered;
+		} xxh64;
+	} ctx;
+} MgdHash;
+
+/* Returns length of type's digest in bytes */
+extern gsize _midgard_core_hash_length(MgdHashType type);
+
+/* Begins hashing. Hash needs no freeing. */
+extern void _midgard_core_hash_init(MgdHash *hash, MgdHashType type);
+
+/* Hashes len bytes of data */
+extern void _midgard_core_hash_update(MgdHash *hash, const guchar *data, gsize len);
+
+/* Ends hashing and writes digest, which must be at least
+ * MGD_HASH_MAX_LENGTH bytes long. XXH64 digest is written in
+ * big endian byte order. Returns digest length. */
+extern gsize _midgard_core_hash_final(MgdHash *hash, guchar *digest);
+
+/* The same as init, update and final */
+extern gsize _midgard_core_hash_digest(MgdHashType type,
+		const guchar *data, gsize len, guchar *digest);
+
+/* Returns newly allocated, lower case hex digest of data */
+extern gchar *_midgard_core_hash_hex(MgdHashType type, const guchar *data, gsize len);
+
+/* Returns XXH64 of data as integer */
+extern guint64 _midgard_core_hash_xxh64(const guchar *data, gsize len, guint64 seed);
+
+#endif /* MIDGARD_CORE_HASH_H */
@@ -28,8 +28,6 @@
 #include "midgard_core_object.h"
 #include "midgard/midgard_blob.h"
 
-static const gchar *MIDGARD_OBJECT_HREF = "http://www.midgard-project.org/midgard_object/1.8";
-
 static void _write_nodes(GObject *object, xmlNodePtr node)
 {
 	g_assert(object);
@@ -47,8 +47,16 @@ struct _MidgardTypePrivate{
 	midgard_object_mysql *_mysql;
 	MYSQL_ROW _mysql_row;
 	gboolean read_only;
+	GHashTable *projection;
+	/* Language settings of builder which selected projection */
+	gint projection_lang;
+	gboolean projection_unset_lang;
+	gint projection_mgd_lang;
 };
 
+/* Namespace of serialized objects */
+#define MIDGARD_OBJECT_HREF "http://www.midgard-project.org/midgard_object/1.8"
+
 #define MGD_OBJECT_GUID(___obj) (MIDGARD_IS_OBJECT(___obj) ? MIDGARD_OBJECT(___obj)->private->guid : MIDGARD_DBOBJECT(___obj)->dbpriv->guid)
 #define MGD_OBJECT_CNC(___obj) (MIDGARD_IS_OBJECT(___obj) ? MIDGARD_OBJECT(___obj)->mgd->_mgd : MIDGARD_DBOBJECT(___obj)->dbpriv->mgd)
 #define MGD_OBJECT_SG(___obj) ___obj->private->sg
@@ -73,6 +81,9 @@ struct _MidgardMetadataPrivate {
 	gboolean hidden;
 	gboolean nav_noentry;
 	guint32 size;
+	/* Size stored in object's record, used by quota */
+	guint32 stored_size;
+	gboolean stored_size_is_set;
 	gchar *published;
 	gchar *exported;
 	gchar *imported;
@@ -114,6 +125,11 @@ struct _MidgardConfigPrivate{
 	guint loghandler;
 	midgard_auth_type authtype;
 	gchar *pamfile;
+	guint pagecache;
+	gchar *pagecache_file;
+	gboolean compactguids;
+	gchar *schemacache_dir;
+	gboolean preparedstatements;
 };
 
 struct _MidgardConnectionPrivate{
@@ -137,6 +153,20 @@ struct _MidgardConnectionPrivate{
 	gboolean enable_replication;
 	gboolean enable_quota;
 	gboolean enable_dbus;
+
+	/* Asynchronous queries */
+	GThreadPool *async_pool;
+	GAsyncQueue *async_connections;
+	guint async_workers;
+
+	/* Quota ledger */
+	gpointer quota_ledger;
+
+	/* Host and page resolver cache */
+	gpointer pagecache;
+
+	/* Access checks' cache */
+	gpointer acl;
 };
 
 #define MGD_CNC_QUOTA(_cnc) _cnc->priv->enable_quota
@@ -186,6 +216,7 @@ gboolean _midgard_object_update(MgdObject *object, _ObjectActionUpdate replicate
 gboolean _midgard_object_create(MgdObject *object, const gchar *create_guid, _ObjectActionUpdate replicate);
 void _object_copy_properties(GObject *src, GObject *dest);
 gboolean _midgard_object_violates_sitegroup(MgdObject *object);
+GValue *_midgard_core_object_get_property_value(MgdObject *self, GParamSpec *pspec);
 
 /* Links */
 gboolean _midgard_core_object_prop_link_is_valid(GType ltype);
@@ -205,6 +236,7 @@ void _midgard_core_dbus_send_serialized_object(MgdObject *object, const gchar *p
 /* Legacy workarounds */
 void id_list_free(gpointer idsptr);
 guint id_list_lookup(gpointer idsptr, const gchar *name);
+midgard_res *_mgd_legacy_res_new(midgard *mgd, MYSQL_RES *mres);
 
 /* MySQL results */
 #define MGD_RES_OBJECT_IDX 24
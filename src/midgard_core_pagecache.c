@@ -0,0 +1,866 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "midgard_core_pagecache.h"
+#include "midgard_mysql.h"
+
+/* PAGE CACHE
+ *
+ * Every connection keeps host, page and style tables in memory, so requests
+ * are resolved without queries. Tables are loaded when needed for the first time.
+ * Element maps merged for page and style are memoised, and share strings
+ * with each other, as the same style elements are used by many pages.
+ * Cache is dropped whenever process' generation changes, which happens when
+ * cached object is written by this process or mgd_cache_touch is called.
+ * Cached tables' signature is checked periodically, to see changes made by
+ * other processes.
+ *
+ * MySQL compares names and prefixes case insensitively, so lookup keys
+ * are folded to lower case.
+ *
+ * With Memory or Shared page cache, mgd_cache_* state is kept in process
+ * instead of cache table. With Shared one, generation counter is kept in
+ * a file mapped by all processes, so invalidation is seen by all of them. */
+
+typedef struct {
+	volatile gint generation;
+} MgdPageCacheShared;
+
+G_LOCK_DEFINE_STATIC(pagecache);
+
+static volatile gint pagecache_generation = 0;
+static MgdPageCacheShared *pagecache_shared = NULL;
+static gboolean pagecache_shared_failed = FALSE;
+
+/* "host:page:lang" of pages cached in generation pagecache_current_generation */
+static GHashTable *pagecache_current = NULL;
+static guint pagecache_current_generation = 0;
+
+/* Classes whose writes invalidate cache */
+static const gchar *pagecache_classes[] = {
+	"midgard_host",
+	"midgard_page",
+	"midgard_pageelement",
+	"midgard_style",
+	"midgard_element",
+	NULL
+};
+
+/* Tables whose signature is checked */
+static const gchar *pagecache_tables[] = {
+	"host",
+	"page",
+	"pageelement",
+	"style",
+	"element",
+	NULL
+};
+
+typedef struct _MgdHostNode MgdHostNode;
+
+/* Prefix trie node. Hosts are kept in node at which their prefix ends. */
+struct _MgdHostNode {
+	gchar c;
+	MgdHostNode *child;
+	MgdHostNode *next;
+	GSList *hosts;
+};
+
+struct _MgdPageCache {
+	guint generation;
+	gchar *signature;
+	GTimer *checked;
+
+	gboolean hosts_loaded;
+	/* hostname, prefix trie root */
+	GHashTable *hosts;
+
+	gboolean pages_loaded;
+	/* id, page */
+	GHashTable *pages;
+	/* "up/name", page */
+	GHashTable *children;
+
+	gboolean styles_loaded;
+	/* id, up */
+	GHashTable *styles;
+
+	/* "page:style:lang:default lang:sitegroup", element map */
+	GHashTable *elements;
+	/* Strings shared by element maps */
+	GHashTable *strings;
+};
+
+static void __node_free(MgdHostNode *node)
+{
+	MgdHostNode *child, *next;
+	GSList *l;
+
+	for(child = node->child; child != NULL; child = next) {
+		next = child->next;
+		__node_free(child);
+	}
+
+	for(l = node->hosts; l != NULL; l = l->next)
+		g_free(l->data);
+
+	g_slist_free(node->hosts);
+	g_free(node);
+}
+
+static MgdHostNode *__node_child(MgdHostNode *node, gchar c, gboolean create)
+{
+	MgdHostNode *child;
+
+	c = g_ascii_tolower(c);
+
+	for(child = node->child; child != NULL; child = child->next) {
+		if(child->c == c)
+			return child;
+	}
+
+	if(!create)
+		return NULL;
+
+	child = g_new0(MgdHostNode, 1);
+	child->c = c;
+	child->next = node->child;
+	node->child = child;
+
+	return child;
+}
+
+/* Port specific host wins, like in "ORDER BY port DESC" */
+static const MgdPageCacheHost *__node_host(MgdHostNode *node, gint port)
+{
+	const MgdPageCacheHost *fallback = NULL;
+	GSList *l;
+
+	for(l = node->hosts; l != NULL; l = l->next) {
+
+		const MgdPageCacheHost *host = (const MgdPageCacheHost *) l->data;
+
+		if(port != 0 && host->port == port)
+			return host;
+
+		if(host->port == 0 && fallback == NULL)
+			fallback = host;
+	}
+
+	return fallback;
+}
+
+static gchar *__name_fold(const gchar *name)
+{
+	if(g_utf8_validate(name, -1, NULL))
+		return g_utf8_strdown(name, -1);
+
+	return g_ascii_strdown(name, -1);
+}
+
+static gchar *__child_key(glong up, const gchar *name)
+{
+	gchar *folded = __name_fold(name);
+	gchar *key = g_strdup_printf("%ld/%s", up, folded);
+	g_free(folded);
+
+	return key;
+}
+
+static void __elements_free(MgdPageCacheElements *elements)
+{
+	/* Strings are owned by cache's strings table */
+	g_ptr_array_free(elements->elements, TRUE);
+	g_free(elements);
+}
+
+static void __elements_clear(MgdPageCache *cache)
+{
+	g_hash_table_remove_all(cache->elements);
+	g_hash_table_remove_all(cache->strings);
+}
+
+static const gchar *__string_share(MgdPageCache *cache, const gchar *str)
+{
+	if(str == NULL)
+		return NULL;
+
+	gchar *shared = g_hash_table_lookup(cache->strings, str);
+
+	if(shared == NULL) {
+		shared = g_strdup(str);
+		g_hash_table_insert(cache->strings, shared, shared);
+	}
+
+	return shared;
+}
+
+static gchar *__elements_key(midgard *mgd, glong page, glong style)
+{
+	return g_strdup_printf("%ld:%ld:%d:%d:%d", page, style,
+			mgd->lang, mgd_get_default_lang(mgd), mgd_sitegroup(mgd));
+}
+
+static void __cache_clear(MgdPageCache *cache)
+{
+	g_free(cache->signature);
+	cache->signature = NULL;
+
+	if(cache->hosts_loaded)
+		g_hash_table_remove_all(cache->hosts);
+	cache->hosts_loaded = FALSE;
+
+	if(cache->pages_loaded) {
+		g_hash_table_remove_all(cache->children);
+		g_hash_table_remove_all(cache->pages);
+	}
+	cache->pages_loaded = FALSE;
+
+	if(cache->styles_loaded)
+		g_hash_table_remove_all(cache->styles);
+	cache->styles_loaded = FALSE;
+
+	__elements_clear(cache);
+}
+
+/* Returns NULL if signature can not be computed */
+static gchar *__signature(midgard *mgd)
+{
+	GString *sql = g_string_new("SELECT CONCAT_WS('|'");
+	guint i;
+
+	for(i = 0; pagecache_tables[i] != NULL; i++) {
+		g_string_append_printf(sql,
+				", (SELECT CONCAT(COUNT(*), ':', "
+				"IFNULL(SUM(metadata_revision), 0), ':', "
+				"IFNULL(SUM(metadata_deleted), 0), ':', "
+				"IFNULL(MAX(metadata_revised), '')) FROM %s)",
+				pagecache_tables[i]);
+	}
+
+	g_string_append(sql, ")");
+
+	gchar *query = g_string_free(sql, FALSE);
+	midgard_res *res = mgd_query(mgd, query);
+	g_free(query);
+
+	if(!res)
+		return NULL;
+
+	gchar *signature = NULL;
+	if(mgd_fetch(res))
+		signature = g_strdup(mgd_colvalue(res, 0));
+
+	mgd_release(res);
+
+	return signature;
+}
+
+/* Temporary directory is writable by everyone, so default file lives in
+ * directory created for this user only. Returns NULL if such directory
+ * exists, but is not a private one. */
+static gchar *__shared_dir(void)
+{
+	struct stat st;
+	gchar *name = g_strdup_printf("midgard-%lu", (gulong) getuid());
+	gchar *dir = g_build_filename(g_get_tmp_dir(), name, NULL);
+	g_free(name);
+
+	mkdir(dir, 0700);
+
+	if(lstat(dir, &st) != 0 || !S_ISDIR(st.st_mode)
+			|| st.st_uid != getuid() || (st.st_mode & 0777) != 0700) {
+
+		g_warning("'%s' is not private directory", dir);
+		g_free(dir);
+		return NULL;
+	}
+
+	return dir;
+}
+
+/* Opens file which is not a link, owned by us and not accessible by others */
+static gint __shared_open(const gchar *path)
+{
+	struct stat st;
+	gint fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+
+	if(fd == -1)
+		return -1;
+
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+			|| st.st_uid != getuid() || (st.st_mode & 0777) != 0600) {
+
+		g_warning("Shared page cache file '%s' must be owned by process' user, with 0600 mode", path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Must be called with pagecache lock */
+static void __shared_map(MidgardConfig *config)
+{
+	gchar *path;
+	gint fd;
+
+	if(pagecache_shared != NULL || pagecache_shared_failed)
+		return;
+
+	if(config->private->pagecache_file) {
+		path = g_strdup(config->private->pagecache_file);
+	} else {
+		gchar *dir = __shared_dir();
+		if(dir == NULL) {
+			g_warning("Can not create shared page cache file. Using memory page cache");
+			pagecache_shared_failed = TRUE;
+			return;
+		}
+		gchar *name = g_strconcat("pagecache-", config->database, NULL);
+		path = g_build_filename(dir, name, NULL);
+		g_free(name);
+		g_free(dir);
+	}
+
+	fd = __shared_open(path);
+
+	if(fd == -1 || ftruncate(fd, sizeof(MgdPageCacheShared)) != 0) {
+
+		g_warning("Can not open shared page cache file '%s'. Using memory page cache", path);
+		if(fd != -1)
+			close(fd);
+		g_free(path);
+		pagecache_shared_failed = TRUE;
+		return;
+	}
+
+	gpointer map = mmap(NULL, sizeof(MgdPageCacheShared),
+			PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(map == MAP_FAILED) {
+
+		g_warning("Can not map shared page cache file '%s'. Using memory page cache", path);
+		g_free(path);
+		pagecache_shared_failed = TRUE;
+		return;
+	}
+
+	g_free(path);
+
+	/* New file is filled with zeros, any generation is fine anyway */
+	pagecache_shared = (MgdPageCacheShared *) map;
+}
+
+static guint __generation(void)
+{
+	guint generation = (guint) g_atomic_int_get(&pagecache_generation);
+
+	if(pagecache_shared)
+		generation += (guint) g_atomic_int_get(&pagecache_shared->generation);
+
+	return generation;
+}
+
+static MgdPageCache *__cache_get(midgard *mgd)
+{
+	MidgardConnection *cnc = mgd->_mgd;
+
+	if(cnc == NULL)
+		return NULL;
+
+	/* Maps shared generation counter, if configured */
+	_midgard_core_pagecache_mode(mgd);
+
+	MgdPageCache *cache = cnc->priv->pagecache;
+	guint generation = __generation();
+
+	if(cache == NULL) {
+
+		cache = g_new0(MgdPageCache, 1);
+		cache->generation = generation;
+		cache->checked = g_timer_new();
+		cache->hosts = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify) __node_free);
+		cache->pages = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				NULL, g_free);
+		cache->children = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, NULL);
+		cache->styles = g_hash_table_new(g_direct_hash, g_direct_equal);
+		cache->elements = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify) __elements_free);
+		cache->strings = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, NULL);
+
+		cnc->priv->pagecache = cache;
+
+		return cache;
+	}
+
+	if(cache->generation != generation) {
+
+		__cache_clear(cache);
+		cache->generation = generation;
+	}
+
+	/* Signature is taken when the first table is loaded */
+	if(cache->signature != NULL
+			&& g_timer_elapsed(cache->checked, NULL) >= MIDGARD_PAGECACHE_CHECK_INTERVAL) {
+
+		gchar *signature = __signature(mgd);
+		g_timer_start(cache->checked);
+
+		if(signature == NULL || !g_str_equal(signature, cache->signature))
+			__cache_clear(cache);
+
+		g_free(signature);
+	}
+
+	return cache;
+}
+
+/* Takes signature before table is loaded, so changes made meanwhile are seen later */
+static gboolean __cache_prepare_load(midgard *mgd, MgdPageCache *cache)
+{
+	if(cache->signature != NULL)
+		return TRUE;
+
+	cache->signature = __signature(mgd);
+	g_timer_start(cache->checked);
+
+	return cache->signature != NULL;
+}
+
+/* Empty result and failed query are both NULL */
+static gboolean __query_failed(midgard *mgd, midgard_res *res)
+{
+	return res == NULL && mysql_errno(mgd->msql->mysql) != 0;
+}
+
+MgdPageCacheMode _midgard_core_pagecache_mode(midgard *mgd)
+{
+	g_assert(mgd != NULL);
+
+	if(mgd->_mgd == NULL || mgd->_mgd->priv->config == NULL)
+		return MGD_PAGECACHE_DATABASE;
+
+	MidgardConfig *config = mgd->_mgd->priv->config;
+	MgdPageCacheMode mode = config->private->pagecache;
+
+	if(mode == MGD_PAGECACHE_SHARED && pagecache_shared == NULL) {
+
+		G_LOCK(pagecache);
+		__shared_map(config);
+		G_UNLOCK(pagecache);
+	}
+
+	return mode;
+}
+
+void _midgard_core_pagecache_invalidate(void)
+{
+	g_atomic_int_inc(&pagecache_generation);
+
+	if(pagecache_shared)
+		g_atomic_int_inc(&pagecache_shared->generation);
+}
+
+/* Must be called with pagecache lock */
+static GHashTable *__current_get(void)
+{
+	guint generation = __generation();
+
+	if(pagecache_current == NULL)
+		pagecache_current = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	if(pagecache_current_generation != generation) {
+		g_hash_table_remove_all(pagecache_current);
+		pagecache_current_generation = generation;
+	}
+
+	return pagecache_current;
+}
+
+gboolean _midgard_core_pagecache_is_current(midgard *mgd, glong host, glong page)
+{
+	g_assert(mgd != NULL);
+
+	gboolean is_current;
+	gchar *key = g_strdup_printf("%ld:%ld:%d", host, page, mgd_lang(mgd));
+
+	G_LOCK(pagecache);
+
+	GHashTable *current = __current_get();
+	is_current = g_hash_table_lookup(current, key) != NULL;
+
+	/* Do language 0 fallback, like cache table does */
+	if(!is_current && mgd_lang(mgd) > 0) {
+		g_free(key);
+		key = g_strdup_printf("%ld:%ld:0", host, page);
+		is_current = g_hash_table_lookup(current, key) != NULL;
+	}
+
+	G_UNLOCK(pagecache);
+
+	g_free(key);
+
+	return is_current;
+}
+
+void _midgard_core_pagecache_add(midgard *mgd, glong host, glong page)
+{
+	g_assert(mgd != NULL);
+
+	gchar *key = g_strdup_printf("%ld:%ld:%d", host, page, mgd_lang(mgd));
+
+	G_LOCK(pagecache);
+	g_hash_table_replace(__current_get(), key, GINT_TO_POINTER(TRUE));
+	G_UNLOCK(pagecache);
+}
+
+void _midgard_core_pagecache_class_changed(const gchar *typename)
+{
+	g_return_if_fail(typename != NULL);
+
+	guint i;
+
+	for(i = 0; pagecache_classes[i] != NULL; i++) {
+
+		if(g_str_equal(typename, pagecache_classes[i])) {
+			_midgard_core_pagecache_invalidate();
+			return;
+		}
+	}
+}
+
+void _midgard_core_pagecache_free(MidgardConnection *mgd)
+{
+	g_assert(mgd != NULL);
+
+	MgdPageCache *cache = mgd->priv->pagecache;
+
+	if(cache == NULL)
+		return;
+
+	g_free(cache->signature);
+	g_timer_destroy(cache->checked);
+	g_hash_table_destroy(cache->hosts);
+	g_hash_table_destroy(cache->children);
+	g_hash_table_destroy(cache->pages);
+	g_hash_table_destroy(cache->styles);
+	g_hash_table_destroy(cache->elements);
+	g_hash_table_destroy(cache->strings);
+	g_free(cache);
+
+	mgd->priv->pagecache = NULL;
+}
+
+gboolean _midgard_core_pagecache_hosts(midgard *mgd)
+{
+	g_assert(mgd != NULL);
+
+	MgdPageCache *cache = __cache_get(mgd);
+
+	if(cache == NULL)
+		return FALSE;
+
+	if(cache->hosts_loaded)
+		return TRUE;
+
+	if(!__cache_prepare_load(mgd, cache))
+		return FALSE;
+
+	midgard_res *res = mgd_ungrouped_select(mgd,
+			"id,style,root,lang,info&1,sitegroup,port,name,prefix",
+			"host",
+			"online <> 0 AND host.metadata_deleted=0",
+			NULL);
+
+	if(__query_failed(mgd, res))
+		return FALSE;
+
+	while(res && mgd_fetch(res)) {
+
+		MgdPageCacheHost *host = g_new(MgdPageCacheHost, 1);
+		host->host = atol(mgd_colvalue(res, 0));
+		host->style = atol(mgd_colvalue(res, 1));
+		host->page = atol(mgd_colvalue(res, 2));
+		host->lang = atoi(mgd_colvalue(res, 3));
+		host->auth_required = atoi(mgd_colvalue(res, 4));
+		host->sitegroup = atol(mgd_colvalue(res, 5));
+		host->port = atoi(mgd_colvalue(res, 6));
+
+		const gchar *prefix = mgd_colvalue(res, 8);
+		if(prefix == NULL)
+			prefix = "";
+		host->prefix_length = strlen(prefix);
+
+		gchar *name = g_ascii_strdown(mgd_colvalue(res, 7), -1);
+		MgdHostNode *node = g_hash_table_lookup(cache->hosts, name);
+
+		if(node == NULL) {
+			node = g_new0(MgdHostNode, 1);
+			g_hash_table_insert(cache->hosts, name, node);
+		} else {
+			g_free(name);
+		}
+
+		const gchar *c;
+		for(c = prefix; *c != '\0'; c++)
+			node = __node_child(node, *c, TRUE);
+
+		node->hosts = g_slist_append(node->hosts, host);
+	}
+
+	if(res)
+		mgd_release(res);
+
+	cache->hosts_loaded = TRUE;
+
+	return TRUE;
+}
+
+const MgdPageCacheHost *_midgard_core_pagecache_find_host(midgard *mgd,
+		const gchar *hostname, gint port, const gchar *uri, gboolean null_prefix)
+{
+	g_assert(mgd != NULL);
+	g_return_val_if_fail(hostname != NULL, NULL);
+	g_return_val_if_fail(uri != NULL, NULL);
+
+	MgdPageCache *cache = mgd->_mgd ? mgd->_mgd->priv->pagecache : NULL;
+	g_return_val_if_fail(cache != NULL && cache->hosts_loaded, NULL);
+
+	gchar *name = g_ascii_strdown(hostname, -1);
+	MgdHostNode *node = g_hash_table_lookup(cache->hosts, name);
+	g_free(name);
+
+	if(node == NULL)
+		return NULL;
+
+	if(null_prefix)
+		return __node_host(node, port);
+
+	/* The longest prefix, followed by uri's end or '/', wins */
+	const MgdPageCacheHost *found = NULL;
+	const MgdPageCacheHost *host;
+	const gchar *c;
+
+	if(uri[0] == '\0' || uri[0] == '/')
+		found = __node_host(node, port);
+
+	for(c = uri; *c != '\0'; c++) {
+
+		node = __node_child(node, *c, FALSE);
+
+		if(node == NULL)
+			break;
+
+		if(node->hosts == NULL || (c[1] != '\0' && c[1] != '/'))
+			continue;
+
+		if((host = __node_host(node, port)) != NULL)
+			found = host;
+	}
+
+	return found;
+}
+
+gboolean _midgard_core_pagecache_pages(midgard *mgd)
+{
+	g_assert(mgd != NULL);
+
+	MgdPageCache *cache = __cache_get(mgd);
+
+	if(cache == NULL)
+		return FALSE;
+
+	if(cache->pages_loaded)
+		return TRUE;
+
+	if(!__cache_prepare_load(mgd, cache))
+		return FALSE;
+
+	midgard_res *res = mgd_ungrouped_select(mgd,
+			"id,up,name,style,info&1,info&2,author",
+			"page",
+			"page.metadata_deleted=0",
+			"id");
+
+	if(__query_failed(mgd, res))
+		return FALSE;
+
+	while(res && mgd_fetch(res)) {
+
+		MgdPageCachePage *page = g_new(MgdPageCachePage, 1);
+		page->id = atol(mgd_colvalue(res, 0));
+		page->up = atol(mgd_colvalue(res, 1));
+		page->style = atol(mgd_colvalue(res, 3));
+		page->auth_required = atoi(mgd_colvalue(res, 4));
+		page->active = atoi(mgd_colvalue(res, 5));
+		page->author = atol(mgd_colvalue(res, 6));
+
+		g_hash_table_insert(cache->pages, GINT_TO_POINTER(page->id), page);
+
+		const gchar *pname = mgd_colvalue(res, 2);
+		gchar *key = __child_key(page->up, pname ? pname : "");
+
+		/* Keep the first one, if there are pages with the same name */
+		if(g_hash_table_lookup(cache->children, key) == NULL)
+			g_hash_table_insert(cache->children, key, page);
+		else
+			g_free(key);
+	}
+
+	if(res)
+		mgd_release(res);
+
+	cache->pages_loaded = TRUE;
+
+	return TRUE;
+}
+
+const MgdPageCachePage *_midgard_core_pagecache_get_page(midgard *mgd, glong id)
+{
+	g_assert(mgd != NULL);
+
+	MgdPageCache *cache = mgd->_mgd ? mgd->_mgd->priv->pagecache : NULL;
+	g_return_val_if_fail(cache != NULL && cache->pages_loaded, NULL);
+
+	return g_hash_table_lookup(cache->pages, GINT_TO_POINTER(id));
+}
+
+const MgdPageCachePage *_midgard_core_pagecache_find_page(midgard *mgd,
+		glong up, const gchar *name)
+{
+	g_assert(mgd != NULL);
+	g_return_val_if_fail(name != NULL, NULL);
+
+	MgdPageCache *cache = mgd->_mgd ? mgd->_mgd->priv->pagecache : NULL;
+	g_return_val_if_fail(cache != NULL && cache->pages_loaded, NULL);
+
+	gchar *key = __child_key(up, name);
+	const MgdPageCachePage *page = g_hash_table_lookup(cache->children, key);
+	g_free(key);
+
+	return page;
+}
+
+gboolean _midgard_core_pagecache_styles(midgard *mgd)
+{
+	g_assert(mgd != NULL);
+
+	MgdPageCache *cache = __cache_get(mgd);
+
+	if(cache == NULL)
+		return FALSE;
+
+	if(cache->styles_loaded)
+		return TRUE;
+
+	if(!__cache_prepare_load(mgd, cache))
+		return FALSE;
+
+	/* Deleted styles are not skipped, like in mgd_idfield */
+	midgard_res *res = mgd_ungrouped_select(mgd, "id,up", "style", NULL, NULL);
+
+	if(__query_failed(mgd, res))
+		return FALSE;
+
+	while(res && mgd_fetch(res)) {
+
+		glong up = atol(mgd_colvalue(res, 1));
+
+		if(up != 0)
+			g_hash_table_insert(cache->styles,
+					GINT_TO_POINTER(atol(mgd_colvalue(res, 0))), GINT_TO_POINTER(up));
+	}
+
+	if(res)
+		mgd_release(res);
+
+	cache->styles_loaded = TRUE;
+
+	return TRUE;
+}
+
+glong _midgard_core_pagecache_get_style_up(midgard *mgd, glong id)
+{
+	g_assert(mgd != NULL);
+
+	MgdPageCache *cache = mgd->_mgd ? mgd->_mgd->priv->pagecache : NULL;
+	g_return_val_if_fail(cache != NULL && cache->styles_loaded, 0);
+
+	return GPOINTER_TO_INT(g_hash_table_lookup(cache->styles, GINT_TO_POINTER(id)));
+}
+
+const MgdPageCacheElements *_midgard_core_pagecache_get_elements(midgard *mgd,
+		glong page, glong style)
+{
+	g_assert(mgd != NULL);
+
+	MgdPageCache *cache = mgd->_mgd ? mgd->_mgd->priv->pagecache : NULL;
+	g_return_val_if_fail(cache != NULL, NULL);
+
+	gchar *key = __elements_key(mgd, page, style);
+	const MgdPageCacheElements *elements = g_hash_table_lookup(cache->elements, key);
+	g_free(key);
+
+	return elements;
+}
+
+MgdPageCacheElements *_midgard_core_pagecache_add_elements(midgard *mgd,
+		glong page, glong style, const gchar *title, const gchar *content)
+{
+	g_assert(mgd != NULL);
+
+	MgdPageCache *cache = mgd->_mgd ? mgd->_mgd->priv->pagecache : NULL;
+	g_return_val_if_fail(cache != NULL, NULL);
+
+	/* Do not let rarely used maps grow forever */
+	if(g_hash_table_size(cache->elements) >= MIDGARD_PAGECACHE_MAX_ELEMENTS)
+		__elements_clear(cache);
+
+	MgdPageCacheElements *elements = g_new(MgdPageCacheElements, 1);
+	elements->title = __string_share(cache, title);
+	elements->content = __string_share(cache, content);
+	elements->elements = g_ptr_array_new();
+
+	g_hash_table_replace(cache->elements, __elements_key(mgd, page, style), elements);
+
+	return elements;
+}
+
+void _midgard_core_pagecache_element_add(midgard *mgd, MgdPageCacheElements *elements,
+		const gchar *name, const gchar *value)
+{
+	g_assert(mgd != NULL);
+	g_return_if_fail(elements != NULL);
+	g_return_if_fail(name != NULL);
+
+	MgdPageCache *cache = mgd->_mgd->priv->pagecache;
+
+	g_ptr_array_add(elements->elements, (gpointer) __string_share(cache, name));
+	g_ptr_array_add(elements->elements, (gpointer) __string_share(cache, value ? value : ""));
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_PAGECACHE_H
+#define MIDGARD_CORE_PAGECACHE_H
+
+#include "midgard/midgard_legacy.h"
+#include "midgard/pageresolve.h"
+#include "midgard_core_object.h"
+
+/* Seconds between signature checks of cached tables.
+ * Changes made by other processes are seen after this time. */
+#define MIDGARD_PAGECACHE_CHECK_INTERVAL 5.0
+
+/* Maximal number of memoised element maps per connection */
+#define MIDGARD_PAGECACHE_MAX_ELEMENTS 1024
+
+/* Storage of mgd_cache_* state, PageCache in configuration file */
+typedef enum {
+	MGD_PAGECACHE_DATABASE = 0,
+	MGD_PAGECACHE_MEMORY,
+	MGD_PAGECACHE_SHARED
+} MgdPageCacheMode;
+
+typedef struct _MgdPageCache MgdPageCache;
+
+typedef struct {
+	glong host;
+	glong style;
+	glong page;
+	gint lang;
+	gint auth_required;
+	glong sitegroup;
+	gint port;
+	gint prefix_length;
+} MgdPageCacheHost;
+
+typedef struct {
+	glong id;
+	glong up;
+	glong style;
+	gint auth_required;
+	gint active;
+	glong author;
+} MgdPageCachePage;
+
+typedef struct {
+	const gchar *title;
+	const gchar *content;
+	/* Element name and value pairs, in order of precedence */
+	GPtrArray *elements;
+} MgdPageCacheElements;
+
+/* Returns connection's configured page cache storage.
+ * Shared generation counter is mapped when it's used for the first time. */
+extern MgdPageCacheMode _midgard_core_pagecache_mode(midgard *mgd);
+
+/* Invalidates page caches of all connections in this process,
+ * and in other processes if shared generation counter is mapped */
+extern void _midgard_core_pagecache_invalidate(void);
+
+/* Memory and Shared replacements of cache table */
+
+/* TRUE if page of host has been cached in current language,
+ * or in language 0, since the last invalidation */
+extern gboolean _midgard_core_pagecache_is_current(midgard *mgd, glong host, glong page);
+
+/* Marks page of host as cached in current language */
+extern void _midgard_core_pagecache_add(midgard *mgd, glong host, glong page);
+
+/* Invalidates page caches if objects of given class are cached */
+extern void _midgard_core_pagecache_class_changed(const gchar *typename);
+
+/* Frees connection's page cache */
+extern void _midgard_core_pagecache_free(MidgardConnection *mgd);
+
+/* Loads online hosts, unless already loaded and valid.
+ * Returns FALSE if hosts can not be loaded, SQL should be used then. */
+extern gboolean _midgard_core_pagecache_hosts(midgard *mgd);
+
+/* Returns host matching hostname, port and uri, as mgd_find_host would, or NULL.
+ * Hosts must be loaded. */
+extern const MgdPageCacheHost *_midgard_core_pagecache_find_host(midgard *mgd,
+		const gchar *hostname, gint port, const gchar *uri, gboolean null_prefix);
+
+/* Loads not deleted pages, unless already loaded and valid.
+ * Returns FALSE if pages can not be loaded, SQL should be used then. */
+extern gboolean _midgard_core_pagecache_pages(midgard *mgd);
+
+/* Returns page with given id or NULL. Pages must be loaded. */
+extern const MgdPageCachePage *_midgard_core_pagecache_get_page(midgard *mgd, glong id);
+
+/* Returns page's child with given name or NULL. Pages must be loaded. */
+extern const MgdPageCachePage *_midgard_core_pagecache_find_page(midgard *mgd,
+		glong up, const gchar *name);
+
+/* Loads styles' tree, unless already loaded and valid.
+ * Returns FALSE if styles can not be loaded, SQL should be used then. */
+extern gboolean _midgard_core_pagecache_styles(midgard *mgd);
+
+/* Returns style's parent id or 0. Styles must be loaded. */
+extern glong _midgard_core_pagecache_get_style_up(midgard *mgd, glong id);
+
+/* Returns element map memoised for page and style in connection's
+ * current language and sitegroup, or NULL.
+ * Call it after pages and styles are loaded, so cache is valid. */
+extern const MgdPageCacheElements *_midgard_core_pagecache_get_elements(midgard *mgd,
+		glong page, glong style);
+
+/* Memoises new, empty element map for page and style.
+ * Strings are copied and shared with other maps. */
+extern MgdPageCacheElements *_midgard_core_pagecache_add_elements(midgard *mgd,
+		glong page, glong style, const gchar *title, const gchar *content);
+
+/* Appends element to memoised element map */
+extern void _midgard_core_pagecache_element_add(midgard *mgd, MgdPageCacheElements *elements,
+		const gchar *name, const gchar *value);
+
+#endif /* MIDGARD_CORE_PAGECACHE_H */
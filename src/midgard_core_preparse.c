@@ -0,0 +1,617 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include "midgard_core_preparse.h"
+#include "midgard_core_hash.h"
+
+/* PREPARSE CACHE
+ *
+ * Preparser output depends only on the buffer and contents of elements
+ * included with <(name)>. Output is cached with buffer as the key, together
+ * with names and contents of included elements, in order of inclusion.
+ * Cached output is used if element callback returns the same contents.
+ *
+ * Least recently used entries are dropped when cache grows beyond its size.
+ * Entries are optionally persisted in directory, and read from there
+ * when they are not found in memory.
+ *
+ * Persisted entry layout, all numbers in host byte order:
+ * magic (8 bytes), version (uint32), buffer (string),
+ * number of elements (uint32), elements: name (string), content (string),
+ * output (string)
+ * Strings are stored as uint32 length followed by bytes.
+ * NULL string has G_MAXUINT32 length and no bytes. */
+
+#define PREPARSE_CACHE_MAGIC "MGDPREP"
+#define PREPARSE_CACHE_NULL G_MAXUINT32
+
+typedef struct {
+	gchar *buffer;
+	/* name, content pairs of included elements */
+	GPtrArray *elements;
+	gchar *output;
+	gsize output_length;
+	gsize size;
+	/* Link in LRU queue */
+	GList *link;
+} MgdPreparseEntry;
+
+struct _MgdPreparseRecord {
+	mgd_parser_itf_t itf;
+	gchar *buffer;
+	/* NULL if output is not cached */
+	GString *output;
+	GPtrArray *elements;
+	GTimer *timer;
+};
+
+G_LOCK_DEFINE_STATIC(preparse_cache);
+
+static gsize cache_max_size = MGD_PREPARSE_CACHE_DEFAULT_SIZE;
+static gsize cache_size = 0;
+static gchar *cache_dir = NULL;
+/* buffer, entry */
+static GHashTable *cache_entries = NULL;
+/* Entries, most recently used first */
+static GQueue *cache_lru = NULL;
+
+static mgd_preparse_stats_t cache_stats = { 0, };
+
+static void __elements_free(GPtrArray *elements)
+{
+	guint i;
+
+	for(i = 0; i < elements->len; i++)
+		g_free(g_ptr_array_index(elements, i));
+
+	g_ptr_array_free(elements, TRUE);
+}
+
+static void __entry_free(MgdPreparseEntry *entry)
+{
+	g_free(entry->buffer);
+	__elements_free(entry->elements);
+	g_free(entry->output);
+	g_free(entry);
+}
+
+static gsize __entry_size(MgdPreparseEntry *entry)
+{
+	gsize size = sizeof(MgdPreparseEntry) + strlen(entry->buffer) + entry->output_length;
+	guint i;
+
+	for(i = 0; i < entry->elements->len; i++) {
+
+		const gchar *str = g_ptr_array_index(entry->elements, i);
+		size += sizeof(gpointer) + (str ? strlen(str) : 0);
+	}
+
+	return size;
+}
+
+/* Must be called with preparse_cache lock */
+static void __cache_init(void)
+{
+	if(cache_entries != NULL)
+		return;
+
+	/* Buffer is owned by entry */
+	cache_entries = g_hash_table_new(g_str_hash, g_str_equal);
+	cache_lru = g_queue_new();
+}
+
+/* Must be called with preparse_cache lock */
+static void __cache_remove(MgdPreparseEntry *entry)
+{
+	g_hash_table_remove(cache_entries, entry->buffer);
+	g_queue_delete_link(cache_lru, entry->link);
+	cache_size -= entry->size;
+	__entry_free(entry);
+}
+
+/* Must be called with preparse_cache lock */
+static void __cache_shrink(gsize max_size)
+{
+	while(cache_size > max_size && cache_lru->tail != NULL)
+		__cache_remove((MgdPreparseEntry *) cache_lru->tail->data);
+}
+
+/* Must be called with preparse_cache lock. Takes entry's ownership. */
+static void __cache_insert(MgdPreparseEntry *entry)
+{
+	MgdPreparseEntry *old = g_hash_table_lookup(cache_entries, entry->buffer);
+
+	if(old != NULL)
+		__cache_remove(old);
+
+	entry->size = __entry_size(entry);
+
+	/* Do not let single entry flush the whole cache */
+	if(entry->size > cache_max_size / 2) {
+		__entry_free(entry);
+		return;
+	}
+
+	g_queue_push_head(cache_lru, entry);
+	entry->link = cache_lru->head;
+	g_hash_table_insert(cache_entries, entry->buffer, entry);
+	cache_size += entry->size;
+
+	__cache_shrink(cache_max_size);
+}
+
+/* Copies entry's data, so it can be used without lock */
+static void __entry_copy(MgdPreparseEntry *entry, GPtrArray **elements,
+		gchar **output, gsize *output_length)
+{
+	guint i;
+
+	*elements = g_ptr_array_sized_new(entry->elements->len);
+	for(i = 0; i < entry->elements->len; i++)
+		g_ptr_array_add(*elements, g_strdup(g_ptr_array_index(entry->elements, i)));
+
+	*output = g_strndup(entry->output, entry->output_length);
+	*output_length = entry->output_length;
+}
+
+/* TRUE if itf returns the same contents of elements */
+static gboolean __elements_are_current(GPtrArray *elements, mgd_parser_itf_t *itf)
+{
+	guint i;
+
+	for(i = 0; i < elements->len; i += 2) {
+
+		const gchar *name = g_ptr_array_index(elements, i);
+		const gchar *content = g_ptr_array_index(elements, i + 1);
+		const gchar *current = NULL;
+
+		if(itf->get_element.func != NULL)
+			current = itf->get_element.func(name, itf->get_element.userdata);
+
+		if(current == NULL || content == NULL) {
+
+			if(current != content)
+				return FALSE;
+
+			continue;
+		}
+
+		if(!g_str_equal(current, content))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* PERSISTENCE */
+
+static gchar *__entry_path(const gchar *dir, const gchar *buffer)
+{
+	gsize length = strlen(buffer);
+	gchar *name = g_strdup_printf("%016" G_GINT64_MODIFIER "x-%lu.preparse",
+			_midgard_core_hash_xxh64((const guchar *) buffer, length, 0),
+			(gulong) length);
+	gchar *path = g_build_filename(dir, name, NULL);
+	g_free(name);
+
+	return path;
+}
+
+static void __put_uint(GString *buf, guint32 value)
+{
+	g_string_append_len(buf, (const gchar *) &value, sizeof(value));
+}
+
+static void __put_string(GString *buf, const gchar *str, gsize length)
+{
+	if(str == NULL) {
+		__put_uint(buf, PREPARSE_CACHE_NULL);
+		return;
+	}
+
+	__put_uint(buf, length);
+	g_string_append_len(buf, str, length);
+}
+
+static void __entry_save(const gchar *dir, MgdPreparseEntry *entry)
+{
+	GString *buf = g_string_new("");
+	GError *error = NULL;
+	guint i;
+
+	g_string_append_len(buf, PREPARSE_CACHE_MAGIC, sizeof(PREPARSE_CACHE_MAGIC));
+	__put_uint(buf, MGD_PREPARSE_CACHE_VERSION);
+	__put_string(buf, entry->buffer, strlen(entry->buffer));
+	__put_uint(buf, entry->elements->len / 2);
+
+	for(i = 0; i < entry->elements->len; i++) {
+
+		const gchar *str = g_ptr_array_index(entry->elements, i);
+		__put_string(buf, str, str ? strlen(str) : 0);
+	}
+
+	__put_string(buf, entry->output, entry->output_length);
+
+	gchar *path = __entry_path(dir, entry->buffer);
+
+	if(g_mkdir_with_parents(dir, 0700) != 0) {
+
+		g_debug("Can not create preparse cache directory %s", dir);
+
+	} else if(!g_file_set_contents(path, buf->str, buf->len, &error)) {
+
+		g_debug("Can not write preparse cache %s: %s", path, error->message);
+		g_clear_error(&error);
+	}
+
+	g_free(path);
+	g_string_free(buf, TRUE);
+}
+
+typedef struct {
+	const gchar *pos;
+	const gchar *end;
+	gboolean error;
+} PreparseCacheReader;
+
+static guint32 __get_uint(PreparseCacheReader *reader)
+{
+	guint32 value = 0;
+
+	if(reader->error || (gsize) (reader->end - reader->pos) < sizeof(value)) {
+		reader->error = TRUE;
+		return 0;
+	}
+
+	memcpy(&value, reader->pos, sizeof(value));
+	reader->pos += sizeof(value);
+
+	return value;
+}
+
+static gchar *__get_string(PreparseCacheReader *reader, gsize *length)
+{
+	guint32 len = __get_uint(reader);
+
+	if(reader->error || len == PREPARSE_CACHE_NULL)
+		return NULL;
+
+	if((gsize) (reader->end - reader->pos) < len) {
+		reader->error = TRUE;
+		return NULL;
+	}
+
+	gchar *str = g_strndup(reader->pos, len);
+	reader->pos += len;
+
+	if(length)
+		*length = len;
+
+	return str;
+}
+
+/* Returns NULL if there's no valid entry for buffer */
+static MgdPreparseEntry *__entry_load(const gchar *dir, const gchar *buffer)
+{
+	gchar *path = __entry_path(dir, buffer);
+	gchar *content = NULL;
+	gsize length = 0;
+	guint32 n_elements, i;
+
+	gboolean read = g_file_get_contents(path, &content, &length, NULL);
+	g_free(path);
+
+	if(!read)
+		return NULL;
+
+	PreparseCacheReader reader = { content, content + length, FALSE };
+
+	if(length < sizeof(PREPARSE_CACHE_MAGIC)
+			|| memcmp(content, PREPARSE_CACHE_MAGIC, sizeof(PREPARSE_CACHE_MAGIC)) != 0) {
+		g_free(content);
+		return NULL;
+	}
+
+	reader.pos += sizeof(PREPARSE_CACHE_MAGIC);
+
+	if(__get_uint(&reader) != MGD_PREPARSE_CACHE_VERSION) {
+		g_free(content);
+		return NULL;
+	}
+
+	MgdPreparseEntry *entry = g_new0(MgdPreparseEntry, 1);
+	entry->buffer = __get_string(&reader, NULL);
+	entry->elements = g_ptr_array_new();
+
+	/* Another buffer with the same hash */
+	if(entry->buffer == NULL || !g_str_equal(entry->buffer, buffer))
+		reader.error = TRUE;
+
+	n_elements = __get_uint(&reader);
+
+	for(i = 0; i < n_elements && !reader.error; i++) {
+		g_ptr_array_add(entry->elements, __get_string(&reader, NULL));
+		g_ptr_array_add(entry->elements, __get_string(&reader, NULL));
+	}
+
+	entry->output = __get_string(&reader, &entry->output_length);
+
+	if(entry->output == NULL)
+		reader.error = TRUE;
+
+	g_free(content);
+
+	if(reader.error) {
+		__entry_free(entry);
+		return NULL;
+	}
+
+	return entry;
+}
+
+/* REPLAY AND RECORD */
+
+gboolean _midgard_core_preparse_cache_replay(const gchar *buffer, mgd_parser_itf_t *itf)
+{
+	g_return_val_if_fail(buffer != NULL, FALSE);
+	g_return_val_if_fail(itf != NULL, FALSE);
+
+	MgdPreparseEntry *entry;
+	GPtrArray *elements = NULL;
+	gchar *output = NULL;
+	gsize output_length = 0;
+	gboolean from_disk = FALSE;
+	gchar *dir = NULL;
+
+	G_LOCK(preparse_cache);
+
+	cache_stats.calls++;
+
+	if(cache_max_size == 0) {
+		G_UNLOCK(preparse_cache);
+		return FALSE;
+	}
+
+	__cache_init();
+	entry = g_hash_table_lookup(cache_entries, buffer);
+
+	/* Element callback is not called with lock, it might take a while */
+	if(entry != NULL) {
+
+		__entry_copy(entry, &elements, &output, &output_length);
+		g_queue_unlink(cache_lru, entry->link);
+		g_queue_push_head_link(cache_lru, entry->link);
+
+	} else {
+
+		dir = g_strdup(cache_dir);
+	}
+
+	G_UNLOCK(preparse_cache);
+
+	/* Disk is read without lock, so other threads are not blocked by I/O */
+	if(dir != NULL) {
+
+		entry = __entry_load(dir, buffer);
+		g_free(dir);
+
+		if(entry != NULL) {
+
+			from_disk = TRUE;
+			__entry_copy(entry, &elements, &output, &output_length);
+
+			G_LOCK(preparse_cache);
+			if(cache_max_size > 0) {
+				__cache_init();
+				__cache_insert(entry);
+			} else {
+				__entry_free(entry);
+			}
+			G_UNLOCK(preparse_cache);
+		}
+	}
+
+	if(elements == NULL)
+		return FALSE;
+
+	gboolean current = __elements_are_current(elements, itf);
+	__elements_free(elements);
+
+	if(current)
+		itf->output.func(output, output_length, itf->output.userdata);
+
+	G_LOCK(preparse_cache);
+	if(current && from_disk)
+		cache_stats.disk_hits++;
+	else if(current)
+		cache_stats.hits++;
+	G_UNLOCK(preparse_cache);
+
+	g_free(output);
+
+	return current;
+}
+
+static void __record_output(char *buffer, int len, void *userdata)
+{
+	MgdPreparseRecord *record = (MgdPreparseRecord *) userdata;
+
+	g_string_append_len(record->output, buffer, len);
+	record->itf.output.func(buffer, len, record->itf.output.userdata);
+}
+
+static const char *__record_element(const char *name, GHashTable *userdata)
+{
+	MgdPreparseRecord *record = (MgdPreparseRecord *) userdata;
+
+	const char *content = record->itf.get_element.func(name, record->itf.get_element.userdata);
+
+	g_ptr_array_add(record->elements, g_strdup(name));
+	g_ptr_array_add(record->elements, g_strdup(content));
+
+	return content;
+}
+
+MgdPreparseRecord *_midgard_core_preparse_record_new(const gchar *buffer,
+		mgd_parser_itf_t *itf, mgd_parser_itf_t *lexer_itf)
+{
+	g_return_val_if_fail(buffer != NULL, NULL);
+	g_return_val_if_fail(itf != NULL, NULL);
+	g_return_val_if_fail(lexer_itf != NULL, NULL);
+
+	MgdPreparseRecord *record = g_new0(MgdPreparseRecord, 1);
+	record->itf = *itf;
+	*lexer_itf = *itf;
+
+	G_LOCK(preparse_cache);
+	gboolean enabled = cache_max_size > 0;
+	G_UNLOCK(preparse_cache);
+
+	if(enabled) {
+
+		record->buffer = g_strdup(buffer);
+		record->output = g_string_sized_new(strlen(buffer));
+		record->elements = g_ptr_array_new();
+
+		lexer_itf->output.func = __record_output;
+		lexer_itf->output.userdata = record;
+
+		if(itf->get_element.func != NULL) {
+			lexer_itf->get_element.func = __record_element;
+			lexer_itf->get_element.userdata = record;
+		}
+	}
+
+	record->timer = g_timer_new();
+
+	/* Count input here, output might not be recorded */
+	G_LOCK(preparse_cache);
+	cache_stats.misses++;
+	cache_stats.bytes_in += strlen(buffer);
+	G_UNLOCK(preparse_cache);
+
+	return record;
+}
+
+void _midgard_core_preparse_record_finish(MgdPreparseRecord *record)
+{
+	g_return_if_fail(record != NULL);
+
+	gdouble seconds = g_timer_elapsed(record->timer, NULL);
+	g_timer_destroy(record->timer);
+
+	MgdPreparseEntry *entry = NULL;
+
+	if(record->output != NULL) {
+
+		entry = g_new0(MgdPreparseEntry, 1);
+		entry->buffer = record->buffer;
+		entry->elements = record->elements;
+		entry->output_length = record->output->len;
+		entry->output = g_string_free(record->output, FALSE);
+	}
+
+	/* Entry is owned by us until inserted, so it's written without lock */
+	if(entry != NULL) {
+
+		G_LOCK(preparse_cache);
+		gchar *dir = g_strdup(cache_dir);
+		G_UNLOCK(preparse_cache);
+
+		if(dir != NULL)
+			__entry_save(dir, entry);
+
+		g_free(dir);
+	}
+
+	G_LOCK(preparse_cache);
+
+	cache_stats.lex_seconds += seconds;
+
+	if(entry != NULL) {
+
+		cache_stats.bytes_out += entry->output_length;
+
+		if(cache_max_size > 0) {
+			__cache_init();
+			__cache_insert(entry);
+		} else {
+			__entry_free(entry);
+		}
+	}
+
+	G_UNLOCK(preparse_cache);
+
+	g_free(record);
+}
+
+/* PUBLIC API */
+
+void mgd_preparse_cache_set_size(gsize size)
+{
+	G_LOCK(preparse_cache);
+
+	cache_max_size = size;
+
+	if(cache_entries != NULL)
+		__cache_shrink(size);
+
+	G_UNLOCK(preparse_cache);
+}
+
+void mgd_preparse_cache_set_dir(const gchar *dirname)
+{
+	G_LOCK(preparse_cache);
+
+	g_free(cache_dir);
+	cache_dir = g_strdup(dirname);
+
+	G_UNLOCK(preparse_cache);
+}
+
+void mgd_preparse_cache_clear(void)
+{
+	G_LOCK(preparse_cache);
+
+	if(cache_entries != NULL)
+		__cache_shrink(0);
+
+	G_UNLOCK(preparse_cache);
+}
+
+void mgd_preparse_get_stats(mgd_preparse_stats_t *stats)
+{
+	g_return_if_fail(stats != NULL);
+
+	G_LOCK(preparse_cache);
+
+	*stats = cache_stats;
+	stats->entries = cache_entries ? g_hash_table_size(cache_entries) : 0;
+	stats->size = cache_size;
+
+	G_UNLOCK(preparse_cache);
+}
+
+void mgd_preparse_reset_stats(void)
+{
+	G_LOCK(preparse_cache);
+	memset(&cache_stats, 0, sizeof(cache_stats));
+	G_UNLOCK(preparse_cache);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_PREPARSE_H
+#define MIDGARD_CORE_PREPARSE_H
+
+#include "midgard/midgard_legacy.h"
+#include "midgard/pageresolve.h"
+
+/* Increment whenever persisted entry layout or preparser output change */
+#define MGD_PREPARSE_CACHE_VERSION 1
+
+typedef struct _MgdPreparseRecord MgdPreparseRecord;
+
+/* Writes cached output of preparsed buffer with itf's output function.
+ * Output is cached together with contents of all elements included
+ * by buffer, and it's used only if itf returns the same contents.
+ * Returns FALSE if there's no such output, buffer must be preparsed then. */
+extern gboolean _midgard_core_preparse_cache_replay(const gchar *buffer, mgd_parser_itf_t *itf);
+
+/* Starts recording of buffer's preparsing.
+ * lexer_itf is set to the one lexer should use, which passes
+ * output and elements to and from itf. */
+extern MgdPreparseRecord *_midgard_core_preparse_record_new(const gchar *buffer,
+		mgd_parser_itf_t *itf, mgd_parser_itf_t *lexer_itf);
+
+/* Caches recorded output and frees record */
+extern void _midgard_core_preparse_record_finish(MgdPreparseRecord *record);
+
+#endif /* MIDGARD_CORE_PREPARSE_H */
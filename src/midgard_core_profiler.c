@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <string.h>
+#include "midgard_core_profiler.h"
+
+G_LOCK_DEFINE_STATIC(profiler);
+
+static gboolean profiler_enabled = FALSE;
+static gdouble profiler_slow_threshold = MIDGARD_PROFILER_DEFAULT_SLOW_THRESHOLD;
+static MidgardQueryProfileFunc profiler_hook = NULL;
+static gpointer profiler_hook_data = NULL;
+
+/* Ring buffer. profiler_next is index of the next profile to be written */
+static MidgardQueryProfile **profiler_buffer = NULL;
+static guint profiler_size = MIDGARD_PROFILER_DEFAULT_BUFFER_SIZE;
+static guint profiler_next = 0;
+
+static void __profile_free(MidgardQueryProfile *profile)
+{
+	if(profile == NULL)
+		return;
+
+	g_free(profile->sql);
+	g_free(profile->explain);
+	g_free(profile);
+}
+
+static MidgardQueryProfile *__profile_copy(const MidgardQueryProfile *profile)
+{
+	MidgardQueryProfile *copy = g_new(MidgardQueryProfile, 1);
+
+	*copy = *profile;
+	copy->sql = g_strdup(profile->sql);
+	copy->explain = g_strdup(profile->explain);
+
+	return copy;
+}
+
+/* Must be called with profiler lock */
+static void __buffer_clear(void)
+{
+	guint i;
+
+	if(profiler_buffer == NULL)
+		return;
+
+	for(i = 0; i < profiler_size; i++) {
+		__profile_free(profiler_buffer[i]);
+		profiler_buffer[i] = NULL;
+	}
+
+	profiler_next = 0;
+}
+
+void midgard_query_profiler_enable(gboolean toggle)
+{
+	G_LOCK(profiler);
+
+	profiler_enabled = toggle;
+	if(toggle && profiler_buffer == NULL)
+		profiler_buffer = g_new0(MidgardQueryProfile *, profiler_size);
+
+	G_UNLOCK(profiler);
+}
+
+gboolean _midgard_core_profiler_is_enabled(void)
+{
+	return profiler_enabled;
+}
+
+void midgard_query_profiler_set_slow_threshold(gdouble seconds)
+{
+	G_LOCK(profiler);
+	profiler_slow_threshold = seconds;
+	G_UNLOCK(profiler);
+}
+
+void midgard_query_profiler_set_buffer_size(guint size)
+{
+	g_return_if_fail(size > 0);
+
+	G_LOCK(profiler);
+
+	if(profiler_buffer) {
+		__buffer_clear();
+		g_free(profiler_buffer);
+		profiler_buffer = g_new0(MidgardQueryProfile *, size);
+	}
+	profiler_size = size;
+
+	G_UNLOCK(profiler);
+}
+
+void midgard_query_profiler_set_hook(MidgardQueryProfileFunc func, gpointer user_data)
+{
+	G_LOCK(profiler);
+	profiler_hook = func;
+	profiler_hook_data = user_data;
+	G_UNLOCK(profiler);
+}
+
+void midgard_query_profiler_reset(void)
+{
+	G_LOCK(profiler);
+	__buffer_clear();
+	G_UNLOCK(profiler);
+}
+
+MidgardQueryProfile **midgard_query_profiler_get_profiles(guint *n_profiles)
+{
+	GPtrArray *array = g_ptr_array_new();
+	guint i;
+
+	G_LOCK(profiler);
+
+	if(profiler_buffer) {
+
+		/* Start with the oldest one, which is going to be overwritten next */
+		for(i = 0; i < profiler_size; i++) {
+
+			MidgardQueryProfile *profile = profiler_buffer[(profiler_next + i) % profiler_size];
+			if(profile)
+				g_ptr_array_add(array, __profile_copy(profile));
+		}
+	}
+
+	G_UNLOCK(profiler);
+
+	if(n_profiles)
+		*n_profiles = array->len;
+
+	if(array->len == 0) {
+		g_ptr_array_free(array, TRUE);
+		return NULL;
+	}
+
+	g_ptr_array_add(array, NULL);
+
+	return (MidgardQueryProfile **) g_ptr_array_free(array, FALSE);
+}
+
+void midgard_query_profiler_free_profiles(MidgardQueryProfile **profiles)
+{
+	guint i;
+
+	if(profiles == NULL)
+		return;
+
+	for(i = 0; profiles[i] != NULL; i++)
+		__profile_free(profiles[i]);
+
+	g_free(profiles);
+}
+
+static guint64 __results_bytes(MYSQL_RES *results)
+{
+	guint64 bytes = 0;
+	guint fields = mysql_num_fields(results);
+	guint i;
+	unsigned long *lengths;
+
+	while(mysql_fetch_row(results) != NULL) {
+
+		lengths = mysql_fetch_lengths(results);
+		for(i = 0; i < fields; i++)
+			bytes += lengths[i];
+	}
+
+	/* Let caller fetch rows from the beginning */
+	mysql_data_seek(results, 0);
+
+	return bytes;
+}
+
+static gchar *__explain(MYSQL *mysql, const gchar *sql)
+{
+	/* Only SELECT can be explained */
+	while(g_ascii_isspace(*sql))
+		sql++;
+
+	if(g_ascii_strncasecmp(sql, "SELECT", 6) != 0)
+		return NULL;
+
+	gchar *explain_sql = g_strconcat("EXPLAIN ", sql, NULL);
+	gint rv = mysql_query(mysql, explain_sql);
+	g_free(explain_sql);
+
+	if(rv != 0)
+		return NULL;
+
+	MYSQL_RES *results = mysql_store_result(mysql);
+	if(!results)
+		return NULL;
+
+	GString *explain = g_string_new("");
+	MYSQL_FIELD *fields = mysql_fetch_fields(results);
+	guint n_fields = mysql_num_fields(results);
+	MYSQL_ROW row;
+	guint i;
+
+	for(i = 0; i < n_fields; i++)
+		g_string_append_printf(explain, "%s%s", i > 0 ? "\t" : "", fields[i].name);
+	g_string_append_c(explain, '\n');
+
+	while((row = mysql_fetch_row(results)) != NULL) {
+
+		for(i = 0; i < n_fields; i++)
+			g_string_append_printf(explain, "%s%s", i > 0 ? "\t" : "",
+					row[i] ? row[i] : "NULL");
+		g_string_append_c(explain, '\n');
+	}
+
+	mysql_free_result(results);
+
+	return g_string_free(explain, FALSE);
+}
+
+void _midgard_core_profiler_record(MYSQL *mysql, const gchar *sql,
+		MidgardQueryOrigin origin, gdouble seconds, MYSQL_RES *results)
+{
+	g_return_if_fail(sql != NULL);
+
+	if(!profiler_enabled)
+		return;
+
+	guint64 rows = 0;
+	guint64 bytes = 0;
+
+	if(results) {
+
+		rows = mysql_num_rows(results);
+		bytes = __results_bytes(results);
+
+	} else if(mysql) {
+
+		my_ulonglong affected = mysql_affected_rows(mysql);
+		rows = affected == (my_ulonglong) -1 ? 0 : affected;
+	}
+
+	_midgard_core_profiler_record_rows(mysql, sql, origin, seconds, rows, bytes);
+}
+
+void _midgard_core_profiler_record_rows(MYSQL *mysql, const gchar *sql,
+		MidgardQueryOrigin origin, gdouble seconds, guint64 rows, guint64 bytes)
+{
+	g_return_if_fail(sql != NULL);
+
+	if(!profiler_enabled)
+		return;
+
+	MidgardQueryProfile *profile = g_new0(MidgardQueryProfile, 1);
+	profile->sql = g_strdup(sql);
+	profile->origin = origin;
+	profile->seconds = seconds;
+	profile->rows = rows;
+	profile->bytes = bytes;
+
+	if(profiler_slow_threshold > 0 && seconds >= profiler_slow_threshold) {
+
+		profile->slow = TRUE;
+		if(mysql)
+			profile->explain = __explain(mysql, sql);
+		g_message("Slow query (%.4f s): %s", seconds, sql);
+	}
+
+	G_LOCK(profiler);
+	MidgardQueryProfileFunc hook = profiler_hook;
+	gpointer hook_data = profiler_hook_data;
+	G_UNLOCK(profiler);
+
+	/* Hook might take a while, do not keep lock */
+	if(hook)
+		hook(profile, hook_data);
+
+	G_LOCK(profiler);
+
+	if(profiler_buffer) {
+
+		__profile_free(profiler_buffer[profiler_next]);
+		profiler_buffer[profiler_next] = profile;
+		profiler_next = (profiler_next + 1) % profiler_size;
+		profile = NULL;
+	}
+
+	G_UNLOCK(profiler);
+
+	__profile_free(profile);
+}
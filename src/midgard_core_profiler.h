@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_PROFILER_H
+#define MIDGARD_CORE_PROFILER_H
+
+#include "midgard/midgard_query_profiler.h"
+#include "midgard_mysql.h"
+
+#define MIDGARD_PROFILER_DEFAULT_BUFFER_SIZE 100
+#define MIDGARD_PROFILER_DEFAULT_SLOW_THRESHOLD 1.0
+
+/* TRUE if queries are profiled. Check it before timing queries. */
+extern gboolean _midgard_core_profiler_is_enabled(void);
+
+/* Records executed query.
+ * results might be NULL, affected rows are recorded then.
+ * Stored results are rewound, so caller can fetch rows from the beginning. */
+extern void _midgard_core_profiler_record(MYSQL *mysql, const gchar *sql,
+		MidgardQueryOrigin origin, gdouble seconds, MYSQL_RES *results);
+
+/* Records executed query, which returned given number of rows and bytes */
+extern void _midgard_core_profiler_record_rows(MYSQL *mysql, const gchar *sql,
+		MidgardQueryOrigin origin, gdouble seconds, guint64 rows, guint64 bytes);
+
+#endif /* MIDGARD_CORE_PROFILER_H */
@@ -64,6 +64,12 @@ extern gboolean _midgard_core_query_add_index(
 			MidgardConnection *mgd,
 			MidgardDBColumn *mdc);
 
+extern gboolean _midgard_core_query_add_table_index(
+			MidgardConnection *mgd,
+			const gchar *table,
+			const gchar *index_name,
+			const gchar *columns);
+
 extern gboolean _midgard_core_query_create_metadata_columns(
 			MidgardConnection *mgd, 
 			const gchar *tablename);
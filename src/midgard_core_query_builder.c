@@ -58,6 +58,7 @@ MidgardQueryBuilderPrivate *midgard_query_builder_private_new(void)
 	mqbp->grouping_ref = 0;
 	mqbp->group_constraint = NULL;
 	mqbp->joins = NULL;
+	mqbp->projection = NULL;
 
 	return mqbp;
 }
@@ -102,6 +103,9 @@ void midgard_query_builder_private_free(MidgardQueryBuilderPrivate *mqbp)
 	/* free tables */
 	g_hash_table_destroy(mqbp->tables);
 
+	if(mqbp->projection)
+		g_hash_table_unref(mqbp->projection);
+
 	g_free(mqbp);
 }
 
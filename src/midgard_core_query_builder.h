@@ -26,6 +26,7 @@
 #include "query_order.h"
 #include "query_group_constraint.h"
 #include "group_constraint.h"
+#include "midgard_mysql.h"
 
 /** 
  *
@@ -61,6 +62,7 @@ struct _MidgardQueryBuilderPrivate {
 	gboolean include_deleted;
 	gint error;
 	gboolean read_only;
+	GHashTable *projection;
 };
 
 extern MidgardQueryBuilderPrivate *midgard_query_builder_private_new(void);
@@ -148,5 +150,45 @@ extern gboolean _midgard_core_qb_parse_property(
 
 extern gboolean _midgard_core_qb_is_grouping(MidgardQueryBuilder *builder);
 
+/**
+ * \ingroup core_qb
+ *
+ * Checks if builder may be executed: constraint groups are closed,
+ * and sitegroup objects are queried by root only.
+ * Warns and sets error otherwise.
+ */
+extern gboolean _midgard_core_qb_is_executable(MidgardQueryBuilder *builder);
+
 extern GList *_midgard_core_qb_set_object_from_query(MidgardQueryBuilder *builder, guint select_type, MgdObject *object);
+
+/**
+ * \ingroup core_qb
+ *
+ * Creates SQL query string for the given select type, the same one which is
+ * executed by _midgard_core_qb_set_object_from_query.
+ */
+extern gchar *_midgard_core_qb_get_object_sql(MidgardQueryBuilder *builder, guint select_type);
+
+/**
+ * \ingroup core_qb
+ *
+ * Creates objects from already fetched results.
+ * Results are owned by this function, caller should not free them.
+ */
+extern GList *_midgard_core_qb_set_object_from_result(MidgardQueryBuilder *builder, guint select_type, 
+		MgdObject *object, MYSQL_RES *results);
+
+/**
+ * \ingroup core_qb
+ *
+ * Loads properties which were not selected with object's projection.
+ * Invoked when such property is accessed for the first time.
+ */
+extern gboolean _midgard_core_qb_load_projected(MgdObject *object);
+
+/* Collector's counterparts */
+extern MidgardQueryBuilder *_midgard_core_collector_get_builder(MidgardCollector *self);
+extern gchar *_midgard_core_collector_get_sql(MidgardCollector *self);
+extern gboolean _midgard_core_collector_set_from_result(MidgardCollector *self, MYSQL_RES *results);
+
 #endif /* MIDGARD_CORE_QB_H */
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_QUOTA_H
+#define MIDGARD_CORE_QUOTA_H
+
+#include "midgard/midgard_quota.h"
+#include "midgard_core_object.h"
+
+/* Flush ledger's deltas to quota table after this number of writes... */
+#define MIDGARD_QUOTA_FLUSH_WRITES 32
+/* ...or when the oldest delta is older than this number of seconds */
+#define MIDGARD_QUOTA_FLUSH_INTERVAL 5.0
+/* Reload quota records changed by other processes, in seconds */
+#define MIDGARD_QUOTA_RECONCILE_INTERVAL 60.0
+
+typedef struct _MgdQuotaLedger MgdQuotaLedger;
+
+/* Flushes pending deltas and frees connection's quota ledger */
+extern void _midgard_core_quota_ledger_free(MidgardConnection *mgd);
+
+#endif /* MIDGARD_CORE_QUOTA_H */
@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <stdlib.h>
+#include <string.h>
+#include "midgard_core_rowset.h"
+#include "midgard_core_object.h"
+
+/* ROW SETS
+ *
+ * Text protocol returns every value as string, which is converted
+ * with atoi or g_ascii_strtod for every column of every row.
+ * Prepared statements use binary protocol, so integer and floating point
+ * columns are bound to native buffers and read without conversion.
+ * Other columns, temporal ones included, are bound to string buffers
+ * of column's longest value, so client library formats them the same way
+ * text protocol does.
+ *
+ * Both protocols are read with the same functions, so results of
+ * multiple statements, which can not be prepared, are read the same way.
+ *
+ * Prepared statement takes three round trips (prepare, execute and close)
+ * instead of one, and query builder's SQL embeds values, so statements
+ * can not be reused. Text protocol is used unless PreparedStatements
+ * is enabled in configuration, which pays off for results with many
+ * numeric columns only. */
+
+typedef enum {
+	MGD_ROWSET_STRING = 0,
+	MGD_ROWSET_INT,
+	MGD_ROWSET_DOUBLE
+} MgdRowSetType;
+
+typedef struct {
+	MgdRowSetType type;
+	union {
+		long long i;
+		double d;
+	} num;
+	gchar *buf;
+	unsigned long buf_size;
+	unsigned long length;
+	my_bool is_null;
+	my_bool error;
+	/* Numbers read as strings */
+	gchar str[G_ASCII_DTOSTR_BUF_SIZE];
+} MgdRowSetColumn;
+
+struct _MgdRowSet {
+	/* Text protocol */
+	MYSQL_RES *res;
+	MYSQL_ROW row;
+
+	/* Binary protocol */
+	MYSQL_STMT *stmt;
+	MYSQL_RES *meta;
+	MYSQL_BIND *bind;
+	MgdRowSetColumn *columns;
+
+	MYSQL_FIELD *fields;
+	guint n_fields;
+	guint64 bytes;
+};
+
+MgdRowSet *_midgard_core_rowset_new(MYSQL_RES *results)
+{
+	g_assert(results != NULL);
+
+	MgdRowSet *rows = g_new0(MgdRowSet, 1);
+	rows->res = results;
+	rows->fields = mysql_fetch_fields(results);
+	rows->n_fields = mysql_num_fields(results);
+
+	return rows;
+}
+
+static gboolean __bind(MgdRowSet *rows)
+{
+	guint i;
+
+	rows->fields = mysql_fetch_fields(rows->meta);
+	rows->n_fields = mysql_num_fields(rows->meta);
+	rows->bind = g_new0(MYSQL_BIND, rows->n_fields);
+	rows->columns = g_new0(MgdRowSetColumn, rows->n_fields);
+
+	for(i = 0; i < rows->n_fields; i++) {
+
+		MYSQL_FIELD *field = &rows->fields[i];
+		MYSQL_BIND *bind = &rows->bind[i];
+		MgdRowSetColumn *column = &rows->columns[i];
+
+		bind->is_null = &column->is_null;
+		bind->length = &column->length;
+		bind->error = &column->error;
+
+		switch(field->type) {
+
+			case MYSQL_TYPE_TINY:
+			case MYSQL_TYPE_SHORT:
+			case MYSQL_TYPE_INT24:
+			case MYSQL_TYPE_LONG:
+			case MYSQL_TYPE_LONGLONG:
+			case MYSQL_TYPE_YEAR:
+				column->type = MGD_ROWSET_INT;
+				bind->buffer_type = MYSQL_TYPE_LONGLONG;
+				bind->buffer = &column->num.i;
+				bind->is_unsigned = (field->flags & UNSIGNED_FLAG) != 0;
+				break;
+
+			case MYSQL_TYPE_FLOAT:
+			case MYSQL_TYPE_DOUBLE:
+				column->type = MGD_ROWSET_DOUBLE;
+				bind->buffer_type = MYSQL_TYPE_DOUBLE;
+				bind->buffer = &column->num.d;
+				break;
+
+			default:
+				/* max_length is updated when rows are stored */
+				column->type = MGD_ROWSET_STRING;
+				column->buf_size = field->max_length + 1;
+				column->buf = g_malloc(column->buf_size);
+				bind->buffer_type = MYSQL_TYPE_STRING;
+				bind->buffer = column->buf;
+				bind->buffer_length = column->buf_size;
+				break;
+		}
+	}
+
+	return mysql_stmt_bind_result(rows->stmt, rows->bind) == 0;
+}
+
+gboolean _midgard_core_rowset_use_prepared(MidgardConnection *mgd)
+{
+	return mgd != NULL
+		&& mgd->priv->config != NULL
+		&& mgd->priv->config->private->preparedstatements;
+}
+
+MgdRowSet *_midgard_core_rowset_query(MYSQL *mysql, const gchar *sql, gboolean prepared)
+{
+	g_assert(mysql != NULL);
+	g_assert(sql != NULL);
+
+	if(!prepared) {
+
+		MYSQL_RES *results = NULL;
+
+		if(mysql_query(mysql, sql) != 0
+				|| (results = mysql_store_result(mysql)) == NULL) {
+
+			g_warning("\nQUERY FAILED: \n %s \n QUERY: \n %s", mysql_error(mysql), sql);
+			return NULL;
+		}
+
+		return _midgard_core_rowset_new(results);
+	}
+
+	MYSQL_STMT *stmt = mysql_stmt_init(mysql);
+
+	if(stmt == NULL) {
+
+		g_warning("\nQUERY FAILED: \n %s \n QUERY: \n %s", mysql_error(mysql), sql);
+		return NULL;
+	}
+
+	MgdRowSet *rows = g_new0(MgdRowSet, 1);
+	rows->stmt = stmt;
+
+	my_bool update_max_length = 1;
+
+	if(mysql_stmt_prepare(stmt, sql, strlen(sql)) != 0
+			|| mysql_stmt_attr_set(stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &update_max_length) != 0
+			|| mysql_stmt_execute(stmt) != 0
+			|| mysql_stmt_store_result(stmt) != 0
+			|| (rows->meta = mysql_stmt_result_metadata(stmt)) == NULL
+			|| !__bind(rows)) {
+
+		g_warning("\nQUERY FAILED: \n %s \n QUERY: \n %s", mysql_stmt_error(stmt), sql);
+		_midgard_core_rowset_free(rows);
+		return NULL;
+	}
+
+	return rows;
+}
+
+guint64 _midgard_core_rowset_num_rows(MgdRowSet *rows)
+{
+	g_assert(rows != NULL);
+
+	if(rows->res)
+		return mysql_num_rows(rows->res);
+
+	return mysql_stmt_num_rows(rows->stmt);
+}
+
+guint _midgard_core_rowset_num_fields(MgdRowSet *rows)
+{
+	g_assert(rows != NULL);
+
+	return rows->n_fields;
+}
+
+const gchar *_midgard_core_rowset_field_name(MgdRowSet *rows, guint col)
+{
+	g_assert(rows != NULL);
+	g_return_val_if_fail(col < rows->n_fields, NULL);
+
+	return rows->fields[col].name;
+}
+
+guint64 _midgard_core_rowset_bytes(MgdRowSet *rows)
+{
+	g_assert(rows != NULL);
+
+	return rows->bytes;
+}
+
+/* Fetches string columns longer than their buffers again */
+static gint __fetch_truncated(MgdRowSet *rows)
+{
+	guint i;
+	gboolean rebind = FALSE;
+
+	for(i = 0; i < rows->n_fields; i++) {
+
+		MgdRowSetColumn *column = &rows->columns[i];
+
+		if(column->type != MGD_ROWSET_STRING
+				|| column->is_null
+				|| column->length < column->buf_size)
+			continue;
+
+		column->buf_size = column->length + 1;
+		column->buf = g_realloc(column->buf, column->buf_size);
+		rows->bind[i].buffer = column->buf;
+		rows->bind[i].buffer_length = column->buf_size;
+		rebind = TRUE;
+
+		if(mysql_stmt_fetch_column(rows->stmt, &rows->bind[i], i, 0) != 0)
+			return 1;
+	}
+
+	if(rebind && mysql_stmt_bind_result(rows->stmt, rows->bind) != 0)
+		return 1;
+
+	return 0;
+}
+
+gboolean _midgard_core_rowset_fetch(MgdRowSet *rows)
+{
+	g_assert(rows != NULL);
+
+	guint i;
+
+	if(rows->res) {
+
+		rows->row = mysql_fetch_row(rows->res);
+
+		if(rows->row == NULL)
+			return FALSE;
+
+		unsigned long *lengths = mysql_fetch_lengths(rows->res);
+		for(i = 0; i < rows->n_fields; i++)
+			rows->bytes += lengths[i];
+
+		return TRUE;
+	}
+
+	gint rv = mysql_stmt_fetch(rows->stmt);
+
+	if(rv == MYSQL_DATA_TRUNCATED)
+		rv = __fetch_truncated(rows);
+
+	if(rv == MYSQL_NO_DATA)
+		return FALSE;
+
+	if(rv != 0) {
+
+		g_warning("Failed to fetch row: %s", mysql_stmt_error(rows->stmt));
+		return FALSE;
+	}
+
+	for(i = 0; i < rows->n_fields; i++) {
+
+		MgdRowSetColumn *column = &rows->columns[i];
+
+		if(column->is_null)
+			continue;
+
+		rows->bytes += column->length;
+
+		if(column->type == MGD_ROWSET_STRING)
+			column->buf[column->length] = '\0';
+	}
+
+	return TRUE;
+}
+
+gboolean _midgard_core_rowset_is_null(MgdRowSet *rows, guint col)
+{
+	g_assert(rows != NULL);
+	g_return_val_if_fail(col < rows->n_fields, TRUE);
+
+	if(rows->res)
+		return rows->row[col] == NULL;
+
+	return rows->columns[col].is_null;
+}
+
+const gchar *_midgard_core_rowset_get_string(MgdRowSet *rows, guint col)
+{
+	g_assert(rows != NULL);
+	g_return_val_if_fail(col < rows->n_fields, NULL);
+
+	if(rows->res)
+		return rows->row[col];
+
+	MgdRowSetColumn *column = &rows->columns[col];
+
+	if(column->is_null)
+		return NULL;
+
+	switch(column->type) {
+
+		case MGD_ROWSET_INT:
+			if(rows->bind[col].is_unsigned)
+				g_snprintf(column->str, sizeof(column->str), "%" G_GUINT64_FORMAT,
+						(guint64) column->num.i);
+			else
+				g_snprintf(column->str, sizeof(column->str), "%" G_GINT64_FORMAT,
+						(gint64) column->num.i);
+			return column->str;
+
+		case MGD_ROWSET_DOUBLE:
+			return g_ascii_dtostr(column->str, sizeof(column->str), column->num.d);
+
+		case MGD_ROWSET_STRING:
+			break;
+	}
+
+	return column->buf;
+}
+
+gint _midgard_core_rowset_get_int(MgdRowSet *rows, guint col)
+{
+	g_assert(rows != NULL);
+	g_return_val_if_fail(col < rows->n_fields, 0);
+
+	if(rows->res)
+		return rows->row[col] ? atoi(rows->row[col]) : 0;
+
+	MgdRowSetColumn *column = &rows->columns[col];
+
+	if(column->is_null)
+		return 0;
+
+	switch(column->type) {
+
+		case MGD_ROWSET_INT:
+			return (gint) column->num.i;
+
+		case MGD_ROWSET_DOUBLE:
+			return (gint) column->num.d;
+
+		case MGD_ROWSET_STRING:
+			break;
+	}
+
+	return atoi(column->buf);
+}
+
+gdouble _midgard_core_rowset_get_double(MgdRowSet *rows, guint col)
+{
+	g_assert(rows != NULL);
+	g_return_val_if_fail(col < rows->n_fields, 0);
+
+	if(rows->res)
+		return rows->row[col] ? g_ascii_strtod(rows->row[col], NULL) : 0;
+
+	MgdRowSetColumn *column = &rows->columns[col];
+
+	if(column->is_null)
+		return 0;
+
+	switch(column->type) {
+
+		case MGD_ROWSET_INT:
+			if(rows->bind[col].is_unsigned)
+				return (gdouble) (guint64) column->num.i;
+			return (gdouble) column->num.i;
+
+		case MGD_ROWSET_DOUBLE:
+			return column->num.d;
+
+		case MGD_ROWSET_STRING:
+			break;
+	}
+
+	return g_ascii_strtod(column->buf, NULL);
+}
+
+void _midgard_core_rowset_set_value(MgdRowSet *rows, guint col, GValue *value)
+{
+	g_assert(rows != NULL);
+	g_assert(value != NULL);
+
+	switch(G_VALUE_TYPE(value)) {
+
+		case G_TYPE_STRING:
+			g_value_set_string(value, _midgard_core_rowset_get_string(rows, col));
+			break;
+
+		case G_TYPE_UINT:
+			g_value_set_uint(value, _midgard_core_rowset_get_int(rows, col));
+			break;
+
+		case G_TYPE_INT:
+			g_value_set_int(value, _midgard_core_rowset_get_int(rows, col));
+			break;
+
+		case G_TYPE_FLOAT:
+			g_value_set_float(value, _midgard_core_rowset_get_double(rows, col));
+			break;
+
+		case G_TYPE_BOOLEAN:
+			g_value_set_boolean(value, _midgard_core_rowset_get_int(rows, col));
+			break;
+	}
+}
+
+void _midgard_core_rowset_free(MgdRowSet *rows)
+{
+	guint i;
+
+	if(rows == NULL)
+		return;
+
+	if(rows->res)
+		mysql_free_result(rows->res);
+
+	if(rows->columns) {
+
+		for(i = 0; i < rows->n_fields; i++)
+			g_free(rows->columns[i].buf);
+		g_free(rows->columns);
+	}
+
+	g_free(rows->bind);
+
+	if(rows->meta)
+		mysql_free_result(rows->meta);
+
+	if(rows->stmt)
+		mysql_stmt_close(rows->stmt);
+
+	g_free(rows);
+}
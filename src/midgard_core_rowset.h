@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_ROWSET_H
+#define MIDGARD_CORE_ROWSET_H
+
+#include <glib-object.h>
+#include "midgard_mysql.h"
+#include "midgard/midgard_legacy.h"
+
+/* Rows of stored result, read with either protocol */
+typedef struct _MgdRowSet MgdRowSet;
+
+/* Wraps text protocol result and takes ownership of it */
+extern MgdRowSet *_midgard_core_rowset_new(MYSQL_RES *results);
+
+/* TRUE if connection's configuration enables PreparedStatements */
+extern gboolean _midgard_core_rowset_use_prepared(MidgardConnection *mgd);
+
+/* Executes SELECT and stores its rows, with text protocol or as prepared
+ * statement. Prepared statement returns integer and floating point columns
+ * in native types, other columns as strings. Returns NULL if query fails. */
+extern MgdRowSet *_midgard_core_rowset_query(MYSQL *mysql, const gchar *sql, gboolean prepared);
+
+extern guint64 _midgard_core_rowset_num_rows(MgdRowSet *rows);
+extern guint _midgard_core_rowset_num_fields(MgdRowSet *rows);
+extern const gchar *_midgard_core_rowset_field_name(MgdRowSet *rows, guint col);
+
+/* Bytes of data fetched so far */
+extern guint64 _midgard_core_rowset_bytes(MgdRowSet *rows);
+
+/* Moves to next row, FALSE if there is none */
+extern gboolean _midgard_core_rowset_fetch(MgdRowSet *rows);
+
+/* Values of current row. Strings are valid until next fetch. */
+extern gboolean _midgard_core_rowset_is_null(MgdRowSet *rows, guint col);
+extern const gchar *_midgard_core_rowset_get_string(MgdRowSet *rows, guint col);
+extern gint _midgard_core_rowset_get_int(MgdRowSet *rows, guint col);
+extern gdouble _midgard_core_rowset_get_double(MgdRowSet *rows, guint col);
+
+/* Sets initialized string, integer, float or boolean value.
+ * NULL is set as NULL string, 0 or FALSE. */
+extern void _midgard_core_rowset_set_value(MgdRowSet *rows, guint col, GValue *value);
+
+extern void _midgard_core_rowset_free(MgdRowSet *rows);
+
+#endif /* MIDGARD_CORE_ROWSET_H */
@@ -0,0 +1,650 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include "midgard_core_schema_cache.h"
+#include "midgard_core_object.h"
+#include "midgard_core_hash.h"
+
+/* Cache file layout, all numbers in host byte order:
+ *
+ * magic (8 bytes), version (uint32), source path (string),
+ * number of stamps (uint32), stamps: path (string), mtime (int64), size (int64),
+ * 	XXH64 of contents (uint64, 0 for directories)
+ * number of types (uint32), types: name (string), type attributes,
+ * 	number of properties (uint32), properties: name (string), property attributes
+ *
+ * Strings are stored as uint32 length followed by NUL terminated bytes.
+ * NULL string has G_MAXUINT32 length and no bytes. */
+
+#define SCHEMA_CACHE_MAGIC "MGDSCHC"
+#define SCHEMA_CACHE_NULL G_MAXUINT32
+
+enum {
+	SCHEMA_CACHE_PROP_DBINDEX = 1 << 0,
+	SCHEMA_CACHE_PROP_MULTILANG = 1 << 1,
+	SCHEMA_CACHE_PROP_LINK = 1 << 2,
+	SCHEMA_CACHE_PROP_PRIMARY = 1 << 3,
+	SCHEMA_CACHE_PROP_REVERSED = 1 << 4
+};
+
+G_LOCK_DEFINE_STATIC(schema_cache);
+
+/* NULL means disabled cache */
+static gchar *cache_dir = NULL;
+
+/* Mapped cache files which types' strings point to.
+ * Regions are never unmapped, loaded types live as long as process does. */
+static GSList *shared_regions = NULL;
+
+void midgard_schema_set_cache_dir(const gchar *dirname)
+{
+	G_LOCK(schema_cache);
+
+	g_free(cache_dir);
+	cache_dir = g_strdup(dirname);
+
+	G_UNLOCK(schema_cache);
+}
+
+gboolean _midgard_core_schema_cache_is_enabled(void)
+{
+	return cache_dir != NULL;
+}
+
+gboolean _midgard_core_schema_cache_owns(gconstpointer data)
+{
+	const gchar *ptr = (const gchar *) data;
+	gboolean owns = FALSE;
+	GSList *l;
+
+	if(ptr == NULL || shared_regions == NULL)
+		return FALSE;
+
+	G_LOCK(schema_cache);
+
+	for(l = shared_regions; l != NULL; l = l->next) {
+
+		GMappedFile *mapped = (GMappedFile *) l->data;
+		const gchar *start = g_mapped_file_get_contents(mapped);
+
+		if(ptr >= start && ptr < start + g_mapped_file_get_length(mapped)) {
+
+			owns = TRUE;
+			break;
+		}
+	}
+
+	G_UNLOCK(schema_cache);
+
+	return owns;
+}
+
+void _midgard_core_schema_string_free(gpointer str)
+{
+	if(!_midgard_core_schema_cache_owns(str))
+		g_free(str);
+}
+
+static gchar *__cache_file(const gchar *path)
+{
+	G_LOCK(schema_cache);
+	gchar *dir = g_strdup(cache_dir);
+	G_UNLOCK(schema_cache);
+
+	if(dir == NULL)
+		return NULL;
+
+	/* Source path is stored in cache, so hash collision is a cache miss only */
+	gchar *name = g_strdup_printf("%08x-%u.cache", g_str_hash(path), (guint) strlen(path));
+	gchar *file = g_build_filename(dir, name, NULL);
+	g_free(name);
+	g_free(dir);
+
+	return file;
+}
+
+/* WRITER */
+
+static void __put_uint(GString *buf, guint32 value)
+{
+	g_string_append_len(buf, (const gchar *) &value, sizeof(value));
+}
+
+static void __put_int64(GString *buf, gint64 value)
+{
+	g_string_append_len(buf, (const gchar *) &value, sizeof(value));
+}
+
+static void __put_uint64(GString *buf, guint64 value)
+{
+	g_string_append_len(buf, (const gchar *) &value, sizeof(value));
+}
+
+static void __put_string(GString *buf, const gchar *str)
+{
+	if(str == NULL) {
+		__put_uint(buf, SCHEMA_CACHE_NULL);
+		return;
+	}
+
+	guint32 length = strlen(str);
+	__put_uint(buf, length);
+	g_string_append_len(buf, str, length + 1);
+}
+
+static void __put_hash_pair(gpointer key, gpointer value, gpointer user_data)
+{
+	__put_string((GString *) user_data, (const gchar *) key);
+	__put_string((GString *) user_data, (const gchar *) value);
+}
+
+static void __put_hash(GString *buf, GHashTable *hash)
+{
+	__put_uint(buf, g_hash_table_size(hash));
+	g_hash_table_foreach(hash, __put_hash_pair, buf);
+}
+
+static void __put_property(gpointer key, gpointer value, gpointer user_data)
+{
+	GString *buf = (GString *) user_data;
+	MgdSchemaPropertyAttr *prop_attr = (MgdSchemaPropertyAttr *) value;
+	guint32 flags = 0;
+
+	__put_string(buf, (const gchar *) key);
+	__put_string(buf, prop_attr->type);
+	__put_string(buf, prop_attr->dbtype);
+	__put_string(buf, prop_attr->field);
+	__put_string(buf, prop_attr->table);
+	__put_string(buf, prop_attr->upfield);
+	__put_string(buf, prop_attr->parentfield);
+	__put_string(buf, prop_attr->primaryfield);
+	__put_string(buf, prop_attr->link);
+	__put_string(buf, prop_attr->link_target);
+	__put_string(buf, prop_attr->description);
+
+	if(prop_attr->dbindex)
+		flags |= SCHEMA_CACHE_PROP_DBINDEX;
+	if(prop_attr->is_multilang)
+		flags |= SCHEMA_CACHE_PROP_MULTILANG;
+	if(prop_attr->is_link)
+		flags |= SCHEMA_CACHE_PROP_LINK;
+	if(prop_attr->is_primary)
+		flags |= SCHEMA_CACHE_PROP_PRIMARY;
+	if(prop_attr->is_reversed)
+		flags |= SCHEMA_CACHE_PROP_REVERSED;
+	__put_uint(buf, flags);
+
+	__put_hash(buf, prop_attr->user_fields);
+}
+
+static void __put_type(GString *buf, const gchar *name, MgdSchemaTypeAttr *type_attr)
+{
+	__put_string(buf, name);
+	__put_string(buf, type_attr->table);
+	__put_string(buf, type_attr->parent);
+	__put_string(buf, type_attr->primary);
+	__put_string(buf, type_attr->property_up);
+	__put_string(buf, type_attr->property_parent);
+	__put_string(buf, type_attr->query->primary);
+	__put_string(buf, type_attr->query->upfield);
+	__put_string(buf, type_attr->query->parentfield);
+	__put_uint(buf, type_attr->use_lang);
+	__put_hash(buf, type_attr->user_values);
+
+	__put_uint(buf, g_hash_table_size(type_attr->prophash));
+	g_hash_table_foreach(type_attr->prophash, __put_property, buf);
+}
+
+/* mtime has one second granularity, so file edited within the same second
+ * and with the same size is detected by its contents' hash only */
+static gboolean __content_hash(const gchar *path, const struct stat *st, guint64 *hash)
+{
+	gchar *content = NULL;
+	gsize length = 0;
+
+	*hash = 0;
+
+	if(S_ISDIR(st->st_mode))
+		return TRUE;
+
+	if(!g_file_get_contents(path, &content, &length, NULL))
+		return FALSE;
+
+	*hash = _midgard_core_hash_xxh64((const guchar *) content, length, 0);
+	g_free(content);
+
+	return TRUE;
+}
+
+static gboolean __put_stamp(GString *buf, const gchar *path)
+{
+	struct stat st;
+	guint64 hash;
+
+	if(g_stat(path, &st) != 0 || !__content_hash(path, &st, &hash))
+		return FALSE;
+
+	__put_string(buf, path);
+	__put_int64(buf, (gint64) st.st_mtime);
+	__put_int64(buf, (gint64) st.st_size);
+	__put_uint64(buf, hash);
+
+	return TRUE;
+}
+
+static void __add_stamp_path(gpointer key, gpointer value, gpointer user_data)
+{
+	GHashTable *paths = (GHashTable *) user_data;
+	const gchar *file = (const gchar *) key;
+
+	g_hash_table_insert(paths, g_strdup(file), NULL);
+
+	/* Directory's mtime changes when schema file is added to included directory */
+	g_hash_table_insert(paths, g_path_get_dirname(file), NULL);
+}
+
+typedef struct {
+	GString *buf;
+	gboolean valid;
+} SchemaCacheStamps;
+
+static void __put_stamp_foreach(gpointer key, gpointer value, gpointer user_data)
+{
+	SchemaCacheStamps *stamps = (SchemaCacheStamps *) user_data;
+
+	if(stamps->valid)
+		stamps->valid = __put_stamp(stamps->buf, (const gchar *) key);
+}
+
+void _midgard_core_schema_cache_save(MidgardSchema *schema, const gchar *path,
+		GHashTable *files, GSList *typenames)
+{
+	g_assert(schema != NULL);
+	g_assert(path != NULL);
+	g_assert(files != NULL);
+
+	gchar *file = __cache_file(path);
+
+	if(file == NULL)
+		return;
+
+	GString *buf = g_string_sized_new(16384);
+	g_string_append_len(buf, SCHEMA_CACHE_MAGIC, sizeof(SCHEMA_CACHE_MAGIC));
+	__put_uint(buf, MIDGARD_SCHEMA_CACHE_VERSION);
+	__put_string(buf, path);
+
+	/* Stamps */
+	GHashTable *paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_hash_table_insert(paths, g_strdup(path), NULL);
+	g_hash_table_foreach(files, __add_stamp_path, paths);
+
+	SchemaCacheStamps stamps = { buf, TRUE };
+	__put_uint(buf, g_hash_table_size(paths));
+	g_hash_table_foreach(paths, __put_stamp_foreach, &stamps);
+	g_hash_table_destroy(paths);
+
+	if(!stamps.valid) {
+
+		g_string_free(buf, TRUE);
+		g_free(file);
+		return;
+	}
+
+	/* Types */
+	GSList *l;
+	__put_uint(buf, g_slist_length(typenames));
+	for(l = typenames; l != NULL; l = l->next) {
+
+		const gchar *name = (const gchar *) l->data;
+		__put_type(buf, name, midgard_schema_lookup_type(schema, (gchar *) name));
+	}
+
+	gchar *dir = g_path_get_dirname(file);
+	GError *error = NULL;
+
+	if(g_mkdir_with_parents(dir, 0700) != 0) {
+
+		g_debug("Can not create schema cache directory %s", dir);
+
+	} else if(!g_file_set_contents(file, buf->str, buf->len, &error)) {
+
+		g_debug("Can not write schema cache %s: %s", file, error->message);
+		g_clear_error(&error);
+	}
+
+	g_free(dir);
+	g_free(file);
+	g_string_free(buf, TRUE);
+}
+
+/* READER */
+
+typedef struct {
+	const gchar *pos;
+	const gchar *end;
+	gboolean error;
+	gboolean shared;
+} SchemaCacheReader;
+
+static gboolean __get_bytes(SchemaCacheReader *reader, gpointer dest, gsize size)
+{
+	if(reader->error || (gsize) (reader->end - reader->pos) < size) {
+
+		reader->error = TRUE;
+		return FALSE;
+	}
+
+	memcpy(dest, reader->pos, size);
+	reader->pos += size;
+
+	return TRUE;
+}
+
+static guint32 __get_uint(SchemaCacheReader *reader)
+{
+	guint32 value = 0;
+	__get_bytes(reader, &value, sizeof(value));
+
+	return value;
+}
+
+static gint64 __get_int64(SchemaCacheReader *reader)
+{
+	gint64 value = 0;
+	__get_bytes(reader, &value, sizeof(value));
+
+	return value;
+}
+
+static guint64 __get_uint64(SchemaCacheReader *reader)
+{
+	guint64 value = 0;
+	__get_bytes(reader, &value, sizeof(value));
+
+	return value;
+}
+
+static gchar *__get_string(SchemaCacheReader *reader)
+{
+	guint32 length = __get_uint(reader);
+
+	if(reader->error || length == SCHEMA_CACHE_NULL)
+		return NULL;
+
+	if((gsize) (reader->end - reader->pos) <= length
+			|| reader->pos[length] != '\0') {
+
+		reader->error = TRUE;
+		return NULL;
+	}
+
+	gchar *str = reader->shared ? (gchar *) reader->pos : g_strndup(reader->pos, length);
+	reader->pos += length + 1;
+
+	return str;
+}
+
+/* Strings which are not freed by caller are copied even if reader is shared */
+static gchar *__get_string_copy(SchemaCacheReader *reader)
+{
+	gboolean shared = reader->shared;
+
+	reader->shared = FALSE;
+	gchar *str = __get_string(reader);
+	reader->shared = shared;
+
+	return str;
+}
+
+static void __get_hash(SchemaCacheReader *reader, GHashTable *hash)
+{
+	guint32 n = __get_uint(reader);
+	guint32 i;
+
+	for(i = 0; i < n && !reader->error; i++) {
+
+		gchar *key = __get_string(reader);
+		gchar *value = __get_string(reader);
+
+		if(key == NULL) {
+
+			reader->error = TRUE;
+			_midgard_core_schema_string_free(value);
+			return;
+		}
+
+		g_hash_table_insert(hash, key, value);
+	}
+}
+
+static gboolean __stamps_are_valid(SchemaCacheReader *reader)
+{
+	guint32 n = __get_uint(reader);
+	guint32 i;
+	struct stat st;
+
+	for(i = 0; i < n && !reader->error; i++) {
+
+		gchar *path = __get_string_copy(reader);
+		gint64 mtime = __get_int64(reader);
+		gint64 size = __get_int64(reader);
+		guint64 hash = __get_uint64(reader);
+		guint64 current;
+
+		if(path == NULL || reader->error) {
+
+			g_free(path);
+			return FALSE;
+		}
+
+		gboolean valid = g_stat(path, &st) == 0
+			&& (gint64) st.st_mtime == mtime
+			&& (gint64) st.st_size == size
+			&& __content_hash(path, &st, &current)
+			&& current == hash;
+		g_free(path);
+
+		if(!valid)
+			return FALSE;
+	}
+
+	return !reader->error;
+}
+
+static MgdSchemaPropertyAttr *__get_property(SchemaCacheReader *reader)
+{
+	MgdSchemaPropertyAttr *prop_attr = _mgd_schema_property_attr_new();
+
+	prop_attr->type = __get_string(reader);
+	prop_attr->gtype = _midgard_core_schema_gtype_from_name(prop_attr->type);
+	prop_attr->dbtype = __get_string(reader);
+	prop_attr->field = __get_string(reader);
+	prop_attr->table = __get_string(reader);
+	prop_attr->upfield = __get_string(reader);
+	prop_attr->parentfield = __get_string(reader);
+	prop_attr->primaryfield = __get_string(reader);
+	prop_attr->link = __get_string(reader);
+	prop_attr->link_target = __get_string(reader);
+
+	gchar *description = __get_string(reader);
+	if(description != NULL) {
+
+		_midgard_core_schema_string_free(prop_attr->description);
+		prop_attr->description = description;
+	}
+
+	guint32 flags = __get_uint(reader);
+	prop_attr->dbindex = (flags & SCHEMA_CACHE_PROP_DBINDEX) != 0;
+	prop_attr->is_multilang = (flags & SCHEMA_CACHE_PROP_MULTILANG) != 0;
+	prop_attr->is_link = (flags & SCHEMA_CACHE_PROP_LINK) != 0;
+	prop_attr->is_primary = (flags & SCHEMA_CACHE_PROP_PRIMARY) != 0;
+	prop_attr->is_reversed = (flags & SCHEMA_CACHE_PROP_REVERSED) != 0;
+
+	__get_hash(reader, prop_attr->user_fields);
+
+	return prop_attr;
+}
+
+static MgdSchemaTypeAttr *__get_type(SchemaCacheReader *reader)
+{
+	MgdSchemaTypeAttr *type_attr = _mgd_schema_type_attr_new();
+	type_attr->cols_idx = MGD_RES_OBJECT_IDX;
+
+	type_attr->table = __get_string(reader);
+	type_attr->parent = __get_string(reader);
+	type_attr->primary = __get_string(reader);
+	type_attr->property_up = __get_string(reader);
+	type_attr->property_parent = __get_string(reader);
+	type_attr->query->primary = __get_string(reader);
+	type_attr->query->upfield = __get_string(reader);
+	type_attr->query->parentfield = __get_string(reader);
+	type_attr->use_lang = __get_uint(reader) != 0;
+	__get_hash(reader, type_attr->user_values);
+
+	guint32 n = __get_uint(reader);
+	guint32 i;
+
+	for(i = 0; i < n && !reader->error; i++) {
+
+		gchar *name = __get_string(reader);
+		MgdSchemaPropertyAttr *prop_attr = __get_property(reader);
+
+		if(name == NULL || reader->error) {
+
+			reader->error = TRUE;
+			_midgard_core_schema_string_free(name);
+			_mgd_schema_property_attr_free(prop_attr);
+			break;
+		}
+
+		g_hash_table_insert(type_attr->prophash, name, prop_attr);
+	}
+
+	if(reader->error) {
+
+		_mgd_schema_type_attr_free(type_attr);
+		return NULL;
+	}
+
+	return type_attr;
+}
+
+gboolean _midgard_core_schema_cache_load(MidgardSchema *schema, const gchar *path)
+{
+	g_assert(schema != NULL);
+	g_assert(path != NULL);
+
+	gchar *file = __cache_file(path);
+
+	if(file == NULL)
+		return FALSE;
+
+	GMappedFile *mapped = g_mapped_file_new(file, FALSE, NULL);
+	g_free(file);
+
+	if(mapped == NULL)
+		return FALSE;
+
+	/* Register region first, so strings of partially read types are not freed */
+	G_LOCK(schema_cache);
+	shared_regions = g_slist_prepend(shared_regions, mapped);
+	G_UNLOCK(schema_cache);
+
+	SchemaCacheReader reader;
+	reader.pos = g_mapped_file_get_contents(mapped);
+	reader.end = reader.pos + g_mapped_file_get_length(mapped);
+	reader.error = FALSE;
+	reader.shared = TRUE;
+
+	gboolean valid = FALSE;
+	gchar magic[sizeof(SCHEMA_CACHE_MAGIC)];
+	gchar *source = NULL;
+	GSList *names = NULL;
+	GSList *types = NULL;
+
+	if(!__get_bytes(&reader, magic, sizeof(magic))
+			|| memcmp(magic, SCHEMA_CACHE_MAGIC, sizeof(magic)) != 0
+			|| __get_uint(&reader) != MIDGARD_SCHEMA_CACHE_VERSION)
+		goto return_valid;
+
+	source = __get_string_copy(&reader);
+	if(source == NULL || !g_str_equal(source, path))
+		goto return_valid;
+
+	if(!__stamps_are_valid(&reader))
+		goto return_valid;
+
+	guint32 n = __get_uint(&reader);
+	guint32 i;
+
+	for(i = 0; i < n && !reader.error; i++) {
+
+		gchar *name = __get_string(&reader);
+
+		if(name == NULL || midgard_schema_lookup_type(schema, name) != NULL) {
+
+			/* Let xml parser report duplicated type */
+			reader.error = TRUE;
+			break;
+		}
+
+		MgdSchemaTypeAttr *type_attr = __get_type(&reader);
+
+		if(type_attr == NULL)
+			break;
+
+		names = g_slist_prepend(names, name);
+		types = g_slist_prepend(types, type_attr);
+	}
+
+	valid = !reader.error;
+
+return_valid:
+
+	g_free(source);
+
+	GSList *ln, *lt;
+	for(ln = names, lt = types; ln != NULL; ln = ln->next, lt = lt->next) {
+
+		if(valid)
+			g_hash_table_insert(schema->types, ln->data, lt->data);
+		else
+			_mgd_schema_type_attr_free((MgdSchemaTypeAttr *) lt->data);
+	}
+
+	g_slist_free(names);
+	g_slist_free(types);
+
+	/* Keep valid region mapped, types' strings point to it */
+	if(!valid) {
+
+		G_LOCK(schema_cache);
+		shared_regions = g_slist_remove(shared_regions, mapped);
+		G_UNLOCK(schema_cache);
+#if GLIB_CHECK_VERSION(2,22,0)
+		g_mapped_file_unref(mapped);
+#else
+		g_mapped_file_free(mapped);
+#endif
+	}
+
+	return valid;
+}
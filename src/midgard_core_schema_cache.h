@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_SCHEMA_CACHE_H
+#define MIDGARD_CORE_SCHEMA_CACHE_H
+
+#include "schema.h"
+
+/* Increment whenever cache layout or parsed MgdSchemaTypeAttr data change */
+#define MIDGARD_SCHEMA_CACHE_VERSION 2
+
+/* TRUE if compiled schema files are cached */
+extern gboolean _midgard_core_schema_cache_is_enabled(void);
+
+/* TRUE if data points to mapped cache file.
+ * Types loaded from cache share strings with mapped file, which is
+ * read only and shared by all processes using the same cache. */
+extern gboolean _midgard_core_schema_cache_owns(gconstpointer data);
+
+/* Frees schema string unless it points to mapped cache file.
+ * Use it instead of g_free for every MgdSchemaTypeAttr and MgdSchemaPropertyAttr string. */
+extern void _midgard_core_schema_string_free(gpointer str);
+
+/* Loads types compiled from schema file (and its includes) into schema.
+ * Returns FALSE if there's no cache, it's stale or any of cached types
+ * is already in schema. Nothing is added to schema in such case. */
+extern gboolean _midgard_core_schema_cache_load(MidgardSchema *schema, const gchar *path);
+
+/* Stores types parsed from path's schema files.
+ * files is a hash table with parsed schema files' paths as keys,
+ * typenames is a list of types' names parsed from these files. */
+extern void _midgard_core_schema_cache_save(MidgardSchema *schema, const gchar *path,
+		GHashTable *files, GSList *typenames);
+
+#endif /* MIDGARD_CORE_SCHEMA_CACHE_H */
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#include <config.h>
+#include <errno.h>
+#include "midgard_core_styledir.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#endif
+
+/* STYLE DIRECTORIES
+ *
+ * Every style directory is read once and its elements are kept in memory.
+ * Directories are watched with inotify, and a watcher thread marks
+ * directory stale whenever any of its files is changed, so lookups
+ * of unchanged directories do not touch filesystem at all.
+ * Stale directory is read again on next lookup.
+ *
+ * Directories are read every time if inotify is not available,
+ * or directory can not be watched. */
+
+#define STYLEDIR_EVENTS (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE \
+		| IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct {
+	gchar *path;
+	/* name, content */
+	GHashTable *elements;
+	gint wd;
+	gboolean stale;
+} MgdStyleDir;
+
+/* Reads elements of directory, NULL if it can not be opened */
+static GHashTable *__dir_read(const gchar *path)
+{
+	gchar *content, **ffname, *fpfname;
+	const gchar *fname;
+	GDir *dir = g_dir_open(path, 0, NULL);
+
+	if(dir == NULL)
+		return NULL;
+
+	GHashTable *elements = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	while((fname = g_dir_read_name(dir)) != NULL) {
+
+		fpfname = g_strconcat(path, "/", fname, NULL);
+		/* Get filename without extension. */
+		ffname = g_strsplit(fname, ".", -1);
+
+		if(g_file_get_contents(fpfname, &content, NULL, NULL)) {
+
+			if(g_hash_table_lookup(elements, ffname[0]) == NULL)
+				g_hash_table_insert(elements, g_strdup(ffname[0]), content);
+			else
+				g_free(content);
+		}
+
+		g_free(fpfname);
+		g_strfreev(ffname);
+	}
+
+	g_dir_close(dir);
+
+	return elements;
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+G_LOCK_DEFINE_STATIC(styledir);
+
+/* -1 if not initialized, -2 if directories can not be watched */
+static gint styledir_fd = -1;
+/* path, MgdStyleDir */
+static GHashTable *styledir_paths = NULL;
+/* watch descriptor, MgdStyleDir */
+static GHashTable *styledir_watches = NULL;
+
+static void __dir_free(MgdStyleDir *sdir)
+{
+	g_free(sdir->path);
+	if(sdir->elements)
+		g_hash_table_destroy(sdir->elements);
+	g_free(sdir);
+}
+
+static void __dir_mark_all_stale(gpointer key, gpointer value, gpointer userdata)
+{
+	((MgdStyleDir *) value)->stale = TRUE;
+}
+
+static void __dir_mark_stale(gint wd, guint32 mask)
+{
+	/* Events have been lost, any directory might be changed */
+	if(mask & IN_Q_OVERFLOW) {
+		g_hash_table_foreach(styledir_paths, __dir_mark_all_stale, NULL);
+		return;
+	}
+
+	MgdStyleDir *sdir = g_hash_table_lookup(styledir_watches, GINT_TO_POINTER(wd));
+
+	if(sdir == NULL)
+		return;
+
+	sdir->stale = TRUE;
+
+	/* Watch is removed by kernel, directory is watched again when read */
+	if(mask & IN_IGNORED) {
+		g_hash_table_remove(styledir_watches, GINT_TO_POINTER(wd));
+		sdir->wd = -1;
+	}
+}
+
+static gpointer __watcher(gpointer data)
+{
+	gint fd = GPOINTER_TO_INT(data);
+	gchar buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	while(TRUE) {
+
+		ssize_t len = read(fd, buf, sizeof(buf));
+
+		if(len < 0 && errno == EINTR)
+			continue;
+
+		/* Descriptor closed in forked child or read failed.
+		 * Nothing is marked stale anymore, so stop caching. */
+		if(len <= 0)
+			break;
+
+		G_LOCK(styledir);
+
+		/* Descriptor has been replaced after fork */
+		if(fd != styledir_fd) {
+			G_UNLOCK(styledir);
+			break;
+		}
+
+		gchar *ptr = buf;
+		while(ptr < buf + len) {
+
+			struct inotify_event *event = (struct inotify_event *) ptr;
+			__dir_mark_stale(event->wd, event->mask);
+			ptr += sizeof(struct inotify_event) + event->len;
+		}
+
+		G_UNLOCK(styledir);
+	}
+
+	G_LOCK(styledir);
+	if(fd == styledir_fd) {
+		g_warning("Style directories watcher stopped, reading directories for every request");
+		close(fd);
+		styledir_fd = -2;
+	}
+	G_UNLOCK(styledir);
+
+	return NULL;
+}
+
+/* Watcher thread does not exist in forked child, so child starts
+ * with empty cache and its own inotify descriptor */
+static void __atfork_prepare(void)
+{
+	G_LOCK(styledir);
+}
+
+static void __atfork_parent(void)
+{
+	G_UNLOCK(styledir);
+}
+
+static void __atfork_child(void)
+{
+	if(styledir_fd >= 0)
+		close(styledir_fd);
+
+	styledir_fd = -1;
+	g_hash_table_remove_all(styledir_watches);
+	g_hash_table_remove_all(styledir_paths);
+
+	G_UNLOCK(styledir);
+}
+
+/* Must be called with styledir lock */
+static gboolean __watcher_init(void)
+{
+	if(styledir_fd >= 0)
+		return TRUE;
+
+	if(styledir_fd == -2)
+		return FALSE;
+
+	if(styledir_paths == NULL) {
+
+		styledir_paths = g_hash_table_new_full(g_str_hash, g_str_equal,
+				NULL, (GDestroyNotify) __dir_free);
+		styledir_watches = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+		pthread_atfork(__atfork_prepare, __atfork_parent, __atfork_child);
+	}
+
+#if !GLIB_CHECK_VERSION(2,32,0)
+	if(!g_thread_supported())
+		g_thread_init(NULL);
+#endif
+
+	gint fd = inotify_init();
+
+	if(fd < 0) {
+
+		g_debug("Can not initialize inotify: %s", g_strerror(errno));
+		styledir_fd = -2;
+		return FALSE;
+	}
+
+	GError *error = NULL;
+	styledir_fd = fd;
+
+#if GLIB_CHECK_VERSION(2,32,0)
+	GThread *thread = g_thread_try_new("styledir", __watcher, GINT_TO_POINTER(fd), &error);
+	if(thread != NULL)
+		g_thread_unref(thread);
+#else
+	GThread *thread = g_thread_create(__watcher, GINT_TO_POINTER(fd), FALSE, &error);
+#endif
+
+	if(thread == NULL) {
+
+		g_debug("Can not start style directories watcher: %s", error->message);
+		g_clear_error(&error);
+		close(fd);
+		styledir_fd = -2;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Must be called with styledir lock. Returns NULL if directory can not be cached. */
+static MgdStyleDir *__dir_get(const gchar *path)
+{
+	if(!__watcher_init())
+		return NULL;
+
+	MgdStyleDir *sdir = g_hash_table_lookup(styledir_paths, path);
+
+	if(sdir != NULL && !sdir->stale)
+		return sdir;
+
+	if(sdir == NULL) {
+
+		sdir = g_new0(MgdStyleDir, 1);
+		sdir->path = g_strdup(path);
+		sdir->wd = -1;
+		g_hash_table_insert(styledir_paths, sdir->path, sdir);
+	}
+
+	/* Watch before reading, so changes made while reading are not lost */
+	if(sdir->wd < 0) {
+
+		sdir->wd = inotify_add_watch(styledir_fd, path, STYLEDIR_EVENTS);
+
+		if(sdir->wd < 0) {
+
+			g_debug("Can not watch style directory %s: %s", path, g_strerror(errno));
+			g_hash_table_remove(styledir_paths, path);
+			return NULL;
+		}
+
+		/* The same directory under another path, which is not marked stale */
+		if(g_hash_table_lookup(styledir_watches, GINT_TO_POINTER(sdir->wd)) != NULL) {
+			g_hash_table_remove(styledir_paths, path);
+			return NULL;
+		}
+
+		g_hash_table_insert(styledir_watches, GINT_TO_POINTER(sdir->wd), sdir);
+	}
+
+	sdir->stale = FALSE;
+
+	if(sdir->elements)
+		g_hash_table_destroy(sdir->elements);
+	sdir->elements = __dir_read(path);
+
+	if(sdir->elements == NULL) {
+
+		inotify_rm_watch(styledir_fd, sdir->wd);
+		g_hash_table_remove(styledir_watches, GINT_TO_POINTER(sdir->wd));
+		g_hash_table_remove(styledir_paths, path);
+		return NULL;
+	}
+
+	return sdir;
+}
+
+gboolean _midgard_core_styledir_foreach(const gchar *path, GHFunc func, gpointer userdata)
+{
+	g_return_val_if_fail(path != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	G_LOCK(styledir);
+
+	MgdStyleDir *sdir = __dir_get(path);
+
+	if(sdir != NULL) {
+
+		g_hash_table_foreach(sdir->elements, func, userdata);
+		G_UNLOCK(styledir);
+
+		return TRUE;
+	}
+
+	G_UNLOCK(styledir);
+
+	GHashTable *elements = __dir_read(path);
+
+	if(elements == NULL)
+		return FALSE;
+
+	g_hash_table_foreach(elements, func, userdata);
+	g_hash_table_destroy(elements);
+
+	return TRUE;
+}
+
+#else /* HAVE_SYS_INOTIFY_H */
+
+gboolean _midgard_core_styledir_foreach(const gchar *path, GHFunc func, gpointer userdata)
+{
+	g_return_val_if_fail(path != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	GHashTable *elements = __dir_read(path);
+
+	if(elements == NULL)
+		return FALSE;
+
+	g_hash_table_foreach(elements, func, userdata);
+	g_hash_table_destroy(elements);
+
+	return TRUE;
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
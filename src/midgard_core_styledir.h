@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *   */
+
+#ifndef MIDGARD_CORE_STYLEDIR_H
+#define MIDGARD_CORE_STYLEDIR_H
+
+#include <glib.h>
+
+/* Calls func for every element of style directory, with element's name
+ * (file name without extension) as key and file's content as value.
+ * Directory is read once and kept in memory while inotify reports no changes.
+ * func is called with cache lock held, it must not call this function.
+ * Returns FALSE if directory can not be opened. */
+extern gboolean _midgard_core_styledir_foreach(const gchar *path, GHFunc func, gpointer userdata);
+
+#endif /* MIDGARD_CORE_STYLEDIR_H */
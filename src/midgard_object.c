@@ -21,6 +21,8 @@
 #include "midgard/midgard_error.h"
 #include "schema.h"
 #include "midgard_core_object.h"
+#include "midgard_core_pagecache.h"
+#include "midgard_core_acl.h"
 
 static MgdSchemaPropertyAttr *__get_property_attr(
 		MidgardObjectClass *klass, const gchar *name)
@@ -316,6 +318,9 @@ gboolean midgard_object_class_undelete(MidgardConnection *mgd, const gchar *guid
 				MIDGARD_ERRNO_SET(mgd->mgd, MGD_ERR_INTERNAL);
 				return FALSE;
 			}
+
+			_midgard_core_pagecache_class_changed((const gchar *) mgd_colvalue(res, 0));
+			_midgard_core_acl_class_changed((const gchar *) mgd_colvalue(res, 0));
 			
 			sql = g_string_new("UPDATE repligard SET ");
 			g_string_append_printf(sql,
@@ -26,6 +26,7 @@
 #include "schema.h"
 #include "midgard_core_object.h"
 #include "midgard/midgard_metadata.h"
+#include "midgard_core_quota.h"
 
 #define get_varchar_size(str) \
 	if(str == NULL) \
@@ -38,11 +39,270 @@
 	size = 8 + size; \
 	g_free(str);
 
+/* QUOTA LEDGER
+ *
+ * Quota table records of sitegroup are loaded once, when sitegroup's quota
+ * is checked for the first time. Writes update ledger entries only,
+ * and accumulated deltas are flushed to quota table in batches.
+ * Deltas are applied relatively, so concurrent processes do not overwrite
+ * each other's changes. Ledger is reconciled with quota table periodically,
+ * to see changes made by other processes. */
+
+typedef struct {
+	gint64 limit_size;
+	gint64 size;
+	gint64 limit_records;
+	gint64 records;
+	/* Deltas not flushed yet */
+	gint64 pending_size;
+	gint64 pending_records;
+	/* FALSE if there's no quota record, no limits then */
+	gboolean exists;
+} MgdQuotaEntry;
+
+struct _MgdQuotaLedger {
+	GHashTable *entries;
+	GHashTable *sitegroups;
+	guint pending;
+	GTimer *flushed;
+	GTimer *reconciled;
+};
+
+static gchar *__entry_key(guint sg, const gchar *typename)
+{
+	return g_strdup_printf("%u:%s", sg, typename);
+}
+
+static MgdQuotaLedger *__ledger_get(MidgardConnection *mgd)
+{
+	MgdQuotaLedger *ledger = mgd->priv->quota_ledger;
+
+	if(ledger != NULL)
+		return ledger;
+
+	ledger = g_new(MgdQuotaLedger, 1);
+	ledger->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	ledger->sitegroups = g_hash_table_new(g_direct_hash, g_direct_equal);
+	ledger->pending = 0;
+	ledger->flushed = g_timer_new();
+	ledger->reconciled = g_timer_new();
+
+	mgd->priv->quota_ledger = ledger;
+
+	return ledger;
+}
+
+static void __ledger_load_sitegroup(MidgardConnection *mgd, MgdQuotaLedger *ledger, guint sg)
+{
+	if(g_hash_table_lookup(ledger->sitegroups, GUINT_TO_POINTER(sg + 1)))
+		return;
+
+	g_hash_table_insert(ledger->sitegroups, GUINT_TO_POINTER(sg + 1), GUINT_TO_POINTER(TRUE));
+
+	midgard_res *res = mgd_query(mgd->mgd,
+			"SELECT typename, limit_sg_size, sg_size, limit_sg_records, sg_records, "
+			"limit_type_size, type_size, limit_type_records, type_records "
+			"FROM quota WHERE sitegroup=$d", sg);
+
+	if(!res)
+		return;
+
+	while(mgd_fetch(res)) {
+
+		const gchar *typename = mgd_colvalue(res, 0);
+		if(typename == NULL)
+			typename = "";
+
+		/* Global sitegroup's record keeps sg_ columns, type's record type_ ones */
+		gint col = *typename == '\0' ? 1 : 5;
+
+		gchar *key = __entry_key(sg, typename);
+		MgdQuotaEntry *entry = g_hash_table_lookup(ledger->entries, key);
+
+		if(entry == NULL) {
+
+			entry = g_new0(MgdQuotaEntry, 1);
+			g_hash_table_insert(ledger->entries, key, entry);
+
+		} else {
+
+			g_free(key);
+		}
+
+		entry->exists = TRUE;
+		entry->limit_size = mgd_sql2int(res, col);
+		entry->size = mgd_sql2int(res, col + 1);
+		entry->limit_records = mgd_sql2int(res, col + 2);
+		entry->records = mgd_sql2int(res, col + 3);
+	}
+
+	mgd_release(res);
+}
+
+static MgdQuotaEntry *__ledger_entry(MidgardConnection *mgd, guint sg, const gchar *typename)
+{
+	MgdQuotaLedger *ledger = __ledger_get(mgd);
+
+	if(g_timer_elapsed(ledger->reconciled, NULL) >= MIDGARD_QUOTA_RECONCILE_INTERVAL)
+		midgard_quota_reconcile(mgd->mgd);
+
+	__ledger_load_sitegroup(mgd, ledger, sg);
+
+	gchar *key = __entry_key(sg, typename);
+	MgdQuotaEntry *entry = g_hash_table_lookup(ledger->entries, key);
+
+	/* No quota record, remember there are no limits */
+	if(entry == NULL) {
+
+		entry = g_new0(MgdQuotaEntry, 1);
+		g_hash_table_insert(ledger->entries, key, entry);
+
+	} else {
+
+		g_free(key);
+	}
+
+	return entry;
+}
+
+static gboolean __entry_size_is_reached(MgdQuotaEntry *entry, gint64 size)
+{
+	if(!entry->exists || entry->limit_size <= 0)
+		return FALSE;
+
+	return (entry->size + entry->pending_size + size) > entry->limit_size;
+}
+
+static gboolean __entry_records_is_reached(MgdQuotaEntry *entry, gint64 records)
+{
+	if(!entry->exists || entry->limit_records <= 0)
+		return FALSE;
+
+	return (entry->records + entry->pending_records + records) > entry->limit_records;
+}
+
+static void __ledger_add(MidgardConnection *mgd, guint sg, const gchar *typename,
+		gint64 size, gint64 records)
+{
+	MgdQuotaLedger *ledger = __ledger_get(mgd);
+	MgdQuotaEntry *entry;
+
+	entry = __ledger_entry(mgd, sg, typename);
+	entry->pending_size += size;
+	entry->pending_records += records;
+
+	entry = __ledger_entry(mgd, sg, "");
+	entry->pending_size += size;
+	entry->pending_records += records;
+
+	ledger->pending++;
+
+	if(ledger->pending >= MIDGARD_QUOTA_FLUSH_WRITES
+			|| g_timer_elapsed(ledger->flushed, NULL) >= MIDGARD_QUOTA_FLUSH_INTERVAL)
+		midgard_quota_flush(mgd->mgd);
+}
+
+static void __flush_entry(gpointer key, gpointer value, gpointer ud)
+{
+	MgdQuotaEntry *entry = (MgdQuotaEntry *) value;
+	MidgardConnection *mgd = (MidgardConnection *) ud;
+
+	if(entry->pending_size == 0 && entry->pending_records == 0)
+		return;
+
+	/* There's no quota record to update */
+	if(!entry->exists) {
+
+		entry->pending_size = 0;
+		entry->pending_records = 0;
+		return;
+	}
+
+	gchar **tokens = g_strsplit((const gchar *) key, ":", 2);
+	const gchar *typename = tokens[1];
+	const gchar *prefix = *typename == '\0' ? "sg" : "type";
+
+	GString *query = g_string_new("UPDATE quota SET ");
+	g_string_append_printf(query,
+			"%s_size=IF(%s_size+(%" G_GINT64_FORMAT ")<0, 0, %s_size+(%" G_GINT64_FORMAT ")), "
+			"%s_records=IF(%s_records+(%" G_GINT64_FORMAT ")<0, 0, %s_records+(%" G_GINT64_FORMAT ")) "
+			"WHERE typename='%s' AND sitegroup=%s",
+			prefix, prefix, entry->pending_size, prefix, entry->pending_size,
+			prefix, prefix, entry->pending_records, prefix, entry->pending_records,
+			typename, tokens[0]);
+	midgard_query_execute(mgd->mgd, g_string_free(query, FALSE), NULL);
+	g_strfreev(tokens);
+
+	entry->size += entry->pending_size;
+	entry->records += entry->pending_records;
+	if(entry->size < 0)
+		entry->size = 0;
+	if(entry->records < 0)
+		entry->records = 0;
+
+	entry->pending_size = 0;
+	entry->pending_records = 0;
+}
+
+void midgard_quota_flush(midgard *mgd)
+{
+	g_assert(mgd != NULL);
+
+	MidgardConnection *cnc = mgd->_mgd;
+
+	if(cnc == NULL || cnc->priv->quota_ledger == NULL)
+		return;
+
+	MgdQuotaLedger *ledger = cnc->priv->quota_ledger;
+
+	if(ledger->pending > 0 && mgd->msql && mgd->msql->mysql)
+		g_hash_table_foreach(ledger->entries, __flush_entry, cnc);
+
+	ledger->pending = 0;
+	g_timer_start(ledger->flushed);
+}
+
+void midgard_quota_reconcile(midgard *mgd)
+{
+	g_assert(mgd != NULL);
+
+	MidgardConnection *cnc = mgd->_mgd;
+
+	if(cnc == NULL || cnc->priv->quota_ledger == NULL)
+		return;
+
+	midgard_quota_flush(mgd);
+
+	/* Sitegroups' records are loaded again when needed */
+	MgdQuotaLedger *ledger = cnc->priv->quota_ledger;
+	g_hash_table_remove_all(ledger->entries);
+	g_hash_table_remove_all(ledger->sitegroups);
+	g_timer_start(ledger->reconciled);
+}
+
+void _midgard_core_quota_ledger_free(MidgardConnection *mgd)
+{
+	g_assert(mgd != NULL);
+
+	MgdQuotaLedger *ledger = mgd->priv->quota_ledger;
+
+	if(ledger == NULL)
+		return;
+
+	if(mgd->mgd)
+		midgard_quota_flush(mgd->mgd);
+
+	g_hash_table_destroy(ledger->entries);
+	g_hash_table_destroy(ledger->sitegroups);
+	g_timer_destroy(ledger->flushed);
+	g_timer_destroy(ledger->reconciled);
+	g_free(ledger);
+
+	mgd->priv->quota_ledger = NULL;
+}
+
 gboolean midgard_quota_size_is_reached(MgdObject *object, gint size)
 {
-	GString *query;
-	gint limit_tmp_size, tmp_size;
-	GList *list;
 	midgard *mgd = object->mgd;
 	MidgardConnection *new_mgd = mgd->_mgd;
 	if (!MGD_CNC_QUOTA (new_mgd))
@@ -62,53 +322,14 @@ gboolean midgard_quota_size_is_reached(MgdObject *object, gint size)
 	/* Check global quota */
 	guint sgid;
 	g_object_get(G_OBJECT(object), "sitegroup", &sgid, NULL);
-	query = g_string_new("SELECT limit_sg_size, sg_size FROM quota ");
-	g_string_append_printf(query,
-			"WHERE typename='' and sitegroup=%d",
-			sgid);
 
-	list = midgard_query_get_single_row(g_string_free(query, FALSE), object);
-	
-	/* This means that quota is enabled but quota limits are not set
-	 * return FALSE then*/
-	if(!list)
-		return FALSE;
-	
-	limit_tmp_size = atoi(list->data);
-	g_free(list->data);
-	list = list->next;
-	tmp_size = atoi(list->data);
-	g_free(list->data);
-	g_list_free(list);
-
-	if(((tmp_size + size) > limit_tmp_size) && limit_tmp_size > 0){
+	if(__entry_size_is_reached(__ledger_entry(new_mgd, sgid, ""), size)) {
 		MIDGARD_ERRNO_SET(object->mgd, MGD_ERR_QUOTA);
 		return TRUE;
 	}
 	
 	/* Check quota for type size */
-	query = g_string_new("SELECT limit_type_size, type_size FROM quota ");
-	g_string_append_printf(query,
-			"WHERE typename='%s' and sitegroup=%d",
-			G_OBJECT_TYPE_NAME(object), 
-			midgard_sitegroup_get_id(object->mgd));
-
-	list = midgard_query_get_single_row(g_string_free(query, FALSE), object);
-
-	/* This means that quota is enabled and quota limits are not set
-	 * return FALSE then*/
-	if(!list)
-		return FALSE;
-	
-	limit_tmp_size = atoi(list->data);
-	g_free(list->data);
-	list = list->next;
-	tmp_size = atoi(list->data);
-	g_free(list->data);
-	
-	g_list_free(list);
-	
-	if(((tmp_size + size) > limit_tmp_size) && limit_tmp_size > 0){
+	if(__entry_size_is_reached(__ledger_entry(new_mgd, sgid, G_OBJECT_TYPE_NAME(object)), size)) {
 		MIDGARD_ERRNO_SET(object->mgd, MGD_ERR_QUOTA);
 		return TRUE;
 	}
@@ -128,6 +349,10 @@ guint midgard_quota_get_object_size(MgdObject *object){
 	if (!MGD_CNC_QUOTA (mgd))
 		return 0;
 
+	/* Size stored in object's record is known if object has been fetched or written */
+	if(object->metadata && object->metadata->private->stored_size_is_set)
+		return object->metadata->private->stored_size;
+
 	MidgardObjectClass *klass = MIDGARD_OBJECT_GET_CLASS(object);
 	GString *select = g_string_new("SELECT metadata_size");
 	g_string_append_printf(select, 
@@ -223,6 +448,8 @@ gboolean midgard_quota_update(MgdObject *object)
 		return TRUE;
 
 	object->metadata->private->size = opsize;
+	object->metadata->private->stored_size = opsize;
+	object->metadata->private->stored_size_is_set = TRUE;
 	MidgardObjectClass *klass = MIDGARD_OBJECT_GET_CLASS(object);	
 	
 	GString *query = g_string_new("UPDATE ");
@@ -254,28 +481,10 @@ gboolean midgard_quota_update(MgdObject *object)
 	g_value_unset(&pval);	
 	midgard_query_execute(object->mgd, g_string_free(query, FALSE), NULL);
 
-	/* Update type size */
-	GString *quota_query;
+	/* Update type and global sitegroup size */
 	guint sgid;
 	g_object_get(G_OBJECT(object), "sitegroup", &sgid, NULL);
-	quota_query = g_string_new("UPDATE quota ");
-	g_string_append_printf(quota_query, 
-			"SET type_size=type_size+%d "
-			"WHERE typename='%s' AND sitegroup=%d",
-			diff_size,
-			typename,
-			sgid);
-	midgard_query_execute(object->mgd, g_string_free(quota_query, FALSE), NULL);
-
-	/* Update global sitegroup size */
-	quota_query = g_string_new("UPDATE quota ");
-	g_string_append_printf(quota_query,
-			"SET sg_size=sg_size+%d "
-			"WHERE typename='' AND sitegroup=%d",
-			diff_size,
-			sgid);
-	midgard_query_execute(object->mgd, g_string_free(quota_query, FALSE), NULL);
-
+	__ledger_add(mgd, sgid, typename, diff_size, 0);
 
 	return TRUE;
 }
@@ -288,63 +497,19 @@ gboolean midgard_quota_create(MgdObject *object)
 	if (!MGD_CNC_QUOTA (mgd))
 		return TRUE;
 
-	GString *query;
-	gint tmp_type_limit, tmp_limit;
-	GList *list;
 	guint object_sitegroup;
+	const gchar *typename = G_OBJECT_TYPE_NAME(object);
 
 	g_object_get(G_OBJECT(object), "sitegroup", &object_sitegroup, NULL);
 	
 	/* Check quota for global records limit*/
-	query = g_string_new("SELECT limit_sg_records, sg_records FROM quota ");
-	g_string_append_printf(query,
-			"WHERE typename='' and sitegroup=%d",
-			object_sitegroup);
-
-	list = midgard_query_get_single_row(g_string_free(query, FALSE), object);
-	
-	/* This means that quota is enable but quota limits are not set 
-	 * return TRUE then */
-	if(!list)
-		return TRUE;
-	
-	
-	tmp_type_limit = atoi(list->data);
-	g_free(list->data);
-	list = list->next;
-	tmp_limit = atoi(list->data);
-	g_free(list->data);
-	
-	g_list_free(list);
-	
-	if(((tmp_limit + 1) > tmp_type_limit) && tmp_type_limit > 0){
+	if(__entry_records_is_reached(__ledger_entry(mgd, object_sitegroup, ""), 1)) {
 		MIDGARD_ERRNO_SET(object->mgd, MGD_ERR_QUOTA);
 		return FALSE;
 	}
 
 	/* Check quota for type's records limit*/
-	query = g_string_new("SELECT limit_type_records, type_records FROM quota ");
-	g_string_append_printf(query,
-			"WHERE typename='%s' and sitegroup=%d",
-			G_OBJECT_TYPE_NAME(object), 
-			object_sitegroup);
-
-	list = midgard_query_get_single_row(g_string_free(query, FALSE) , object);
-	
-	/* This means that quota is enabled but quota limits are not set 
-	 * return TRUE then */
-	if(!list)
-		return TRUE;
-	
-	tmp_type_limit = atoi(list->data);
-	g_free(list->data);
-	list = list->next;
-	tmp_limit = atoi(list->data);
-	g_free(list->data);
-	
-	g_list_free(list);
-	
-	if(((tmp_limit + 1) > tmp_type_limit) && tmp_type_limit > 0){
+	if(__entry_records_is_reached(__ledger_entry(mgd, object_sitegroup, typename), 1)) {
 		MIDGARD_ERRNO_SET(object->mgd, MGD_ERR_QUOTA);
 		return FALSE;
 	}
@@ -356,24 +521,8 @@ gboolean midgard_quota_create(MgdObject *object)
 		return FALSE;
 	}
 
-	/* Update type's records */
-	query = g_string_new("UPDATE quota ");
-	g_string_append_printf(query,
-			"SET type_records=type_records+1"
-			" WHERE typename='%s' AND sitegroup=%d",
-			G_OBJECT_TYPE_NAME(object), 
-			object_sitegroup);
-
-	midgard_query_execute(object->mgd, g_string_free(query, FALSE), NULL);
-
-	/* Update global sitegroup records */
-	query = g_string_new("UPDATE quota ");
-	g_string_append_printf(query,
-			"SET sg_records=sg_records+1"
-			" WHERE typename='' AND sitegroup=%d",
-			object_sitegroup);
-
-	midgard_query_execute(object->mgd, g_string_free(query, FALSE), NULL);
+	/* Update type's and global sitegroup records */
+	__ledger_add(mgd, object_sitegroup, typename, 0, 1);
 
 	return TRUE;
 }
@@ -583,45 +732,9 @@ void midgard_quota_remove(MgdObject *object, guint size){
 	if (!MGD_CNC_QUOTA (mgd))
 		return;
 
-	GString *query;
-	const gchar *typename = G_OBJECT_TYPE_NAME(object);
-	
-	/* Update type's records */
-	query = g_string_new("UPDATE quota ");
-	g_string_append_printf(query,
-			"SET type_records=type_records-1"
-			" WHERE typename='%s' AND sitegroup=%d AND type_records>0",
-			typename,
-			midgard_sitegroup_get_id(object->mgd));
-	midgard_query_execute(object->mgd, g_string_free(query, FALSE), NULL);
-
-	/* Update global sitegroup records */
-	query = g_string_new("UPDATE quota ");
-	g_string_append_printf(query,
-			"SET sg_records=sg_records-1"
-			" WHERE typename='' AND sitegroup=%d AND sg_records>0",
-			midgard_sitegroup_get_id(object->mgd));
-	
-	midgard_query_execute(object->mgd, g_string_free(query, FALSE), NULL);
-
-	query = g_string_new("UPDATE quota ");
-	g_string_append_printf(query,
-			"SET type_size=type_size-%d "
-			"WHERE typename='%s' AND sitegroup=%d AND type_size>0",
-			size,
-			typename,
-			midgard_sitegroup_get_id(object->mgd));
-	midgard_query_execute(object->mgd, g_string_free(query, FALSE), NULL);
-
-	/* Update global sitegroup size */
-	query = g_string_new("UPDATE quota ");
-	g_string_append_printf(query,
-			"SET sg_size=sg_size-%d "
-			"WHERE typename='' AND sitegroup=%d AND sg_size>0",
-			size,
-			midgard_sitegroup_get_id(object->mgd));
-	midgard_query_execute(object->mgd, g_string_free(query, FALSE), NULL);
-
+	/* Update type's and global sitegroup records and size */
+	__ledger_add(mgd, midgard_sitegroup_get_id(object->mgd),
+			G_OBJECT_TYPE_NAME(object), -((gint64) size), -1);
 }
 
 typedef struct{
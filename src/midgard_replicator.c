@@ -24,6 +24,7 @@
 #include "midgard/midgard_blob.h"
 #include "midgard/midgard_timestamp.h"
 #include "midgard/midgard_error.h"
+#include "midgard_core_base64.h"
 
 struct _MidgardReplicatorPrivate 
 { 
@@ -368,7 +369,7 @@ gchar *midgard_replicator_serialize_blob(MidgardReplicator *self,
 	content = midgard_blob_read_content(blob, &bytes_read);
 
 	gchar *encoded =
-		g_base64_encode((const guchar *)content, bytes_read);
+		_midgard_core_base64_encode((const guchar *)content, bytes_read);
 	g_free(content);
 
 	xmlDoc *doc = _midgard_core_object_create_xml_doc();
@@ -393,6 +394,141 @@ gchar *midgard_replicator_serialize_blob(MidgardReplicator *self,
 	return (gchar*) buf;
 }
 
+/* Bytes of blob read at once, multiple of 3 so chunks encode without carry */
+#define MIDGARD_REPLICATOR_BLOB_CHUNK (48 * 1024)
+
+static gboolean __write_chars(MidgardConnection *mgd, GIOChannel *channel,
+		const gchar *buf, gssize len)
+{
+	GError *err = NULL;
+
+	if(g_io_channel_write_chars(channel, buf, len, NULL, &err) == G_IO_STATUS_NORMAL)
+		return TRUE;
+
+	midgard_set_error(mgd,
+			MGD_GENERIC_ERROR,
+			MGD_ERR_INTERNAL,
+			" %s ",
+			err ? err->message : "");
+	g_clear_error(&err);
+
+	return FALSE;
+}
+
+/* Serialize midgard_blob binary data to channel, chunk by chunk */
+gboolean midgard_replicator_serialize_blob_to_channel(MidgardReplicator *self,
+		MgdObject *object, GIOChannel *channel)
+{
+	g_assert(object != NULL);
+	g_return_val_if_fail(channel != NULL, FALSE);
+
+	MidgardConnection *_mgd;
+
+	if(self == NULL)
+		_mgd = object->mgd->_mgd;
+	else
+		_mgd = self->private->mgd;
+
+	MidgardBlob *blob =
+		midgard_blob_new(object, NULL);
+
+	if(!blob)
+		return FALSE;
+
+	GIOChannel *in = midgard_blob_get_handler(blob, "r");
+
+	if(!in) {
+		g_object_unref(blob);
+		return FALSE;
+	}
+
+	g_io_channel_set_encoding(in, NULL, NULL);
+
+	/* The same document serialize_blob creates */
+	xmlChar *guid = xmlEncodeSpecialChars(NULL, BAD_CAST object->private->guid);
+	gchar *head = g_strdup_printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<midgard_object xmlns=\"%s\">\n"
+			"  <midgard_blob guid=\"%s\">",
+			MIDGARD_OBJECT_HREF, (gchar *) guid);
+	xmlFree(guid);
+
+	gboolean rv = __write_chars(_mgd, channel, head, -1);
+	g_free(head);
+
+	gchar *buf = g_malloc(MIDGARD_REPLICATOR_BLOB_CHUNK);
+	gchar *encoded = g_malloc(MIDGARD_REPLICATOR_BLOB_CHUNK / 3 * 4 + 4);
+	gint state = 0, save = 0;
+	GError *err = NULL;
+	GIOStatus status = G_IO_STATUS_NORMAL;
+
+	while(rv && status == G_IO_STATUS_NORMAL) {
+
+		gsize bytes_read = 0;
+		status = g_io_channel_read_chars(in, buf,
+				MIDGARD_REPLICATOR_BLOB_CHUNK, &bytes_read, &err);
+
+		if(status == G_IO_STATUS_ERROR) {
+
+			midgard_set_error(_mgd,
+					MGD_GENERIC_ERROR,
+					MGD_ERR_INTERNAL,
+					" %s ",
+					err ? err->message : "");
+			g_clear_error(&err);
+			rv = FALSE;
+			break;
+		}
+
+		gsize len = _midgard_core_base64_encode_step((const guchar *) buf,
+				bytes_read, encoded, &state, &save);
+
+		if(status == G_IO_STATUS_EOF)
+			len += _midgard_core_base64_encode_close(encoded + len, &state, &save);
+
+		if(len > 0)
+			rv = __write_chars(_mgd, channel, encoded, len);
+	}
+
+	if(rv)
+		rv = __write_chars(_mgd, channel, "</midgard_blob>\n</midgard_object>\n", -1);
+
+	if(rv && g_io_channel_flush(channel, &err) != G_IO_STATUS_NORMAL) {
+
+		midgard_set_error(_mgd,
+				MGD_GENERIC_ERROR,
+				MGD_ERR_INTERNAL,
+				" %s ",
+				err ? err->message : "");
+		g_clear_error(&err);
+		rv = FALSE;
+	}
+
+	g_free(buf);
+	g_free(encoded);
+	g_object_unref(blob);
+
+	return rv;
+}
+
+/* Serialize midgard_blob binary data to file descriptor */
+gboolean midgard_replicator_serialize_blob_to_fd(MidgardReplicator *self,
+		MgdObject *object, gint fd)
+{
+	g_assert(object != NULL);
+	g_return_val_if_fail(fd >= 0, FALSE);
+
+	GIOChannel *channel = g_io_channel_unix_new(fd);
+	g_io_channel_set_encoding(channel, NULL, NULL);
+
+	gboolean rv = midgard_replicator_serialize_blob_to_channel(self, object, channel);
+
+	/* Descriptor belongs to caller */
+	g_io_channel_set_close_on_unref(channel, FALSE);
+	g_io_channel_unref(channel);
+
+	return rv;
+}
+
 gchar *midgard_replicator_export_blob(MidgardReplicator *self,
 		MgdObject *object)
 {
@@ -778,7 +914,7 @@ static gboolean __import_blob_from_xml(	MidgardConnection *mgd,
 	gsize content_length =
 		(gsize) strlen(content);
 	guchar *decoded =
-		g_base64_decode(content, &content_length);
+		_midgard_core_base64_decode(content, content_length, &content_length);
 	g_free(content);
 
 	FILE *fp = fopen(blobpath, "w+");
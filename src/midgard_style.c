@@ -21,6 +21,9 @@
 #include "midgard/midgard_datatypes.h"
 #include "midgard/midgard_style.h"
 #include "midgard/query_builder.h"
+#include "midgard/midgard_legacy.h"
+#include "midgard_core_pagecache.h"
+#include "midgard_core_styledir.h"
 
 typedef struct{
 	gchar *name;
@@ -39,40 +42,87 @@ MgdStyle *midgard_style_new(midgard *mgd)
 	return style;
 }
 
+/* Returns level (1 for parent) of page among ancestors */
+static guint _get_page_level(GObject *element, GHashTable *levels)
+{
+	guint page;
+
+	g_object_get(element, "page", &page, NULL);
+
+	return GPOINTER_TO_UINT(g_hash_table_lookup(levels, GUINT_TO_POINTER(page)));
+}
+
+typedef struct {
+	GObject **childs;
+	GHashTable *table;
+} _nearest_elements;
+
+static void _add_nearest_element(gpointer key, gpointer val, gpointer userdata)
+{
+	_nearest_elements *ne = (_nearest_elements *) userdata;
+	gchar *value;
+
+	if(g_hash_table_lookup(ne->table, key) != NULL)
+		return;
+
+	g_object_get(ne->childs[GPOINTER_TO_UINT(val) - 1], "value", &value, NULL);
+	g_hash_table_insert(ne->table, g_strdup((gchar *) key), value);
+}
+
+/* Collects inherited elements of all object's ancestors.
+ * Page tree is walked in connection's page cache, and elements of all 
+ * ancestors are fetched with one query. Element of the nearest page wins,
+ * and elements already in table are not replaced. */
 static void _get_parent_page_elements(MgdObject *object, GHashTable *table)
 {
-	MgdObject *parent = midgard_object_get_parent(object);
+	guint up, i;
+	gchar *name;
+	const MgdPageCachePage *page;
+	midgard *mgd = object->mgd;
 
-	if(parent == NULL)
+	g_object_get(G_OBJECT(object), "up", &up, NULL);
+
+	if(up == 0)
 		return;
-	
-	guint n_objects, i;
-	GParamSpec *prop;
-	gchar *name, *value;
-	MidgardObjectClass *klass = MIDGARD_OBJECT_GET_CLASS(parent);
-	gchar *primary = midgard_object_class_get_primary_property(klass);
-	
+
+	/* page id, level */
+	GHashTable *levels = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GValueArray *ancestors = g_value_array_new(8);
+	gboolean cached = _midgard_core_pagecache_pages(mgd);
+
+	GValue pval = {0,};
+	g_value_init(&pval, G_TYPE_UINT);
+
+	/* Walk to root page, stop if tree is broken */
+	while(up != 0 && g_hash_table_lookup(levels, GUINT_TO_POINTER(up)) == NULL) {
+
+		g_value_set_uint(&pval, up);
+		g_value_array_append(ancestors, &pval);
+		g_hash_table_insert(levels, GUINT_TO_POINTER(up), 
+				GUINT_TO_POINTER(ancestors->n_values));
+
+		page = cached ? _midgard_core_pagecache_get_page(mgd, up) : NULL;
+		up = page ? page->up : mgd_idfield(mgd, "up", "page", up);
+	}
+
+	g_value_unset(&pval);
+
 	MidgardQueryBuilder *builder = 
-		midgard_query_builder_new(parent->mgd, "midgard_pageelement");
+		midgard_query_builder_new(mgd, "midgard_pageelement");
 
 	if(!builder) {
-		MIDGARD_ERRNO_SET(parent->mgd, MGD_ERR_INTERNAL);
+		MIDGARD_ERRNO_SET(mgd, MGD_ERR_INTERNAL);
 		g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
 				"Invalid query builder configuration (%s)",
-				G_OBJECT_TYPE_NAME(G_OBJECT(parent)));
+				G_OBJECT_TYPE_NAME(G_OBJECT(object)));
+		g_value_array_free(ancestors);
+		g_hash_table_destroy(levels);
 		return;
 	}
 
-	/* Find object's primary property */
-	prop = g_object_class_find_property(
-			G_OBJECT_GET_CLASS(G_OBJECT(parent)), primary);
-	
-	GValue pval = {0,};
-	/* Initialize primary property value */
-	g_value_init(&pval,prop->value_type);
-	g_object_get_property(G_OBJECT(object), primary, &pval);
-	/* I think we can hardcode parent property */
-	midgard_query_builder_add_constraint(builder, "page", "=", &pval);
+	g_value_init(&pval, G_TYPE_VALUE_ARRAY);
+	g_value_take_boxed(&pval, ancestors);
+	midgard_query_builder_add_constraint(builder, "page", "IN", &pval);
 	g_value_unset(&pval);
 	/* Get only those elements which has inheritance set */
 	g_value_init(&pval,G_TYPE_STRING);
@@ -80,25 +130,40 @@ static void _get_parent_page_elements(MgdObject *object, GHashTable *table)
 	midgard_query_builder_add_constraint(builder, "info", "=", &pval);
 	g_value_unset(&pval);
 	
-	GObject **childs = 
-		midgard_query_builder_execute(builder, n_objects);
+	MidgardTypeHolder *holder = g_new(MidgardTypeHolder, 1);
+	holder->elements = 0;
+	GObject **childs = midgard_query_builder_execute(builder, holder);
+	guint n_objects = childs ? holder->elements : 0;
+	g_free(holder);
+	midgard_query_builder_free(builder);
+
+	/* name, index of the element defined by the nearest page + 1 */
+	GHashTable *nearest = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	gpointer best;
 
 	for(i = 0; i < n_objects; i++){
 		
-		g_object_get(G_OBJECT(childs[i]), 
-					"name", &name, 
-					"value", &value,
-					NULL);
-		g_hash_table_insert(table,
-				g_strdup(name), g_strdup(value));
-		g_object_unref(childs[i]);		
+		g_object_get(G_OBJECT(childs[i]), "name", &name, NULL);
+		best = g_hash_table_lookup(nearest, name);
+
+		if(best == NULL 
+				|| _get_page_level(childs[i], levels) 
+				< _get_page_level(childs[GPOINTER_TO_UINT(best) - 1], levels)) {
+			g_hash_table_replace(nearest, name, GUINT_TO_POINTER(i + 1));
+		} else {
+			g_free(name);
+		}
 	}
-	midgard_query_builder_free(builder);
 
-	/* Walk to root page */
-	_get_parent_page_elements(parent, table);
-	
-	g_object_unref(parent);	
+	_nearest_elements ne = { childs, table };
+	g_hash_table_foreach(nearest, _add_nearest_element, &ne);
+
+	for(i = 0; i < n_objects; i++)
+		g_object_unref(childs[i]);
+
+	g_free(childs);
+	g_hash_table_destroy(nearest);
+	g_hash_table_destroy(levels);
 }
 
 /* Load page and its elements */
@@ -132,51 +197,30 @@ gboolean midgard_style_load_page(MgdStyle *style, MgdObject *object)
 		}
 	}
 
-	/* Walk to root page and collect all page elements, 
-	 * replacing existing elements  with parent's page ones if inherited */
+	/* Collect inherited elements of all parent pages */
 	_get_parent_page_elements(object, style->page_elements);
 }
 
 
-GHashTable *_style_get_elements_from_dir(midgard *mgd, const gchar *path)        
+static void _add_dir_element(gpointer key, gpointer val, gpointer userdata)
+{
+	g_hash_table_insert((GHashTable *) userdata,
+			g_strdup((gchar *) key), g_strdup((gchar *) val));
+}
+
+GHashTable *_style_get_elements_from_dir(midgard *mgd, const gchar *path)
 {
-        gchar  *content, **ffname, *fpfname = NULL;
-        const gchar *fname = NULL;
-        GDir *dir;
-        GHashTable *elements;
-        
 	/* We need full path for multiple midcoms installed and running 
 	 * with the same midgard core version */
-        /* apath = g_strconcat(MIDGARD_SHARE_DIR, "/", path, NULL); */
-        
-        dir = g_dir_open(path, 0, NULL);
-        if (dir != NULL) {
-                
-                /* Initialize "elements" ( files ) hash table */
-                elements = midgard_hash_strings_new();
-                
-                /* Read files form directory */
-                while ((fname = g_dir_read_name(dir)) != NULL) {
-                        
-                        fpfname = g_strconcat( path, "/", fname, NULL);
-                        /* Get filename without extension. */ 
-                        ffname = g_strsplit(fname, ".", -1);
-                   
-                        /* Get file content and set as value in hash table ,
-                         * * filename without extension is a key */
-                        if (g_file_get_contents(fpfname,  &content, NULL, NULL) == TRUE) {
-                                
-                                g_hash_table_insert(elements, g_strdup(ffname[0]), g_strdup(content));
-                                g_free(content);
-                        }
-                        g_free(fpfname);
-                        g_strfreev(ffname);
-                        
-                }
-		g_dir_close(dir);
-                return elements;
-        }
-        return NULL;
+	GHashTable *elements = midgard_hash_strings_new();
+
+	/* Directory is read once and kept in memory while it's not changed */
+	if(!_midgard_core_styledir_foreach(path, _add_dir_element, elements)) {
+		g_hash_table_destroy(elements);
+		return NULL;
+	}
+
+	return elements;
 }
 
 
@@ -233,8 +277,8 @@ static void _get_parent_style_elements(MgdObject *object, GHashTable *table)
 	}
 	midgard_query_builder_free(builder);
 
-	/* Walk to root page */
-	_get_parent_page_elements(parent, table);
+	/* Walk to root style */
+	_get_parent_style_elements(parent, table);
 	
 	g_object_unref(parent);	
 }
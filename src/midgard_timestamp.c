@@ -32,18 +32,93 @@ struct caltime {
 
 #define leapsecs_add(a,b) (a)
 
-static const gchar *caltime_fmt(struct caltime *ct) {
-        GString *string = g_string_sized_new(100);
-        g_string_printf(
-                string, "%ld-%02d-%02d %02d:%02d:%02d",
-                ct->year, ct->month, ct->day, ct->hour, ct->minute, ct->second);
-        if (ct->nano > 0) {
-                unsigned long n = ct->nano;
-                while ((n % 10) == 0) { n = n / 10; }
-                g_string_append_printf(string, ".%lo", n);
-        }
-        g_string_append_printf(string, "%+05ld", ct->offset);
-        return g_string_free(string, FALSE);
+/* Writes two digits, n must be within 0..99 */
+static inline char *caltime_fmt_2(char *t, int n) {
+  t[0] = '0' + n / 10;
+  t[1] = '0' + n % 10;
+  return t + 2;
+}
+
+/* Writes string to buf, which must be MIDGARD_TIMESTAMP_BUFFER_SIZE long.
+ * Returns length of string. */
+static gsize caltime_fmt(const struct caltime *ct, gchar *buf) {
+  long offset = ct->offset < 0 ? -ct->offset : ct->offset;
+
+  /* Fixed layout of four digit years, without fraction */
+  if (ct->year >= 1000 && ct->year <= 9999 && ct->nano == 0 && offset <= 9999) {
+    char *t = buf;
+    t = caltime_fmt_2(t, ct->year / 100);
+    t = caltime_fmt_2(t, ct->year % 100);
+    *t++ = '-';
+    t = caltime_fmt_2(t, ct->month);
+    *t++ = '-';
+    t = caltime_fmt_2(t, ct->day);
+    *t++ = ' ';
+    t = caltime_fmt_2(t, ct->hour);
+    *t++ = ':';
+    t = caltime_fmt_2(t, ct->minute);
+    *t++ = ':';
+    t = caltime_fmt_2(t, ct->second);
+    *t++ = ct->offset < 0 ? '-' : '+';
+    t = caltime_fmt_2(t, offset / 100);
+    t = caltime_fmt_2(t, offset % 100);
+    *t = '\0';
+    return t - buf;
+  }
+
+  gsize len = g_snprintf(
+          buf, MIDGARD_TIMESTAMP_BUFFER_SIZE, "%ld-%02d-%02d %02d:%02d:%02d",
+          ct->year, ct->month, ct->day, ct->hour, ct->minute, ct->second);
+  if (ct->nano > 0) {
+          unsigned long n = ct->nano;
+          while ((n % 10) == 0) { n = n / 10; }
+          len += g_snprintf(buf + len, MIDGARD_TIMESTAMP_BUFFER_SIZE - len, ".%lo", n);
+  }
+  len += g_snprintf(buf + len, MIDGARD_TIMESTAMP_BUFFER_SIZE - len, "%+05ld", ct->offset);
+  return len;
+}
+
+#define caltime_digit(c) ((unsigned char) ((c) - '0') <= 9)
+#define caltime_2(t) (((t)[0] - '0') * 10 + ((t)[1] - '0'))
+
+/* Parses fixed layouts "YYYY-MM-DD HH:MM:SS", returned by MySQL for
+ * datetime columns, and "YYYY-MM-DD HH:MM:SS+HHMM", written by caltime_fmt,
+ * with fixed offsets. Time without offset is UTC. Returns 0 for any other
+ * layout, left to caltime_scan, which parses these the same way. */
+static unsigned int caltime_scan_fixed(const char *s, struct caltime *ct) {
+  /* Digit check fails at terminating NUL, so nothing is read past it */
+  if (!(caltime_digit(s[0]) && caltime_digit(s[1])
+        && caltime_digit(s[2]) && caltime_digit(s[3]) && s[4] == '-'
+        && caltime_digit(s[5]) && caltime_digit(s[6]) && s[7] == '-'
+        && caltime_digit(s[8]) && caltime_digit(s[9])
+        && (s[10] == ' ' || s[10] == 'T')
+        && caltime_digit(s[11]) && caltime_digit(s[12]) && s[13] == ':'
+        && caltime_digit(s[14]) && caltime_digit(s[15]) && s[16] == ':'
+        && caltime_digit(s[17]) && caltime_digit(s[18])))
+    return 0;
+
+  if (s[19] != '\0' && !((s[19] == '+' || s[19] == '-')
+        && caltime_digit(s[20]) && caltime_digit(s[21])
+        && caltime_digit(s[22]) && caltime_digit(s[23])))
+    return 0;
+
+  ct->year = caltime_2(s) * 100 + caltime_2(s + 2);
+  ct->month = caltime_2(s + 5);
+  ct->day = caltime_2(s + 8);
+  ct->hour = caltime_2(s + 11);
+  ct->minute = caltime_2(s + 14);
+  ct->second = caltime_2(s + 17);
+  ct->nano = 0;
+
+  if (s[19] == '\0') {
+    ct->offset = 0;
+    return 19;
+  }
+
+  ct->offset = caltime_2(s + 20) * 60 + caltime_2(s + 22);
+  if (s[19] == '-') ct->offset = -ct->offset;
+
+  return 24;
 }
 
 static unsigned int caltime_scan(const char *s, struct caltime *ct) {
@@ -90,6 +165,8 @@ static unsigned int caltime_scan(const char *s, struct caltime *ct) {
   }
 
   while ((*t == ' ') || (*t == '\t')) ++t;
+  /* MySQL datetimes have no offset, they are UTC */
+  if (*t == '\0') { ct->offset = 0; return t - s; }
   if (*t == '+') sign = 1; else if (*t == '-') sign = -1; else return 0;
   ++t;
   c = (unsigned char) (*t++ - '0'); if (c > 9) return 0; z = c;
@@ -296,9 +373,18 @@ GType midgard_timestamp_get_type(void) {
 
 gchar *midgard_timestamp_dup_string(const GValue *value) {
         g_assert(G_VALUE_HOLDS(value, MIDGARD_TYPE_TIMESTAMP));
+        gchar buf[MIDGARD_TIMESTAMP_BUFFER_SIZE];
+        gsize len = midgard_timestamp_format(value, buf);
+        return g_strndup(buf, len);
+}
+
+gsize midgard_timestamp_format(const GValue *value, gchar *buf) {
+        g_assert(G_VALUE_HOLDS(value, MIDGARD_TYPE_TIMESTAMP));
+        g_assert(buf != NULL);
+
         struct caltime ct;
         midgard_timestamp_get_caltime(value, &ct);
-        return (gchar *)caltime_fmt(&ct); 
+        return caltime_fmt(&ct, buf);
 }
 
 void midgard_timestamp_set_string(GValue *value, const gchar *time) {
@@ -306,7 +392,8 @@ void midgard_timestamp_set_string(GValue *value, const gchar *time) {
         g_assert(time != NULL);
 
         struct caltime ct;
-        if (caltime_scan(time, &ct) > 0) {
+        if (caltime_scan_fixed(time, &ct) > 0
+                        || caltime_scan(time, &ct) > 0) {
                 midgard_timestamp_set_caltime(value, &ct);
         } else {
                 value->data[0].v_uint64 = 4611686018427387914ULL;
@@ -8,6 +8,8 @@
 #endif
 
 #include "midgard_mysql.h"
+#include "midgard_core_pagecache.h"
+#include "midgard_core_styledir.h"
 
 int mgd_find_host(midgard *mgd,
    const char *hostname, int port, const char *uri, int null_prefix,
@@ -24,6 +26,24 @@ midgard_res *res;
    parsed->prefix_length = 0;
    parsed->found = 0;
 
+   if (_midgard_core_pagecache_hosts(mgd)) {
+      const MgdPageCacheHost *host =
+         _midgard_core_pagecache_find_host(mgd, hostname, port, uri, null_prefix);
+
+      if (host == NULL)
+         return 0;
+
+      parsed->host = host->host;
+      parsed->style = host->style;
+      parsed->page = host->page;
+      parsed->lang = host->lang;
+      parsed->auth_required = host->auth_required;
+      parsed->prefix_length = host->prefix_length;
+      parsed->sitegroup = host->sitegroup;
+      parsed->found = 1;
+      return 1;
+   }
+
   /* valgrind reports leak here , however res is released */
    res = mgd_ungrouped_select(mgd,
       "id,style,root,lang,info&1,Length(prefix)"
@@ -211,6 +231,8 @@ int uri_len;
 char *dir;
 long tmp;
 char *blob = NULL;
+gboolean cached;
+const MgdPageCachePage *cpage;
 
    result->style = host->style;
    result->active = 0;
@@ -237,11 +259,20 @@ char *blob = NULL;
       uri_len = strlen(tmp_uri);
    }
 
-   if (!result->auth_required)
-      result->auth_required = mgd_idfield(mgd, "info&1", "page", host->page);
-   result->active = mgd_idfield(mgd, "info&2", "page", host->page);
-   tmp = mgd_idfield(mgd, "style", "page", host->page);
-   if (tmp != 0) result->style = tmp;
+   cached = _midgard_core_pagecache_pages(mgd);
+   cpage = cached ? _midgard_core_pagecache_get_page(mgd, host->page) : NULL;
+
+   if (cpage != NULL) {
+      if (!result->auth_required) result->auth_required = cpage->auth_required;
+      result->active = cpage->active;
+      if (cpage->style != 0) result->style = cpage->style;
+   } else {
+      if (!result->auth_required)
+         result->auth_required = mgd_idfield(mgd, "info&1", "page", host->page);
+      result->active = mgd_idfield(mgd, "info&2", "page", host->page);
+      tmp = mgd_idfield(mgd, "style", "page", host->page);
+      if (tmp != 0) result->style = tmp;
+   }
 
    /*[eeh]  We always have a root page */
    result->found = MGD_FOUND_PAGE;
@@ -250,6 +281,24 @@ char *blob = NULL;
          dir = strtok(NULL, "/")) {
       if (dir[0] == '\0') { continue; }
 
+      if (cached) {
+         cpage = _midgard_core_pagecache_find_page(mgd, result->page, dir);
+
+         if (cpage == NULL) {
+            result->found = MGD_FOUND_NONE;
+            break;
+         }
+
+         result->page = cpage->id;
+         if (cpage->style != 0) result->style = cpage->style;
+         if (!result->auth_required) result->auth_required = cpage->auth_required;
+         result->active = cpage->active;
+         result->author = cpage->author;
+         result->owner = cpage->author;
+         g_array_append_val(path, result->page);
+         continue;
+      }
+
      res = mgd_ungrouped_select(mgd, "id,style,info&1,info&2,author,owner", "page",
          "up=$d AND name=$q  AND page.metadata_deleted=0 ", NULL, result->page, dir);
 
@@ -314,6 +363,176 @@ gboolean element_cache_free(gpointer key, gpointer value, gpointer userdata)
   return TRUE;
 }
 
+static long __page_up(midgard *mgd, long page)
+{
+    const MgdPageCachePage *cpage = _midgard_core_pagecache_get_page(mgd, page);
+
+    /* Deleted pages are not cached */
+    if (cpage == NULL)
+        return mgd_idfield(mgd, "up", "page", page);
+
+    return cpage->up;
+}
+
+static void __elements_replay(const MgdPageCacheElements *elements,
+        mgd_store_style_elt_cb style_elt_cb, void *userdata)
+{
+    guint i;
+
+    style_elt_cb("title", elements->title, userdata);
+    style_elt_cb("content", elements->content, userdata);
+
+    for (i = 0; i < elements->elements->len; i += 2) {
+        style_elt_cb(g_ptr_array_index(elements->elements, i),
+                g_ptr_array_index(elements->elements, i + 1), userdata);
+    }
+}
+
+/* Fetches page's title, content and all page and style elements it inherits,
+ * in order of precedence: page elements from the page up to the root page,
+ * then style elements from the style up to the root style.
+ * Current language is preferred over default one on every level. */
+static MgdPageCacheElements *__elements_fetch(midgard *mgd, long host, long page, long style,
+        int record)
+{
+    midgard_res *res, *eres;
+    MgdPageCacheElements *elements;
+    GHashTable *element_cache;
+    GString *pages, *styles, *sql;
+    gchar *langs;
+    const char *name;
+    long id;
+    int lang = mgd->lang;
+
+    res = mgd_ungrouped_select(mgd,
+            "title,content",
+            "page_i",
+            "sid=$d AND lang IN ($d,$d)",
+            "IF(lang=$d,0,1) LIMIT 1",
+            page, lang, mgd_get_default_lang(mgd), lang);
+
+    if (!res || !mgd_fetch(res)) {
+        if (res) mgd_release(res);
+        return NULL;
+    }
+
+    pages = g_string_new("");
+    for (id = page; id != 0; id = __page_up(mgd, id))
+        g_string_append_printf(pages, "%s%ld", pages->len ? "," : "", id);
+
+    styles = g_string_new("");
+    for (id = style; id != 0; id = _midgard_core_pagecache_get_style_up(mgd, id))
+        g_string_append_printf(styles, "%s%ld", styles->len ? "," : "", id);
+
+    if (lang > 0)
+        langs = g_strdup_printf("%d,%d", lang, mgd_get_default_lang(mgd));
+    else
+        langs = g_strdup_printf("%d", lang);
+
+    sql = g_string_new("");
+    g_string_append_printf(sql,
+            "(SELECT pageelement.name AS name, pageelement_i.value AS value,"
+            " pageelement.id AS id, 0 AS style, %d AS type,"
+            " FIELD(pageelement.page,%s) AS level,"
+            " IF(pageelement_i.lang=%d,0,1) AS langrank"
+            " FROM pageelement, pageelement_i"
+            " WHERE pageelement.id=pageelement_i.sid AND pageelement_i.lang IN (%s)"
+            " AND pageelement.page IN (%s)"
+            " AND (pageelement.page=%ld OR pageelement.info&1<>0)"
+            " AND pageelement.sitegroup IN (0, %d) AND pageelement.metadata_deleted=0)",
+            MGD_CACHE_ELT_PAGE, pages->str, lang, langs, pages->str, page,
+            mgd_sitegroup(mgd));
+
+    if (styles->len > 0) {
+        g_string_append_printf(sql,
+                " UNION ALL "
+                "(SELECT element.name, element_i.value,"
+                " element.id, element.style, %d,"
+                " FIELD(element.style,%s),"
+                " IF(element_i.lang=%d,0,1)"
+                " FROM element, element_i"
+                " WHERE element.id=element_i.sid AND element_i.lang IN (%s)"
+                " AND element.style IN (%s)"
+                " AND element.sitegroup IN (0, %d) AND element.metadata_deleted=0)",
+                MGD_CACHE_ELT_STYLE, styles->str, lang, langs, styles->str,
+                mgd_sitegroup(mgd));
+    }
+
+    g_string_append(sql, " ORDER BY type, level, langrank");
+
+    eres = mgd_query(mgd, sql->str);
+
+    g_string_free(sql, TRUE);
+    g_string_free(pages, TRUE);
+    g_string_free(styles, TRUE);
+    g_free(langs);
+
+    /* Empty result is fine, failed query is not */
+    if (!eres && mysql_errno(mgd->msql->mysql) != 0) {
+        mgd_release(res);
+        return NULL;
+    }
+
+    elements = _midgard_core_pagecache_add_elements(mgd, page, style,
+            mgd_colvalue(res, 0), mgd_colvalue(res, 1));
+    mgd_release(res);
+
+    element_cache = midgard_hash_strings_new();
+    g_hash_table_insert(element_cache, g_strdup("title"), g_strdup(""));
+    g_hash_table_insert(element_cache, g_strdup("content"), g_strdup(""));
+
+    while (eres && mgd_fetch(eres)) {
+        name = mgd_colvalue(eres, 0);
+
+        /* skip storing the element if it's allready defined */
+        if (g_hash_table_lookup(element_cache, name) != NULL) { continue; }
+
+        g_hash_table_insert(element_cache, g_strdup(name), g_strdup(""));
+        _midgard_core_pagecache_element_add(mgd, elements, name, mgd_colvalue(eres, 1));
+
+        if (record) {
+            mgd_cache_add(mgd, host, page, atol(mgd_colvalue(eres, 3)),
+                    atoi(mgd_colvalue(eres, 4)), atol(mgd_colvalue(eres, 2)));
+        }
+    }
+
+    if (eres) mgd_release(eres);
+    g_hash_table_destroy(element_cache);
+
+    return elements;
+}
+
+/* Returns 0 if elements can not be served from page cache */
+static int __load_styles_cached(midgard *mgd, GArray *path,
+        long host, long page, long style,
+        mgd_store_style_elt_cb style_elt_cb, void *userdata, long cached_page)
+{
+    const MgdPageCacheElements *elements;
+    long parent;
+
+    if (!_midgard_core_pagecache_pages(mgd) || !_midgard_core_pagecache_styles(mgd))
+        return 0;
+
+    if (cached_page == 0) {
+        while ((parent = __page_up(mgd, g_array_index(path, long, 0)))) {
+            g_array_prepend_val(path, parent);
+        }
+    }
+
+    elements = _midgard_core_pagecache_get_elements(mgd, page, style);
+
+    /* Elements are recorded in cache table only if they are not cached yet */
+    if (elements == NULL)
+        elements = __elements_fetch(mgd, host, page, style, cached_page == 0);
+
+    if (elements == NULL)
+        return 0;
+
+    __elements_replay(elements, style_elt_cb, userdata);
+
+    return 1;
+}
+
 void mgd_load_styles(midgard *mgd, GArray* path, 
         long host, long style,
         mgd_store_style_elt_cb style_elt_cb, void *userdata, long cached_page)
@@ -328,12 +547,24 @@ void mgd_load_styles(midgard *mgd, GArray* path,
 
     if (style_elt_cb == NULL || (cached_page == 0 && (path == NULL || path->len == 0))) return;
 
+    /* Cached elements are not stored in cache table, so load them again */
+    if (cached_page != 0 && _midgard_core_pagecache_mode(mgd) != MGD_PAGECACHE_DATABASE) {
+        GArray *cached_path = g_array_new(FALSE, FALSE, sizeof(long));
+        g_array_append_val(cached_path, cached_page);
+        mgd_load_styles(mgd, cached_path, host, style, style_elt_cb, userdata, 0);
+        g_array_free(cached_path, TRUE);
+        return;
+    }
+
     if (cached_page != 0) { 
         page = cached_page; 
     } else { 
         page = g_array_index(path, long, path->len - 1); 
     }
 
+    if (__load_styles_cached(mgd, path, host, page, style, style_elt_cb, userdata, cached_page))
+        return;
+
     res = mgd_ungrouped_select(mgd, 
             "title,content", 
             "page_i", 
@@ -469,6 +700,12 @@ void mgd_cache_touch(midgard *mgd, long page)
 	GString *command;
 	long sitegroup = (long)mgd_sitegroup(mgd);
 	
+	_midgard_core_pagecache_invalidate();
+
+	/* Generation change is enough, cache table is not used */
+	if (_midgard_core_pagecache_mode(mgd) != MGD_PAGECACHE_DATABASE)
+		return;
+
 	if (sitegroup == 0) {
 		mysql_query(mgd->msql->mysql, "DELETE FROM cache");
 	} else {
@@ -487,6 +724,9 @@ int mgd_cache_is_current (midgard *mgd, long host, long page, long style)
 	int is_current;
 	/*[eeh] page, type, id, sitegroup */
 
+	if (_midgard_core_pagecache_mode(mgd) != MGD_PAGECACHE_DATABASE)
+		return _midgard_core_pagecache_is_current(mgd, host, page);
+
 	/* It's too early at this moment to parse the whole style tree.
 	 * Style id is ignored. In most cases cache is folled by inherited style being set. */
 	res = mgd_ungrouped_select (mgd, "page", "cache", 
@@ -509,6 +749,12 @@ int mgd_cache_is_current (midgard *mgd, long host, long page, long style)
 void mgd_cache_add(midgard *mgd, long host, long page, long style, int type, long id)
 {
 	g_assert(mgd != NULL);
+
+	/* Elements are not recorded, they are memoised by page cache */
+	if (_midgard_core_pagecache_mode(mgd) != MGD_PAGECACHE_DATABASE) {
+		_midgard_core_pagecache_add(mgd, host, page);
+		return;
+	}
 	
 	GString *command = g_string_new("");
 	g_string_append_printf(command,
@@ -622,44 +868,19 @@ void midgard_style_get_elements(midgard * mgd, glong style,
     return;
 }
 
-gboolean midgard_style_get_elements_from_dir(midgard *mgd, const gchar *name,
-        mgd_store_style_elt_cb style_elt_cb, GHashTable *table)
+static void __style_dir_element(gpointer key, gpointer value, gpointer userdata)
 {
-    gchar *content, **ffname, *fpfname = NULL;
-    const gchar *fname = NULL;
-    GDir *dir;
-    
-    dir = g_dir_open(name, 0, NULL);
-    if (dir != NULL) {
-
-        /* Read files form directory */
-        while ((fname = g_dir_read_name(dir)) != NULL) {
-   
-            fpfname = g_strconcat( name, "/", fname, NULL);
-            
-            /* Get filename without extension. */ 
-            ffname = g_strsplit(fname, ".", -1);
+    GHashTable *table = (GHashTable *) userdata;
 
-            /* Get file content and set as value in hash table ,
-             * filename without extension is a key */
-            if (g_file_get_contents(fpfname,  &content, NULL, NULL) == TRUE) {
-    
-                if(!g_hash_table_lookup(table, ffname[0])) {
-                    g_hash_table_insert(table, g_strdup(ffname[0]), g_strdup(content));
-
-                }
-
-                g_free(content);
-                g_strfreev(ffname);
-            }
+    if(!g_hash_table_lookup(table, key))
+        g_hash_table_insert(table, g_strdup((gchar *) key), g_strdup((gchar *) value));
+}
 
-        }
-        
-        g_dir_close(dir);
-        return TRUE;
-    }
-    
-    return FALSE;
+gboolean midgard_style_get_elements_from_dir(midgard *mgd, const gchar *name,
+        mgd_store_style_elt_cb style_elt_cb, GHashTable *table)
+{
+    /* Files are read once and kept in memory while directory is not changed */
+    return _midgard_core_styledir_foreach(name, __style_dir_element, table);
 }
 
 gboolean midgard_style_register(midgard *mgd, const gchar *name, midgard_style *mgdstyle)
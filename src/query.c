@@ -26,6 +26,7 @@
 #include "midgard/midgard_reflection_property.h"
 #include "midgard_mysql.h"
 #include "midgard_core_query.h"
+#include "midgard_core_profiler.h"
 #include "midgard/midgard_metadata.h"
 #include "midgard_core_object.h"
 #include "midgard/midgard_timestamp.h"
@@ -43,6 +44,10 @@
 #define COL_TYPE_DATE		"date"
 #define COL_TYPE_FLOAT		"float"
 
+/* Character set of guid columns with CompactGuids configuration */
+#define COL_GUID_CHARSET	"CHARACTER SET ascii COLLATE ascii_general_ci"
+#define COL_GUID_COLLATION	"ascii_general_ci"
+
 /* static prototypes */
 static gchar *__get_column_type(MidgardConnection *mgd,
 		const gchar *table, const gchar *column);
@@ -54,6 +59,8 @@ static gboolean __add_table_index(MidgardConnection *mgd,
 static gboolean __property_is_indexed(MidgardReflectionProperty *mrp,
 		MidgardObjectClass *klass, const gchar *name);
 static void __add_table_metadata(MidgardConnection *mgd, const gchar *table);
+static void __compact_guid_column(MidgardConnection *mgd,
+		const gchar *table, const gchar *column);
 
 static const gchar *__get_column_type_from_midgard_type(GType type)
 {
@@ -92,12 +99,27 @@ static const gchar *__get_column_type_from_midgard_type(GType type)
 	return col_type;
 }
 
+static gboolean __compact_guids(MidgardConnection *mgd)
+{
+	return mgd->priv->config->private->compactguids;
+}
+
+/* Column definition used for new guid columns */
+static const gchar *__guid_column_def(MidgardConnection *mgd)
+{
+	if(__compact_guids(mgd))
+		return COL_TYPE_GUID " " COL_GUID_CHARSET;
+
+	return COL_TYPE_GUID;
+}
+
 gint midgard_query_execute(midgard *mgd, gchar *sql, gpointer user_data)
 {
 	g_assert(mgd->msql->mysql != NULL);
 	
 	g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "query=%s", sql);
 	
+	GTimer *timer = _midgard_core_profiler_is_enabled() ? g_timer_new() : NULL;
 	gint sq = mysql_query(mgd->msql->mysql, sql);
 	
 	if (sq != 0) {
@@ -105,13 +127,22 @@ gint midgard_query_execute(midgard *mgd, gchar *sql, gpointer user_data)
 		g_warning("QUERY FAILED: \n %s \n QUERY: \n %s",
 				mysql_error(mgd->msql->mysql), sql);
 		g_free(sql);
+		if(timer)
+			g_timer_destroy(timer);
 		return -1;
 	}
-	g_free(sql);
 	gint rows = mysql_affected_rows(mgd->msql->mysql);         
 
 	MYSQL_RES *mres = 
 		mysql_store_result(mgd->msql->mysql);
+
+	if(timer) {
+		_midgard_core_profiler_record(mgd->msql->mysql, sql, 
+				MIDGARD_QUERY_ORIGIN_LEGACY, g_timer_elapsed(timer, NULL), mres);
+		g_timer_destroy(timer);
+	}
+	g_free(sql);
+
 	if(mres)
 		mysql_free_result(mres);
 
@@ -552,9 +583,10 @@ gboolean _midgard_core_query_update_class_storage(
 			} else if(prop_type == MGD_TYPE_GUID){ 
 				g_string_append_printf(
 						alter_cmd,
-						"%s varchar(80) NOT NULL "
+						"%s %s NOT NULL "
 						"default ''",
-						real_field[1]);
+						real_field[1],
+						__guid_column_def(mgd));
 				col_type = COL_TYPE_GUID;
 			} else {
 				g_string_append_printf(
@@ -594,6 +626,13 @@ gboolean _midgard_core_query_update_class_storage(
 			rv = 0;
 		}
 
+		/* SHOW COLUMNS doesn't report character set, so existing
+		 * guid columns are checked separately */
+		if(rv == 0 && db_col_type != NULL
+				&& prop_type == MGD_TYPE_GUID
+				&& g_str_equal(col_type, COL_TYPE_GUID))
+			__compact_guid_column(mgd, real_field[0], real_field[1]);
+
 		/* CREATE INDEX */
 		if(__property_is_indexed(mrp, klass, props[i]->name) 
 				|| prop_type == MGD_TYPE_GUID) 
@@ -615,6 +654,13 @@ gboolean _midgard_core_query_update_class_storage(
 
 	__add_table_metadata(mgd, table);
 
+	__compact_guid_column(mgd, table, "guid");
+	__compact_guid_column(mgd, table, "metadata_creator");
+	__compact_guid_column(mgd, table, "metadata_revisor");
+	__compact_guid_column(mgd, table, "metadata_approver");
+	__compact_guid_column(mgd, table, "metadata_locker");
+	__compact_guid_column(mgd, table, "metadata_owner");
+
 	return TRUE;
 }
 
@@ -758,32 +804,35 @@ static gboolean __add_table_index(MidgardConnection *mgd, const gchar *table, co
 		return TRUE;
 	}
 
-	gboolean added = FALSE;
-	gboolean idx_exists = FALSE;
-
 	gchar *index_name = __index_name(table, colname);
+	gboolean added = _midgard_core_query_add_table_index(mgd, table, index_name, colname);
+	g_free(index_name);
+
+	return added;
+}
 
-	idx_exists = __table_index_exists(mgd, table, index_name);
+gboolean _midgard_core_query_add_table_index(MidgardConnection *mgd, 
+		const gchar *table, const gchar *index_name, const gchar *columns)
+{
+	g_assert(mgd != NULL);
 
-	if(idx_exists) {
+	if(__table_index_exists(mgd, table, index_name)) {
 		g_debug("INDEX '%s' exists", index_name);
-		g_free(index_name);
 		return TRUE;
 	}
 
 	GString *cmd = g_string_new("CREATE INDEX ");
 	g_string_append_printf(cmd, "%s ON %s (%s)",
-			index_name, table, colname);
+			index_name, table, columns);
 
+	/* SQL is freed by midgard_query_execute */
 	gint rv = midgard_query_execute(
-			mgd->mgd, cmd->str, NULL);
-	g_string_free(cmd, FALSE);
-	g_free(index_name);
+			mgd->mgd, g_string_free(cmd, FALSE), NULL);
 	
 	if(rv == -1)
-		added = FALSE;
+		return FALSE;
 
-	return added;
+	return TRUE;
 }
 
 static void __add_metadata_indexes(MidgardConnection *mgd, const gchar *table)
@@ -808,6 +857,9 @@ gboolean __add_table_column(MidgardConnection *mgd, const gchar *table,
 	g_string_append_printf(cmd, "%s ADD ", table);        
 	
 	
+	if(type == MGD_TYPE_GUID && g_str_equal(column_type, COL_TYPE_GUID))
+		column_type = __guid_column_def(mgd);
+
 	if(type == 0) {
 			g_string_append_printf(cmd, 
 					"%s %s ",
@@ -863,6 +915,85 @@ static gboolean __table_column_exists(MidgardConnection *mgd, const gchar *table
 	return TRUE;
 }
 
+static gchar *__get_column_collation(MidgardConnection *mgd, 
+		const gchar *table, const gchar *column)
+{
+	GString *cmd = g_string_new("SHOW FULL COLUMNS FROM ");
+	g_string_append_printf(cmd,
+			"%s WHERE Field='%s'",
+			table, column);
+
+	midgard_res *res = mgd_vquery(mgd->mgd, cmd->str, NULL);
+
+	g_string_free(cmd, TRUE);
+
+	if (!res || !mgd_fetch(res)) {
+		
+		if(res) mgd_release(res);
+		return NULL;
+	}
+
+	gchar *collation = g_strdup((gchar *)mgd_colvalue(res, 2));
+	mgd_release(res);
+
+	return collation;
+}
+
+/* Converts existing guid column to single byte character set, 
+ * if CompactGuids is configured. Indexes are rebuilt by MySQL. 
+ * Column is not converted if any of its values is not ascii, 
+ * as such values would be lost. */
+static void __compact_guid_column(MidgardConnection *mgd, 
+		const gchar *table, const gchar *column)
+{
+	if(!__compact_guids(mgd))
+		return;
+
+	gchar *collation = __get_column_collation(mgd, table, column);
+
+	if(collation == NULL || g_str_equal(collation, COL_GUID_COLLATION)) {
+
+		g_free(collation);
+		return;
+	}
+
+	g_free(collation);
+
+	GString *cmd = g_string_new("SELECT COUNT(*) FROM ");
+	g_string_append_printf(cmd,
+			"%s WHERE LENGTH(%s) <> CHAR_LENGTH(%s)",
+			table, column, column);
+
+	midgard_res *res = mgd_vquery(mgd->mgd, cmd->str, NULL);
+	g_string_free(cmd, TRUE);
+
+	if (!res || !mgd_fetch(res)) {
+		
+		if(res) mgd_release(res);
+		return;
+	}
+
+	gint invalid = atoi(mgd_colvalue(res, 0));
+	mgd_release(res);
+
+	if(invalid > 0) {
+
+		g_warning("Column '%s.%s' not converted. %d records hold non ascii guids",
+				table, column, invalid);
+		return;
+	}
+
+	cmd = g_string_new("ALTER TABLE ");
+	g_string_append_printf(cmd,
+			"%s MODIFY %s %s NOT NULL default ''",
+			table, column, __guid_column_def(mgd));
+
+	if(midgard_query_execute(mgd->mgd, g_string_free(cmd, FALSE), NULL) == -1)
+		g_warning("Failed to convert '%s.%s' column", table, column);
+	else 
+		g_message("Column '%s.%s' converted to ascii", table, column);
+}
+
 static void __add_table_metadata(MidgardConnection *mgd, const gchar *table)
 {
 	/* Add metadata columns */
@@ -888,8 +1019,8 @@ static void __add_table_metadata(MidgardConnection *mgd, const gchar *table)
 			cmd = g_string_new("ALTER table ");
 			g_string_append_printf(cmd, 
 					"%s ADD (%s "
-					"varchar(80) NOT NULL default '')",
-					table, meta_field);
+					"%s NOT NULL default '')",
+					table, meta_field, __guid_column_def(mgd));
 			if(!__table_column_exists(mgd, table, meta_field))
 				midgard_query_execute(mgd->mgd, 
 						g_string_free(cmd, FALSE), NULL);
@@ -1008,7 +1139,8 @@ gboolean _midgard_core_query_create_class_storage(
 
 			switch (prop->value_type){				
 				case G_TYPE_STRING:
-					g_string_append_printf(cmd , "varchar(80) NOT NULL");
+					g_string_append_printf(cmd , "%s NOT NULL",
+							__guid_column_def(mgd));
 					break;
 				
 				case G_TYPE_UINT:
@@ -1120,7 +1252,7 @@ gboolean _midgard_core_query_create_class_storage(
 	/* Add guid column */
 	cmd_modify = g_string_new("ALTER TABLE ");
 	g_string_append_printf(cmd_modify,
-			"%s ADD guid varchar(80) NOT NULL",  table);
+			"%s ADD guid %s NOT NULL",  table, __guid_column_def(mgd));
 	rv = midgard_query_execute(mgd->mgd, g_string_free(cmd_modify, FALSE), NULL);        
 	
 	/* Add key for guid column */
@@ -1161,9 +1293,9 @@ gboolean _midgard_core_query_create_basic_db(MidgardConnection *mgd)
 	/* Internal tables hardcoded */
 	
 	/* TABLE repligard */
-	gchar *rep_table = g_strdup("CREATE TABLE IF NOT EXISTS repligard ( 		\
+	gchar *rep_table = g_strdup_printf("CREATE TABLE IF NOT EXISTS repligard ( 		\
 		id int(11) NOT NULL default '0',		\
-		guid varchar(80) NOT NULL default '',		\
+		guid %s NOT NULL default '',		\
 		sitegroup int(11) NOT NULL default '0',		\
 		typename varchar(80) NOT NULL default '',	\
 		lang int(11) NOT NULL default '0',		\
@@ -1174,22 +1306,22 @@ gboolean _midgard_core_query_create_basic_db(MidgardConnection *mgd)
 		updated timestamp NOT NULL,			\
 		action enum('create','update','delete') NOT NULL default 'create',	\
 		PRIMARY KEY (guid, sitegroup) \
-		);");
+		);", __guid_column_def(mgd));
 
 	/* TABLE sitegroup */
-	gchar *sg_table = g_strdup("CREATE TABLE IF NOT EXISTS sitegroup (		\
+	gchar *sg_table = g_strdup_printf("CREATE TABLE IF NOT EXISTS sitegroup (		\
 		id int(11) NOT NULL auto_increment,		\
 		name varchar(255) NOT NULL default '',		\
 		realm varchar(255) NOT NULL default '',		\
 		admingroup int(11) NOT NULL default '0',	\
 		sitegroup int(11) NOT NULL default '0',		\
-		guid varchar(80) NOT NULL default '',           \
+		guid %s NOT NULL default '',           \
 		metadata_created datetime NOT NULL default '0000-00-00 00:00:00', \
 		metadata_revised datetime NOT NULL default '0000-00-00 00:00:00', \
 		metadata_deleted BOOL NOT NULL default 0,	\
 		PRIMARY KEY (id),				\
 		KEY sitegroup_sitegroup_idx(sitegroup)		\
-		);");
+		);", __guid_column_def(mgd));
 
 	
 	/* TODO: Add person table */
@@ -1209,6 +1341,9 @@ gboolean _midgard_core_query_create_basic_db(MidgardConnection *mgd)
 		return FALSE;
 	}
 
+	__compact_guid_column(mgd, "repligard", "guid");
+	__compact_guid_column(mgd, "sitegroup", "guid");
+
 	return TRUE;
 }
 
@@ -32,6 +32,10 @@
 #include "midgard_core_query_builder.h"
 #include "midgard/midgard_error.h"
 #include "midgard_core_object.h"
+#include "midgard_core_object_class.h"
+#include "midgard_core_advisor.h"
+#include "midgard_core_profiler.h"
+#include "midgard_core_rowset.h"
 #include "midgard/midgard_datatypes.h"
 
 /* Internal prototypes , I am not sure if should be included in API */
@@ -336,21 +340,99 @@ void midgard_query_builder_toggle_read_only(MidgardQueryBuilder *builder, gboole
 	builder->priv->read_only = toggle;
 }
 
+gboolean midgard_query_builder_select_properties(MidgardQueryBuilder *builder, const gchar **properties)
+{
+	g_return_val_if_fail(builder != NULL, FALSE);
+
+	if(builder->priv->projection)
+		g_hash_table_unref(builder->priv->projection);
+	builder->priv->projection = NULL;
+
+	/* Select all properties again */
+	if(properties == NULL)
+		return TRUE;
+
+	GObjectClass *klass = g_type_class_peek(builder->priv->type);
+	GHashTable *projection = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	MgdSchemaPropertyAttr *attr;
+	guint i;
+
+	for(i = 0; properties[i] != NULL; i++) {
+
+		/* Always selected */
+		if(g_str_equal(properties[i], "guid") || g_str_equal(properties[i], "sitegroup"))
+			continue;
+
+		attr = _midgard_core_class_get_property_attr(klass, properties[i]);
+
+		if(attr == NULL || attr->tablefield == NULL) {
+
+			g_warning("Can not select property '%s'. It's not stored by '%s' class", 
+					properties[i], g_type_name(builder->priv->type));
+			MIDGARD_ERRNO_SET(builder->priv->mgd, MGD_ERR_INVALID_PROPERTY);
+			g_hash_table_destroy(projection);
+			return FALSE;
+		}
+
+		g_hash_table_insert(projection, g_strdup(properties[i]), GINT_TO_POINTER(1));
+	}
+
+	/* Object's primary property is always selected */
+	if(builder->priv->schema->primary
+			&& _midgard_core_class_get_property_attr(klass, builder->priv->schema->primary))
+		g_hash_table_insert(projection, g_strdup(builder->priv->schema->primary), GINT_TO_POINTER(1));
+
+	builder->priv->projection = projection;
+
+	return TRUE;
+}
+
+static void __append_projected_property(gpointer key, gpointer value, gpointer userdata)
+{
+	GString *select = (GString *) ((gpointer *)userdata)[0];
+	GObjectClass *klass = (GObjectClass *) ((gpointer *)userdata)[1];
+	const gchar *name = (const gchar *) key;
+
+	MgdSchemaPropertyAttr *attr = _midgard_core_class_get_property_attr(klass, name);
+
+	if(attr == NULL || attr->tablefield == NULL)
+		return;
+
+	if(attr->gtype == MGD_TYPE_TIMESTAMP) 
+		g_string_append_printf(select, ", IF(%s = '0000-00-00 00:00:00', NULL, %s) AS %s",
+				attr->tablefield, attr->tablefield, name);
+	else 
+		g_string_append_printf(select, ", %s AS %s", attr->tablefield, name);
+}
+
+static gchar *__get_projected_select(MidgardQueryBuilder *builder)
+{
+	GString *select = g_string_new("");
+	gpointer data[2];
+	data[0] = select;
+	data[1] = g_type_class_peek(builder->priv->type);
+
+	g_hash_table_foreach(builder->priv->projection, __append_projected_property, data);
+
+	/* Skip leading coma */
+	if(select->len > 0)
+		g_string_erase(select, 0, 1);
+
+	return g_string_free(select, FALSE);
+}
+
 gint _compare_ml_guid(gconstpointer a, gconstpointer b){
 
         if(g_ascii_strcasecmp(a,b) == 0) return 0;
         return 1;
 }
 
-static GList *midgard_query_builder_execute_or_count(
-        MidgardQueryBuilder *builder, MidgardTypeHolder *holder, guint select_type)
+gboolean _midgard_core_qb_is_executable(MidgardQueryBuilder *builder)
 {
-        g_assert(builder != NULL);
-
 	if(builder->priv->grouping_ref > 0) {
 		
 		g_warning("Incorrect constraint grouping. Missed 'end_group'?");
-		return NULL;
+		return FALSE;
 	}
 
 	if(builder->priv->type == MIDGARD_TYPE_SITEGROUP) {
@@ -359,9 +441,20 @@ static GList *midgard_query_builder_execute_or_count(
 			
 			MIDGARD_ERRNO_SET(builder->priv->mgd, MGD_ERR_ACCESS_DENIED);
 			g_warning("Type incompatible with Midgard Query Builder");
-			return NULL;
+			return FALSE;
 		}
 	}
+
+	return TRUE;
+}
+
+static GList *midgard_query_builder_execute_or_count(
+        MidgardQueryBuilder *builder, MidgardTypeHolder *holder, guint select_type)
+{
+        g_assert(builder != NULL);
+
+	if(!_midgard_core_qb_is_executable(builder))
+		return NULL;
         
         GList *list = _midgard_core_qb_set_object_from_query(builder, select_type, NULL);
         if(list == NULL){
@@ -415,6 +508,199 @@ GObject **midgard_query_builder_execute(
 	return (GObject **)objects;	
 }
 
+static GObject **__multi_list_to_objects(GList *list, MidgardTypeHolder *holder)
+{
+	guint i = 0;
+	guint elements = g_list_length(list);
+	GList *l;
+
+	if(holder)
+		holder->elements = elements;
+
+	if(elements == 0)
+		return NULL;
+
+	GObject **objects = g_new(GObject *, elements+1);
+
+	for(l = list; l; l = l->next) {
+		objects[i] = l->data;
+		i++;
+	}
+	objects[i] = NULL;
+
+	g_list_free(list);
+
+	return objects;
+}
+
+gboolean midgard_query_builder_execute_multi(
+		MidgardQueryBuilder **builders, guint n_builders, 
+		GObject ***objects, MidgardTypeHolder *holders)
+{
+	g_return_val_if_fail(builders != NULL, FALSE);
+	g_return_val_if_fail(objects != NULL, FALSE);
+
+	if(n_builders == 0)
+		return TRUE;
+
+	midgard *mgd = NULL;
+	MidgardQueryBuilder *builder;
+	GString *multi = g_string_new("");
+	gchar *sql;
+	guint i;
+
+	for(i = 0; i < n_builders; i++) {
+
+		objects[i] = NULL;
+		if(holders)
+			holders[i].elements = 0;
+	}
+
+	for(i = 0; i < n_builders; i++) {
+
+		if(MIDGARD_IS_COLLECTOR(builders[i])) {
+
+			builder = _midgard_core_collector_get_builder(MIDGARD_COLLECTOR(builders[i]));
+			sql = _midgard_core_collector_get_sql(MIDGARD_COLLECTOR(builders[i]));
+		
+		} else {
+
+			builder = builders[i];
+			sql = _midgard_core_qb_is_executable(builder) ? 
+				_midgard_core_qb_get_object_sql(builder, MQB_SELECT_OBJECT) : NULL;
+		}
+
+		if(mgd == NULL)
+			mgd = builder->priv->mgd;
+
+		/* All statements are sent with one call, so they must share connection */
+		if(builder->priv->mgd->msql->mysql != mgd->msql->mysql) {
+
+			g_warning("Query builders use different connections. Can not execute them at once.");
+			g_free(sql);
+			g_string_free(multi, TRUE);
+			return FALSE;
+		}
+
+		if(!sql) {
+			
+			g_warning("Attempted to execute NULL query (builder %d)", i);
+			g_string_free(multi, TRUE);
+			return FALSE;
+		}
+
+		if(i > 0)
+			g_string_append(multi, "; ");
+		g_string_append(multi, sql);
+		g_free(sql);
+	}
+
+	MIDGARD_ERRNO_SET(mgd, MGD_ERR_OK);
+	MYSQL *mysql = mgd->msql->mysql;
+
+	/* Multiple statements are enabled only for this call. 
+	 * We do not want them enabled for any other query executed with this connection */
+	if(mysql_set_server_option(mysql, MYSQL_OPTION_MULTI_STATEMENTS_ON) != 0) {
+
+		g_warning("Failed to enable multiple statements: %s", mysql_error(mysql));
+		g_string_free(multi, TRUE);
+		return FALSE;
+	}
+
+	g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "query=%s", multi->str);
+	gint sq = mysql_real_query(mysql, multi->str, multi->len);
+	gboolean rv = TRUE;
+
+	if(sq != 0) {
+
+		g_warning("\nQUERY FAILED: \n %s \n QUERY: \n %s",
+				mysql_error(mysql), multi->str);
+		rv = FALSE;
+	}
+
+	i = 0;
+	gint status = 0;
+	MYSQL_RES *results;
+
+	/* Every SELECT statement returns exactly one result set. 
+	 * Server stops executing statements when one of them fails */
+	while(rv) {
+
+		results = mysql_store_result(mysql);
+
+		if(results && i < n_builders) {
+
+			if(MIDGARD_IS_COLLECTOR(builders[i])) {
+				
+				_midgard_core_collector_set_from_result(MIDGARD_COLLECTOR(builders[i]), results);
+			
+			} else {
+
+				GList *list = _midgard_core_qb_set_object_from_result(
+						builders[i], MQB_SELECT_OBJECT, NULL, results);
+				objects[i] = __multi_list_to_objects(list, holders ? &holders[i] : NULL);
+			}
+
+		} else if(results) {
+
+			mysql_free_result(results);
+		
+		} else if(mysql_field_count(mysql) != 0) {
+
+			g_warning("Failed to store results (builder %d): %s", i, mysql_error(mysql));
+			rv = FALSE;
+			break;
+		}
+
+		i++;
+		
+		if((status = mysql_next_result(mysql)) != 0)
+			break;
+	}
+
+	if(status > 0) {
+
+		g_warning("\nQUERY FAILED (builder %d): \n %s", i, mysql_error(mysql));
+		rv = FALSE;
+	}
+
+	/* Drain results left after failure, connection is out of sync otherwise */
+	while(status == 0 && mysql_more_results(mysql)) {
+		
+		status = mysql_next_result(mysql);
+		if(status == 0 && (results = mysql_store_result(mysql)) != NULL)
+			mysql_free_result(results);
+	}
+
+	if(!rv) {
+		
+		midgard_set_error(mgd->_mgd,
+				MGD_GENERIC_ERROR,
+				MGD_ERR_INTERNAL,
+				" SQL query failed. ");
+		g_clear_error(&mgd->_mgd->err);
+
+		/* Nothing is returned on failure, objects of statements
+		 * executed before failed one included */
+		for(i = 0; i < n_builders; i++) {
+
+			guint j;
+			for(j = 0; objects[i] && objects[i][j]; j++)
+				g_object_unref(objects[i][j]);
+
+			g_free(objects[i]);
+			objects[i] = NULL;
+			if(holders)
+				holders[i].elements = 0;
+		}
+	}
+
+	mysql_set_server_option(mysql, MYSQL_OPTION_MULTI_STATEMENTS_OFF);
+	g_string_free(multi, TRUE);
+
+	return rv;
+}
+
 guint midgard_query_builder_count(MidgardQueryBuilder *builder)
 {
 	g_assert(builder != NULL);
@@ -504,82 +790,184 @@ gchar *midgard_query_builder_get_object_select(
 			"IF(%s.metadata_exported = '0000-00-00 00:00:00', NULL, %s.metadata_exported) AS metadata_exported, "
 			"IF(%s.metadata_imported = '0000-00-00 00:00:00', NULL, %s.metadata_imported) AS metadata_imported,"
 			"%s.metadata_deleted, %s.metadata_score, "
-			"%s.metadata_islocked, %s.metadata_isapproved, %s",
+			"%s.metadata_islocked, %s.metadata_isapproved",
 			table, table, table, table, table, table, table, table, table,
 			table, table, table, table, table, table, table, table, table,
 			table, table, table, table, table, table, table, table, table,
-			table, table, table, table, table, table, 
-                        klass->dbpriv->storage_data->query->select_full); /* TODO, Set select which suits better */
+			table, table, table, table, table, table);
+
+	/* Read only mode depends on columns' positions, so projection is ignored then */
+	if(builder->priv->projection && !builder->priv->read_only) {
+
+		gchar *projected = __get_projected_select(builder);
+		if(*projected != '\0')
+			g_string_append_printf(select, ", %s", projected);
+		g_free(projected);
+
+	} else {
+
+		g_string_append_printf(select, ", %s", 
+				klass->dbpriv->storage_data->query->select_full); /* TODO, Set select which suits better */
+	}
         
         return g_string_free(select, FALSE);        
 }
 
-static void __safe_string_from_field(GValue *val, gchar *row)
+#define __safe_metadata_string(__str, __row) \
+	{ \
+		const gchar *__value = __row; \
+		g_free(__str); \
+		if(__value == NULL || *__value == '\0') \
+			__str = NULL; \
+		else \
+			__str = g_strdup(__value); \
+	}
+
+#define __safe_metadata_int(__int, __rows, __col) \
+	if(!_midgard_core_rowset_is_null(__rows, __col)) \
+		__int = _midgard_core_rowset_get_int(__rows, __col);
+
+static void __set_value_from_rowset(MgdRowSet *rows, guint col, GValue *val)
 {
-	if(row == NULL)
+	_midgard_core_rowset_set_value(rows, col, val);
+
+	if(G_VALUE_HOLDS_STRING(val) && g_value_get_string(val) == NULL)
 		g_value_set_string(val, "");
-	else 
-		g_value_set_string(val, row);
 }
 
-static void __safe_uint_from_field(GValue *val, gchar *row)
+/* Fills object for every row. Columns are looked up once, and values
+ * are written to object's storage without string conversion
+ * when rows are read with binary protocol. */
+static GList *__set_objects_from_rowset(MidgardQueryBuilder *builder, MgdObject *nobject, MgdRowSet *rows)
 {
-	if(row == NULL)
-		g_value_set_uint(val, 0);
-	else 
-		g_value_set_uint(val, atoi(row));
-}
+	MidgardObjectClass *klass = (MidgardObjectClass*) g_type_class_peek(builder->priv->type);
+	MgdObject *object = NULL;
+	GList *list = NULL;
+	guint n_fields = _midgard_core_rowset_num_fields(rows);
+	guint j;
 
-static void __safe_int_from_field(GValue *val, gchar *row)
-{
-	if(row == NULL)
-		g_value_set_int(val, 0);
-	else 
-		g_value_set_int(val, atoi(row));
-}
+	/* Properties of columns following metadata ones */
+	GParamSpec **pspecs = g_new0(GParamSpec *, n_fields);
+	for(j = MGD_RES_OBJECT_IDX + 1; j < n_fields; j++)
+		pspecs[j] = g_object_class_find_property((GObjectClass *)klass,
+				_midgard_core_rowset_field_name(rows, j));
 
-static void __safe_float_from_field(GValue *val, gchar *row)
-{
-	if(row == NULL)
-		g_value_set_float(val, 0.0000);
-	else 
-		g_value_set_float(val, g_ascii_strtod(row, NULL));
-}
+	while(_midgard_core_rowset_fetch(rows)) {
 
-static void __safe_bool_from_field(GValue *val, gchar *row)
-{
-	if(row == NULL)
-		g_value_set_boolean(val, FALSE);
-	else 
-		g_value_set_boolean(val, atoi(row));
-}
+		if(nobject)
+			object = nobject;
+		else 
+			object = midgard_object_new(builder->priv->mgd, 
+				g_type_name(builder->priv->type), NULL);
 
-#define __safe_metadata_string(__str, __row) \
-	if(__str != NULL) \
-		g_free(__str); \
-	if(__row == NULL || *__row == '\0') \
-		__str = NULL; \
-	else \
-		__str = g_strdup(__row);
+		/* Object is going to be refilled, forget previous projection */
+		if(object->private->projection) {
+			g_hash_table_unref(object->private->projection);
+			object->private->projection = NULL;
+		}
 
-GList *_midgard_core_qb_set_object_from_query(MidgardQueryBuilder *builder, guint select_type, MgdObject *nobject){
+		MidgardMetadataPrivate *mpriv = object->metadata->private;
 
-        g_assert(builder != NULL);
+		/* We set metadata properties directly , but w get 
+		 * additional speed. g_object_set looses 10% of performance here */
+		__safe_metadata_string(mpriv->creator, _midgard_core_rowset_get_string(rows, 2));
+		g_free(mpriv->created);
+		mpriv->created = g_strdup(_midgard_core_rowset_get_string(rows, 3));
+		__safe_metadata_string(mpriv->revisor, _midgard_core_rowset_get_string(rows, 4));
+		g_free(mpriv->revised);
+		mpriv->revised = g_strdup(_midgard_core_rowset_get_string(rows, 5));
+		__safe_metadata_int(mpriv->revision, rows, 6);
+		__safe_metadata_string(mpriv->locker, _midgard_core_rowset_get_string(rows, 7));
+		g_free(mpriv->locked);
+		mpriv->locked = g_strdup(_midgard_core_rowset_get_string(rows, 8));
+		__safe_metadata_string(mpriv->approver, _midgard_core_rowset_get_string(rows, 9));
+		g_free(mpriv->approved);
+		mpriv->approved = g_strdup(_midgard_core_rowset_get_string(rows, 10));
+		g_free(mpriv->authors);
+		mpriv->authors = g_strdup(_midgard_core_rowset_get_string(rows, 11));
+		g_free(mpriv->owner);
+		mpriv->owner = g_strdup(_midgard_core_rowset_get_string(rows, 12));
+		g_free(mpriv->schedule_start);
+		mpriv->schedule_start = g_strdup(_midgard_core_rowset_get_string(rows, 13));
+		g_free(mpriv->schedule_end);
+		mpriv->schedule_end = g_strdup(_midgard_core_rowset_get_string(rows, 14));
+		__safe_metadata_int(mpriv->hidden, rows, 15);
+		__safe_metadata_int(mpriv->nav_noentry, rows, 16);
+		__safe_metadata_int(mpriv->size, rows, 17);
+		mpriv->stored_size = mpriv->size;
+		mpriv->stored_size_is_set = TRUE;
+		g_free(mpriv->published);
+		mpriv->published = g_strdup(_midgard_core_rowset_get_string(rows, 18));
+		g_free(mpriv->exported);
+		mpriv->exported = g_strdup(_midgard_core_rowset_get_string(rows, 19));
+		g_free(mpriv->imported);
+		mpriv->imported = g_strdup(_midgard_core_rowset_get_string(rows, 20));
+		__safe_metadata_int(mpriv->deleted, rows, 21);
+		__safe_metadata_int(mpriv->score, rows, 22);
+		if(!_midgard_core_rowset_is_null(rows, 23)) {
+			mpriv->is_locked = _midgard_core_rowset_get_int(rows, 23);
+			mpriv->lock_is_set = TRUE;
+		}
+		if(!_midgard_core_rowset_is_null(rows, 24)) {
+			mpriv->is_approved = _midgard_core_rowset_get_int(rows, 24);
+			mpriv->approve_is_set = TRUE;
+		}
+               
+		/* Set core's object private data */
+		object->private->exported = g_strdup(_midgard_core_rowset_get_string(rows, 19));
+		object->private->imported = g_strdup(_midgard_core_rowset_get_string(rows, 20));
+
+		for (j = MGD_RES_OBJECT_IDX + 1; j < n_fields; j++) {
+
+			if (pspecs[j] == NULL)
+				continue;
+
+			GValue *pval = _midgard_core_object_get_property_value(object, pspecs[j]);
+
+			if (pval) {
+				__set_value_from_rowset(rows, j, pval);
+				continue;
+			}
+
+			GValue tval = {0, };
+			g_value_init(&tval, pspecs[j]->value_type);
+			__set_value_from_rowset(rows, j, &tval);
+			g_object_set_property(G_OBJECT(object), pspecs[j]->name, &tval);
+			g_value_unset(&tval);
+		}
+	
+		/* Set private guid and sitegrup property */
+		object->private->guid = g_strdup(_midgard_core_rowset_get_string(rows, 0));
+		object->private->sg = _midgard_core_rowset_get_int(rows, 1);
+
+		/* Not selected properties are loaded when accessed for the first time */
+		if(builder->priv->projection) {
+			object->private->projection = g_hash_table_ref(builder->priv->projection);
+			object->private->projection_lang = builder->priv->lang;
+			object->private->projection_unset_lang = builder->priv->unset_lang;
+			object->private->projection_mgd_lang = mgd_lang(builder->priv->mgd);
+		}
+
+                list = g_list_prepend(list, G_OBJECT(object));                
+        }
+
+	g_free(pspecs);
+
+        return g_list_reverse(list);
+}
+
+gchar *_midgard_core_qb_get_object_sql(MidgardQueryBuilder *builder, guint select_type)
+{
+	g_assert(builder != NULL);
+
+	MidgardObjectClass *klass = (MidgardObjectClass*) g_type_class_peek(builder->priv->type);
 
-        GParamSpec *prop;
-        MgdObject *object = NULL;
-        GValue pval = {0, };
-        MidgardObjectClass *klass = (MidgardObjectClass*) g_type_class_peek(builder->priv->type);;
-        guint ret_rows, ret_fields, i, j;
-       
 	gchar *sql = _midgard_core_qb_get_sql(
 			builder, select_type, 
 			midgard_query_builder_get_object_select(builder, select_type), select_type == MQB_SELECT_GUID ? FALSE : TRUE);
 
-	if(!sql) {
-		g_warning("Attempted to execute NULL query");
+	if(!sql)
 		return NULL;
-	}		
 
 	/* Multilang fallback, wrap default fallback query */
 	if (select_type == MQB_SELECT_GUID && midgard_object_class_is_multilang (klass)) {	
@@ -589,12 +977,67 @@ GList *_midgard_core_qb_set_object_from_query(MidgardQueryBuilder *builder, guin
 		sql = g_string_free (ml, FALSE);
 	}
 
+	return sql;
+}
+
+GList *_midgard_core_qb_set_object_from_query(MidgardQueryBuilder *builder, guint select_type, MgdObject *nobject){
+
+        g_assert(builder != NULL);
+
+	gchar *sql = _midgard_core_qb_get_object_sql(builder, select_type);
+
+	if(!sql) {
+		g_warning("Attempted to execute NULL query");
+		return NULL;
+	}		
+
 	g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "query=%s", sql);
-        gint sq = mysql_query(builder->priv->mgd->msql->mysql, sql);
+	MYSQL *mysql = builder->priv->mgd->msql->mysql;
+	GTimer *timer = (_midgard_core_advisor_is_enabled() || _midgard_core_profiler_is_enabled()) ? 
+		g_timer_new() : NULL;
+
+	/* Read only objects keep text protocol rows, 
+	 * every other object is filled from row set */
+	if(select_type == MQB_SELECT_OBJECT && !builder->priv->read_only) {
+
+		MgdRowSet *rows = _midgard_core_rowset_query(mysql, sql,
+				_midgard_core_rowset_use_prepared(builder->priv->mgd->_mgd));
+		gdouble elapsed = timer ? g_timer_elapsed(timer, NULL) : 0;
+
+		if(!rows) {
+			if(timer)
+				g_timer_destroy(timer);
+			midgard_set_error(builder->priv->mgd->_mgd,
+					MGD_GENERIC_ERROR,
+					MGD_ERR_INTERNAL,
+					" SQL query failed. ");
+			g_clear_error(&builder->priv->mgd->_mgd->err);
+			g_free(sql);
+			return NULL;
+		}
+
+		GList *list = __set_objects_from_rowset(builder, nobject, rows);
+
+		if(timer) {
+			_midgard_core_advisor_record(builder, elapsed);
+			_midgard_core_profiler_record_rows(mysql, sql, MIDGARD_QUERY_ORIGIN_BUILDER, elapsed, 
+					_midgard_core_rowset_num_rows(rows), _midgard_core_rowset_bytes(rows));
+			g_timer_destroy(timer);
+		}
+
+		_midgard_core_rowset_free(rows);
+		g_free(sql);
+
+		return list;
+	}
+
+        gint sq = mysql_query(mysql, sql);
 
         if (sq != 0) {
+		if(timer)
+			g_timer_destroy(timer);
 		g_warning("\nQUERY FAILED: \n %s \n QUERY: \n %s",
-				mysql_error(builder->priv->mgd->msql->mysql), sql);
+				mysql_error(mysql), sql);
 		midgard_set_error(builder->priv->mgd->_mgd,
 				MGD_GENERIC_ERROR,
 				MGD_ERR_INTERNAL,
@@ -603,14 +1046,36 @@ GList *_midgard_core_qb_set_object_from_query(MidgardQueryBuilder *builder, guin
 		g_free(sql); 
 		return FALSE;
         }
-	g_free(sql);
       
         /* We use MySQL API directly, no mgd_query and midgard_res usage */
-        MYSQL_ROW row;
-        MYSQL_FIELD *field;
-        MYSQL_RES *results = mysql_store_result(builder->priv->mgd->msql->mysql);
+        MYSQL_RES *results = mysql_store_result(mysql);
+
+	if(timer) {
+		gdouble elapsed = g_timer_elapsed(timer, NULL);
+		_midgard_core_advisor_record(builder, elapsed);
+		_midgard_core_profiler_record(mysql, sql, 
+				MIDGARD_QUERY_ORIGIN_BUILDER, elapsed, results);
+		g_timer_destroy(timer);
+	}
+	g_free(sql);
+
         if (!results)
                 return FALSE;
+
+	return _midgard_core_qb_set_object_from_result(builder, select_type, nobject, results);
+}
+
+/* Takes ownership of results. Read only objects keep a reference to it,
+ * otherwise it's freed before return. */
+GList *_midgard_core_qb_set_object_from_result(MidgardQueryBuilder *builder, guint select_type, 
+		MgdObject *nobject, MYSQL_RES *results)
+{
+	g_assert(builder != NULL);
+	g_assert(results != NULL);
+
+        MgdObject *object = NULL;
+        guint ret_rows, i;
+        MYSQL_ROW row;
         
         if ((ret_rows = mysql_num_rows(results)) == 0) {
                 mysql_free_result(results);
@@ -665,124 +1130,99 @@ GList *_midgard_core_qb_set_object_from_query(MidgardQueryBuilder *builder, guin
         	return g_list_reverse (list);
 	}
 
-        /* Get every row */
-        for(i = 0; i < ret_rows; i++){
-                
-                row = mysql_fetch_row(results);
-                
-		if(nobject)
-			object = nobject;
-		else 
-			object = midgard_object_new(builder->priv->mgd, 
-				g_type_name(builder->priv->type), NULL);
+	MgdRowSet *rows = _midgard_core_rowset_new(results);
+	list = __set_objects_from_rowset(builder, nobject, rows);
+	_midgard_core_rowset_free(rows);
 
-		ret_fields =  mysql_num_fields(results); 
-               
-		/* We set metadata properties directly , but w get 
-		 * additional speed. g_object_set looses 10% of performance here */
-		__safe_metadata_string(object->metadata->private->creator, (gchar *)row[2]);
-		g_free(object->metadata->private->created);
-		object->metadata->private->created = g_strdup((gchar *)row[3]);
-		__safe_metadata_string(object->metadata->private->revisor, (gchar *)row[4]);
-		g_free(object->metadata->private->revised);
-		object->metadata->private->revised = g_strdup((gchar *)row[5]);
-		if(row[6] != NULL)
-			object->metadata->private->revision = atoi(row[6]);	
-		__safe_metadata_string(object->metadata->private->locker, (gchar *)row[7]);
-		g_free(object->metadata->private->locked);
-		object->metadata->private->locked = g_strdup((gchar *)row[8]);
-		__safe_metadata_string(object->metadata->private->approver, (gchar *)row[9]);
-		g_free(object->metadata->private->approved);
-		object->metadata->private->approved = g_strdup((gchar *)row[10]);
-		g_free(object->metadata->private->authors);
-		object->metadata->private->authors = g_strdup((gchar *)row[11]);
-		g_free(object->metadata->private->owner);
-		object->metadata->private->owner = g_strdup((gchar *)row[12]);
-		g_free(object->metadata->private->schedule_start);
-		object->metadata->private->schedule_start = g_strdup((gchar *)row[13]);
-		g_free(object->metadata->private->schedule_end);
-		object->metadata->private->schedule_end = g_strdup((gchar *)row[14]);
-		if(row[15] != NULL)
-			object->metadata->private->hidden = atoi(row[15]);
-		if(row[16] != NULL)
-			object->metadata->private->nav_noentry = atoi(row[16]);
-		if(row[17] != NULL)
-			object->metadata->private->size = atoi(row[17]);
-		g_free(object->metadata->private->published);
-		object->metadata->private->published = g_strdup((gchar *)row[18]);
-		g_free(object->metadata->private->exported);
-		object->metadata->private->exported = g_strdup((gchar *)row[19]);
-		g_free(object->metadata->private->imported);
-		object->metadata->private->imported = g_strdup((gchar *)row[20]);
-		if(row[21] != NULL)
-			object->metadata->private->deleted = atoi(row[21]);
-		if(row[22] != NULL)
-			object->metadata->private->score = atoi(row[22]);
-		if(row[23] != NULL) {
-			object->metadata->private->is_locked = atoi(row[23]);
-			object->metadata->private->lock_is_set = TRUE;
-		}
-		if(row[24] != NULL) {
-			object->metadata->private->is_approved = atoi(row[24]);
-			object->metadata->private->approve_is_set = TRUE;
-		}
-               
-		/* Set core's object private data */
-		object->private->exported = g_strdup((gchar *)row[19]);
-		object->private->imported = g_strdup((gchar *)row[20]);
-
-                /* Get all fields */
-                /* We can set guid and sitegroup as row[0] and row[1]
-                 * and start loop from 16 to increase speed. 
-                 * All in all metadata won't be changed often */
-                for (j = 0; j < ret_fields; j++){
-                       
-			if(j < 24)
-				continue;
-                        field = mysql_fetch_field_direct(results, j);
-                                              
-                        if ((prop = g_object_class_find_property(
-                                                        (GObjectClass *)klass, field->name)) != NULL) {
-
-                                g_value_init(&pval,prop->value_type);
-
-                                switch(prop->value_type){
-
-                                        case G_TYPE_STRING:				
-						__safe_string_from_field(&pval, (gchar *)row[j]);
-                                                break; 
-
-                                        case G_TYPE_UINT:
-						__safe_uint_from_field(&pval, (gchar *)row[j]);
-                                                break;
-
-					case G_TYPE_INT:
-						__safe_int_from_field(&pval, (gchar *)row[j]);
-						break;
-
-                                        case G_TYPE_FLOAT:
-						__safe_float_from_field(&pval, (gchar *)row[j]);
-                                                break;
-                                        
-                                        case G_TYPE_BOOLEAN:
-						__safe_bool_from_field(&pval, (gchar *)row[j]);
-                                                break;                                     
-                                                
-                                }
-                                g_object_set_property(G_OBJECT(object), field->name, &pval);
-                                g_value_unset(&pval);                                
-                        }                               
-                }
-	
-		/* Set private guid and sitegrup property */
-		object->private->guid = g_strdup((gchar *)row[0]);
-		object->private->sg = atoi(row[1]);
+	return list;
+}
 
-                list = g_list_prepend(list, G_OBJECT(object));                
-        }
+gboolean _midgard_core_qb_load_projected(MgdObject *object)
+{
+	g_assert(object != NULL);
 
-        mysql_free_result(results);
-        return g_list_reverse(list);
+	GHashTable *projection = object->private->projection;
+
+	if(projection == NULL)
+		return TRUE;
+
+	/* Unset it first, properties are set for the same object below */
+	object->private->projection = NULL;
+
+	MidgardQueryBuilder *builder = 
+		midgard_query_builder_new(object->mgd, G_OBJECT_TYPE_NAME(object));
+
+	if(!builder) {
+		g_hash_table_unref(projection);
+		return FALSE;
+	}
+
+	GValue gval = {0, };
+	g_value_init(&gval, G_TYPE_STRING);
+	g_value_set_string(&gval, object->private->guid);
+	midgard_query_builder_add_constraint(builder, "guid", "=", &gval);
+	g_value_unset(&gval);
+	midgard_query_builder_include_deleted(builder);
+
+	/* Load the same language content which projected properties come from.
+	 * Builder without language follows connection's one, which might
+	 * have changed since then. */
+	midgard *mgd = object->mgd;
+	gint current_lang = mgd->lang;
+
+	if(object->private->projection_unset_lang)
+		midgard_query_builder_unset_languages(builder);
+	else if(object->private->projection_lang >= 0)
+		midgard_query_builder_set_lang(builder, object->private->projection_lang);
+	else
+		mgd->lang = object->private->projection_mgd_lang;
+
+	GList *list = _midgard_core_qb_set_object_from_query(builder, MQB_SELECT_OBJECT, NULL);
+	g_object_unref(builder);
+
+	mgd->lang = current_lang;
+
+	if(list == NULL) {
+		g_warning("Can not load properties of '%s' object identified by '%s'", 
+				G_OBJECT_TYPE_NAME(object), object->private->guid);
+		g_hash_table_unref(projection);
+		return FALSE;
+	}
+
+	GObject *full = G_OBJECT(list->data);
+	guint n_props, i;
+	GParamSpec **pspecs = g_object_class_list_properties(G_OBJECT_GET_CLASS(object), &n_props);
+
+	for(i = 0; i < n_props; i++) {
+
+		/* Keep selected properties, these might be already changed */
+		if(g_hash_table_lookup(projection, pspecs[i]->name))
+			continue;
+
+		if(!(pspecs[i]->flags & G_PARAM_WRITABLE) 
+				|| G_TYPE_FUNDAMENTAL(pspecs[i]->value_type) == G_TYPE_OBJECT)
+			continue;
+
+		if(g_str_equal(pspecs[i]->name, "guid") || g_str_equal(pspecs[i]->name, "sitegroup"))
+			continue;
+
+		GValue pval = {0, };
+		g_value_init(&pval, pspecs[i]->value_type);
+		g_object_get_property(full, pspecs[i]->name, &pval);
+		g_object_set_property(G_OBJECT(object), pspecs[i]->name, &pval);
+		g_value_unset(&pval);
+	}
+
+	g_free(pspecs);
+
+	GList *l;
+	for(l = list; l; l = l->next)
+		g_object_unref(l->data);
+	g_list_free(list);
+
+	g_hash_table_unref(projection);
+
+	return TRUE;
 }
 
 gboolean midgard_query_builder_join(
@@ -98,4 +98,6 @@ extern MgdSchemaTypeAttr * midgard_schema_lookup_type (MidgardSchema *schema, gc
 extern GType
 midgard_type_register(const gchar *class_name, MgdSchemaTypeAttr *data);
 
+extern GType _midgard_core_schema_gtype_from_name(const gchar *name);
+
 #endif /* _PRIVATE_SCHEMA_H */
@@ -38,6 +38,17 @@
 #include <unistd.h>
 #endif
 #include <time.h>
+#include <fcntl.h>
+#include <string.h>
+#ifdef HAVE_LINUX_FS_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+#include "midgard/midgard_timestamp.h"
+#include "midgard/midgard_error.h"
+#include "midgard_mysql.h"
+#include "midgard_core_pagecache.h"
+#include "midgard_core_acl.h"
 
 static void mgd_copy_all_parameters(midgard * mgd, int id, const char * table,
                                                     int newoid)
@@ -484,6 +495,752 @@ int mgd_copy_snippet(midgard * mgd, int id, int newsnippetdir)
 	return i;
 }
 
+/* SET BASED SUBTREE COPY
+ *
+ * Subtree is copied with one INSERT ... SELECT per tree level and per
+ * dependent table, in one transaction. Tables are created with server's
+ * default storage engine, and statements are rolled back only if it's
+ * transactional one (InnoDB). With MyISAM, records copied before failure
+ * are left in place. Ids of copied records are mapped
+ * to ids of their copies in temporary mgd_copy_map_<table> tables, which
+ * are joined to remap up, parent and owner fields of next levels,
+ * parameters, attachments and multilang content.
+ *
+ * Copies are inserted with temporary guid made of copy's token and
+ * original id, which maps them back. Real guids, generated with
+ * midgard_guid_new, are written for every level afterwards, and
+ * repligard records are created for all copies of a table at once.
+ *
+ * Blob files are cloned (reflinked) if filesystem supports it, copied
+ * otherwise. They are never hard linked, as blobs are written in place. */
+
+#define MGD_TREE_COPY_MAX_LEVELS 1024
+/* Max number of ids in one IN (...) list */
+#define MGD_TREE_BATCH 1000
+#define MGD_TREE_COPY_BUF_SIZE 65536
+
+typedef struct {
+	midgard *mgd;
+	gchar *token;
+	gchar *now;
+	gchar *sgcond;
+	/* Tables whose map has been created */
+	GSList *maps;
+	/* Blob files created by copy, removed if copy fails */
+	GSList *files;
+} MgdTreeCopy;
+
+typedef struct {
+	const gchar *column;
+	/* SQL expression replacing column's value, copied record is 'src' */
+	const gchar *expr;
+} MgdTreeCopyColumn;
+
+static const gchar *__tree_typename(const gchar *table)
+{
+	static const gchar *typenames[][2] = {
+		{ "article", "midgard_article" },
+		{ "blobs", "midgard_attachment" },
+		{ "element", "midgard_element" },
+		{ "event", "midgard_event" },
+		{ "eventmember", "midgard_eventmember" },
+		{ "grp", "midgard_group" },
+		{ "page", "midgard_page" },
+		{ "pageelement", "midgard_pageelement" },
+		{ "record_extension", "midgard_parameter" },
+		{ "snippet", "midgard_snippet" },
+		{ "snippetdir", "midgard_snippetdir" },
+		{ "style", "midgard_style" },
+		{ "topic", "midgard_topic" },
+		{ NULL, NULL }
+	};
+	guint i;
+
+	for(i = 0; typenames[i][0] != NULL; i++) {
+		if(g_str_equal(table, typenames[i][0]))
+			return typenames[i][1];
+	}
+
+	return "";
+}
+
+static gboolean __tree_exec(midgard *mgd, const gchar *sql)
+{
+	MYSQL *mysql = mgd->msql->mysql;
+
+	if(mysql_query(mysql, sql) != 0) {
+
+		g_warning("Subtree query failed: %s", mysql_error(mysql));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Executes prefix (ids) suffix for every batch of ids */
+static gboolean __tree_exec_in(midgard *mgd, const gchar *prefix,
+		GArray *ids, const gchar *suffix)
+{
+	guint i, j;
+	gboolean rv = TRUE;
+
+	for(i = 0; rv && i < ids->len; i += MGD_TREE_BATCH) {
+
+		GString *sql = g_string_new(prefix);
+		g_string_append_c(sql, '(');
+
+		for(j = i; j < ids->len && j < i + MGD_TREE_BATCH; j++)
+			g_string_append_printf(sql, "%s%d", j > i ? "," : "",
+					g_array_index(ids, gint, j));
+
+		g_string_append_c(sql, ')');
+		g_string_append(sql, suffix);
+
+		rv = __tree_exec(mgd, sql->str);
+		g_string_free(sql, TRUE);
+	}
+
+	return rv;
+}
+
+static gboolean __copy_exec(MgdTreeCopy *copy, const gchar *sql)
+{
+	return __tree_exec(copy->mgd, sql);
+}
+
+static MgdTreeCopy *__copy_begin(midgard *mgd)
+{
+	MgdTreeCopy *copy = g_new0(MgdTreeCopy, 1);
+	copy->mgd = mgd;
+
+	gchar *guid = midgard_guid_new(mgd);
+	copy->token = g_strdup_printf("%s:", guid);
+	g_free(guid);
+
+	GValue tval = {0, };
+	g_value_init(&tval, MIDGARD_TYPE_TIMESTAMP);
+	midgard_timestamp_set_time(&tval, time(NULL));
+	copy->now = midgard_timestamp_dup_string(&tval);
+	g_value_unset(&tval);
+
+	copy->sgcond = g_strdup_printf(
+			"(src.sitegroup IN (0,%d) OR %d<>0) AND src.metadata_deleted=0",
+			mgd_sitegroup(mgd), mgd_isroot(mgd));
+
+	if(!__copy_exec(copy, "START TRANSACTION")) {
+		g_free(copy->token);
+		g_free(copy->now);
+		g_free(copy->sgcond);
+		g_free(copy);
+		return NULL;
+	}
+
+	return copy;
+}
+
+static gboolean __copy_map(MgdTreeCopy *copy, const gchar *table)
+{
+	if(g_slist_find_custom(copy->maps, table, (GCompareFunc) strcmp))
+		return TRUE;
+
+	gchar *sql = g_strdup_printf(
+			"CREATE TEMPORARY TABLE mgd_copy_map_%s ("
+			"old INT UNSIGNED NOT NULL, new INT UNSIGNED NOT NULL, "
+			"level INT NOT NULL, pending TINYINT NOT NULL, "
+			"PRIMARY KEY (old), KEY (level), KEY (new))",
+			table);
+	gboolean rv = __copy_exec(copy, sql);
+	g_free(sql);
+
+	if(rv)
+		copy->maps = g_slist_prepend(copy->maps, g_strdup(table));
+
+	return rv;
+}
+
+/* Ends copy, commits or rolls back. Returns FALSE if copy failed. */
+static gboolean __copy_end(MgdTreeCopy *copy, gboolean success)
+{
+	GSList *l;
+
+	if(success)
+		success = __copy_exec(copy, "COMMIT");
+
+	if(!success) {
+
+		__copy_exec(copy, "ROLLBACK");
+
+		for(l = copy->files; l != NULL; l = l->next)
+			unlink((const gchar *) l->data);
+	}
+
+	for(l = copy->maps; l != NULL; l = l->next) {
+
+		gchar *sql = g_strdup_printf("DROP TEMPORARY TABLE mgd_copy_map_%s",
+				(const gchar *) l->data);
+		__copy_exec(copy, sql);
+		g_free(sql);
+
+		/* Drop cached state of copied objects' classes */
+		_midgard_core_pagecache_class_changed(__tree_typename((const gchar *) l->data));
+		_midgard_core_acl_class_changed(__tree_typename((const gchar *) l->data));
+	}
+
+	g_slist_foreach(copy->maps, (GFunc) g_free, NULL);
+	g_slist_free(copy->maps);
+	g_slist_foreach(copy->files, (GFunc) g_free, NULL);
+	g_slist_free(copy->files);
+	g_free(copy->token);
+	g_free(copy->now);
+	g_free(copy->sgcond);
+	g_free(copy);
+
+	return success;
+}
+
+/* Returns table's columns, NULL on failure */
+static GPtrArray *__copy_columns(MgdTreeCopy *copy, const gchar *table)
+{
+	gchar *sql = g_strdup_printf("SHOW COLUMNS FROM %s", table);
+	midgard_res *res = mgd_query(copy->mgd, sql);
+	g_free(sql);
+
+	if(res == NULL)
+		return NULL;
+
+	GPtrArray *columns = g_ptr_array_new();
+
+	while(mgd_fetch(res))
+		g_ptr_array_add(columns, g_strdup(mgd_colvalue(res, 0)));
+
+	mgd_release(res);
+
+	return columns;
+}
+
+/* Replaces temporary guids of table's copies with guids generated
+ * by midgard_guid_new, as every created object gets them */
+static gboolean __copy_guids(MgdTreeCopy *copy, const gchar *table)
+{
+	gchar *sql = g_strdup_printf("SELECT id FROM %s WHERE guid LIKE '%s%%'",
+			table, copy->token);
+	midgard_res *res = mgd_query(copy->mgd, sql);
+	g_free(sql);
+
+	if(res == NULL)
+		return mysql_errno(copy->mgd->msql->mysql) == 0;
+
+	GString *cases = g_string_new("");
+	GString *ids = g_string_new("");
+	gboolean rv = TRUE;
+	guint n = 0;
+
+	while(rv && mgd_fetch(res)) {
+
+		gchar *guid = midgard_guid_new(copy->mgd);
+		g_string_append_printf(cases, " WHEN %s THEN '%s'", mgd_colvalue(res, 0), guid);
+		g_string_append_printf(ids, "%s%s", ids->len ? "," : "", mgd_colvalue(res, 0));
+		g_free(guid);
+
+		if(++n < MGD_TREE_BATCH)
+			continue;
+
+		sql = g_strdup_printf("UPDATE %s SET guid=CASE id%s END WHERE id IN (%s)",
+				table, cases->str, ids->str);
+		rv = __copy_exec(copy, sql);
+		g_free(sql);
+
+		g_string_truncate(cases, 0);
+		g_string_truncate(ids, 0);
+		n = 0;
+	}
+
+	mgd_release(res);
+
+	if(rv && ids->len > 0) {
+
+		sql = g_strdup_printf("UPDATE %s SET guid=CASE id%s END WHERE id IN (%s)",
+				table, cases->str, ids->str);
+		rv = __copy_exec(copy, sql);
+		g_free(sql);
+	}
+
+	g_string_free(cases, TRUE);
+	g_string_free(ids, TRUE);
+
+	return rv;
+}
+
+/* Copies records selected from table with joins and where clause.
+ * Columns' values are copied, unless replaced by expressions in columns.
+ * Copies are mapped in table's map at given level, and stay pending
+ * until __copy_finish. Multilang content tables are not mapped.
+ * Returns number of copied records or -1 on failure. */
+static gint __copy_rows(MgdTreeCopy *copy, const gchar *table, const gchar *joins,
+		const gchar *where, const MgdTreeCopyColumn *columns, gint level)
+{
+	GPtrArray *names = __copy_columns(copy, table);
+	gboolean content = g_str_has_suffix(table, "_i");
+	guint i, j;
+
+	if(names == NULL)
+		return -1;
+
+	if(!content && !__copy_map(copy, table)) {
+		g_ptr_array_foreach(names, (GFunc) g_free, NULL);
+		g_ptr_array_free(names, TRUE);
+		return -1;
+	}
+
+	GString *fields = g_string_new("");
+	GString *values = g_string_new("");
+
+	for(i = 0; i < names->len; i++) {
+
+		const gchar *name = g_ptr_array_index(names, i);
+		const gchar *expr = NULL;
+
+		if(g_str_equal(name, "id"))
+			continue;
+
+		for(j = 0; columns && columns[j].column != NULL; j++) {
+			if(g_str_equal(name, columns[j].column))
+				expr = columns[j].expr;
+		}
+
+		if(fields->len > 0) {
+			g_string_append_c(fields, ',');
+			g_string_append_c(values, ',');
+		}
+
+		g_string_append_printf(fields, "`%s`", name);
+
+		if(expr != NULL)
+			g_string_append(values, expr);
+		else if(g_str_equal(name, "sitegroup"))
+			g_string_append_printf(values, "%d", mgd_sitegroup(copy->mgd));
+		else if(!content && g_str_equal(name, "guid"))
+			g_string_append_printf(values, "CONCAT('%s',src.id)", copy->token);
+		else if(!content && (g_str_equal(name, "metadata_created")
+					|| g_str_equal(name, "metadata_revised")))
+			g_string_append_printf(values, "'%s'", copy->now);
+		else
+			g_string_append_printf(values, "src.`%s`", name);
+	}
+
+	g_ptr_array_foreach(names, (GFunc) g_free, NULL);
+	g_ptr_array_free(names, TRUE);
+
+	gchar *sql = g_strdup_printf("INSERT INTO %s (%s) SELECT %s FROM %s AS src %s WHERE %s",
+			table, fields->str, values->str, table, joins ? joins : "", where);
+	g_string_free(fields, TRUE);
+	g_string_free(values, TRUE);
+
+	gboolean rv = __copy_exec(copy, sql);
+	g_free(sql);
+
+	if(!rv)
+		return -1;
+
+	gint copied = (gint) mysql_affected_rows(copy->mgd->msql->mysql);
+
+	if(content || copied == 0)
+		return copied;
+
+	/* Map copies back to originals, and give them real guids */
+	sql = g_strdup_printf("INSERT INTO mgd_copy_map_%s (old,new,level,pending) "
+			"SELECT SUBSTRING(guid,%d),id,%d,1 FROM %s WHERE guid LIKE '%s%%'",
+			table, (gint) strlen(copy->token) + 1, level, table, copy->token);
+	rv = __copy_exec(copy, sql);
+	g_free(sql);
+
+	if(!rv)
+		return -1;
+
+	return __copy_guids(copy, table) ? copied : -1;
+}
+
+/* Creates repligard records of table's pending copies */
+static gboolean __copy_finish(MgdTreeCopy *copy, const gchar *table)
+{
+	if(!g_slist_find_custom(copy->maps, table, (GCompareFunc) strcmp))
+		return TRUE;
+
+	gchar *sql = g_strdup_printf("INSERT INTO repligard "
+			"(realm,typename,guid,id,changed,action,sitegroup) "
+			"SELECT '%s','%s',t.guid,t.id,NULL,'create',t.sitegroup "
+			"FROM %s AS t JOIN mgd_copy_map_%s AS m ON m.new=t.id WHERE m.pending=1",
+			table, __tree_typename(table), table, table);
+	gboolean rv = __copy_exec(copy, sql);
+	g_free(sql);
+
+	if(!rv)
+		return FALSE;
+
+	sql = g_strdup_printf("UPDATE mgd_copy_map_%s SET pending=0", table);
+	rv = __copy_exec(copy, sql);
+	g_free(sql);
+
+	return rv;
+}
+
+/* Copies tree level by level. Root's copy is placed at top level. */
+static gboolean __copy_tree(MgdTreeCopy *copy, const gchar *table, int root)
+{
+	MgdTreeCopyColumn columns[] = { { "up", NULL }, { NULL, NULL } };
+	gint level, copied;
+
+	/* Root is copied even if it's deleted, as before */
+	gchar *where = g_strdup_printf("src.id=%d AND (src.sitegroup IN (0,%d) OR %d<>0)",
+			root, mgd_sitegroup(copy->mgd), mgd_isroot(copy->mgd));
+	columns[0].expr = "0";
+	copied = __copy_rows(copy, table, NULL, where, columns, 0);
+	g_free(where);
+
+	columns[0].expr = "mu.new";
+
+	for(level = 1; copied > 0 && level < MGD_TREE_COPY_MAX_LEVELS; level++) {
+
+		gchar *joins = g_strdup_printf(
+				"JOIN mgd_copy_map_%s AS mu ON mu.old=src.up AND mu.level=%d",
+				table, level - 1);
+		copied = __copy_rows(copy, table, joins, copy->sgcond, columns, level);
+		g_free(joins);
+	}
+
+	if(copied != 0) {
+
+		if(copied > 0)
+			g_warning("Subtree copy of %s %d exceeds %d levels",
+					table, root, MGD_TREE_COPY_MAX_LEVELS);
+		return FALSE;
+	}
+
+	return __copy_finish(copy, table);
+}
+
+/* Copies records of table whose parent field points to copied records of parent table */
+static gboolean __copy_children(MgdTreeCopy *copy, const gchar *table,
+		const gchar *parentfield, const gchar *parent, const gchar *extra)
+{
+	MgdTreeCopyColumn columns[] = { { parentfield, "mp.new" }, { NULL, NULL } };
+	gchar *joins = g_strdup_printf("JOIN mgd_copy_map_%s AS mp ON mp.old=src.%s",
+			parent, parentfield);
+	gchar *where = extra ? g_strdup_printf("%s AND %s", copy->sgcond, extra)
+		: g_strdup(copy->sgcond);
+
+	gint copied = __copy_rows(copy, table, joins, where, columns, 0);
+
+	g_free(joins);
+	g_free(where);
+
+	if(copied < 0)
+		return FALSE;
+
+	return __copy_finish(copy, table);
+}
+
+/* Copies articles of copied topics, and their replies */
+static gboolean __copy_articles(MgdTreeCopy *copy)
+{
+	MgdTreeCopyColumn columns[] = {
+		{ "topic", "mt.new" }, { "up", "0" }, { NULL, NULL }
+	};
+	gint level, copied;
+
+	gchar *where = g_strdup_printf("%s AND src.up=0", copy->sgcond);
+	copied = __copy_rows(copy, "article",
+			"JOIN mgd_copy_map_topic AS mt ON mt.old=src.topic",
+			where, columns, 0);
+	g_free(where);
+
+	/* Replies belong to topic of their parent's copy */
+	columns[0].expr = "p.topic";
+	columns[1].expr = "mu.new";
+
+	for(level = 1; copied > 0 && level < MGD_TREE_COPY_MAX_LEVELS; level++) {
+
+		gchar *joins = g_strdup_printf(
+				"JOIN mgd_copy_map_article AS mu ON mu.old=src.up AND mu.level=%d "
+				"JOIN article AS p ON p.id=mu.new", level - 1);
+		copied = __copy_rows(copy, "article", joins, copy->sgcond, columns, level);
+		g_free(joins);
+	}
+
+	if(copied != 0)
+		return FALSE;
+
+	return __copy_finish(copy, "article");
+}
+
+#if HAVE_MIDGARD_MULTILANG
+/* Copies multilang content of copied records */
+static gboolean __copy_content(MgdTreeCopy *copy, const gchar *table)
+{
+	/* Tables with content, copied by per record copy as well */
+	static const gchar *content_tables[] = {
+		"article", "element", "page", "pageelement", NULL
+	};
+	guint i;
+
+	for(i = 0; content_tables[i] != NULL; i++) {
+		if(g_str_equal(table, content_tables[i]))
+			break;
+	}
+
+	if(content_tables[i] == NULL
+			|| !g_slist_find_custom(copy->maps, table, (GCompareFunc) strcmp))
+		return TRUE;
+
+	MgdTreeCopyColumn columns[] = { { "sid", "ms.new" }, { NULL, NULL } };
+	gchar *table_i = g_strconcat(table, "_i", NULL);
+	gchar *joins = g_strdup_printf("JOIN mgd_copy_map_%s AS ms ON ms.old=src.sid", table);
+
+	gint copied = __copy_rows(copy, table_i, joins, "1=1", columns, 0);
+
+	g_free(table_i);
+	g_free(joins);
+
+	return copied >= 0;
+}
+#endif /* HAVE_MIDGARD_MULTILANG */
+
+/* Copies parameters of copied records */
+static gboolean __copy_parameters(MgdTreeCopy *copy, const gchar *table)
+{
+	if(!g_slist_find_custom(copy->maps, table, (GCompareFunc) strcmp))
+		return TRUE;
+
+	gchar *extra = g_strdup_printf("src.tablename='%s'", table);
+	gboolean rv = __copy_children(copy, "record_extension", "oid", table, extra);
+	g_free(extra);
+
+	return rv;
+}
+
+static gboolean __clone_file(const gchar *from, const gchar *to)
+{
+	gchar *buf;
+	ssize_t len;
+	int in, out;
+	gboolean rv = TRUE;
+
+	if((in = open(from, O_RDONLY)) < 0)
+		return FALSE;
+
+	if((out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+		close(in);
+		return FALSE;
+	}
+
+#if defined(HAVE_LINUX_FS_H) && defined(FICLONE)
+	/* Copy on write clone, if filesystem supports it */
+	if(ioctl(out, FICLONE, in) == 0) {
+		close(in);
+		return close(out) == 0;
+	}
+#endif
+
+	buf = g_malloc(MGD_TREE_COPY_BUF_SIZE);
+
+	while(rv && (len = read(in, buf, MGD_TREE_COPY_BUF_SIZE)) != 0) {
+
+		ssize_t written = 0;
+
+		if(len < 0) {
+			rv = (errno == EINTR);
+			continue;
+		}
+
+		while(rv && written < len) {
+
+			ssize_t n = write(out, buf + written, len - written);
+
+			if(n < 0)
+				rv = (errno == EINTR);
+			else
+				written += n;
+		}
+	}
+
+	g_free(buf);
+	close(in);
+
+	return close(out) == 0 && rv;
+}
+
+/* Gives pending blob copies new locations and copies their files */
+static gboolean __copy_blob_files(MgdTreeCopy *copy)
+{
+	static char dir[16] = "0123456789ABCDEF";
+	const gchar *blobdir = mgd_get_blobdir(copy->mgd);
+	gboolean rv = TRUE;
+
+	midgard_res *res = mgd_query(copy->mgd,
+			"SELECT b.id,b.guid,b.location FROM blobs AS b "
+			"JOIN mgd_copy_map_blobs AS m ON m.new=b.id WHERE m.pending=1");
+
+	if(res == NULL)
+		return mysql_errno(copy->mgd->msql->mysql) == 0;
+
+	GString *cases = g_string_new("");
+	GString *ids = g_string_new("");
+
+	while(rv && mgd_fetch(res)) {
+
+		const gchar *guid = mgd_colvalue(res, 1);
+		const gchar *old_location = mgd_colvalue(res, 2);
+
+		/* The same hashing as in mgd_copy_object_blob */
+		gchar *location = g_strdup_printf("%c/%c/%s",
+				dir[((unsigned char) guid[0]) / 16],
+				dir[((unsigned char) guid[0]) % 16], guid);
+		gchar *from = g_strdup_printf("%s/%s", blobdir, old_location);
+		gchar *to = g_strdup_printf("%s/%s", blobdir, location);
+
+		if(__clone_file(from, to)) {
+
+			copy->files = g_slist_prepend(copy->files, to);
+			g_string_append_printf(cases, " WHEN %s THEN '%s'",
+					mgd_colvalue(res, 0), location);
+			g_string_append_printf(ids, "%s%s",
+					ids->len ? "," : "", mgd_colvalue(res, 0));
+
+		} else {
+
+			g_warning("Can not copy blob file %s to %s: %s",
+					from, to, g_strerror(errno));
+			g_free(to);
+			rv = FALSE;
+		}
+
+		g_free(from);
+		g_free(location);
+	}
+
+	mgd_release(res);
+
+	if(rv && ids->len > 0) {
+
+		gchar *sql = g_strdup_printf("UPDATE blobs SET location=CASE id%s END WHERE id IN (%s)",
+				cases->str, ids->str);
+		rv = __copy_exec(copy, sql);
+		g_free(sql);
+	}
+
+	g_string_free(cases, TRUE);
+	g_string_free(ids, TRUE);
+
+	return rv;
+}
+
+/* Copies attachments of copied records, with their files and parameters */
+static gboolean __copy_attachments(MgdTreeCopy *copy, const gchar *table)
+{
+	if(!g_slist_find_custom(copy->maps, table, (GCompareFunc) strcmp))
+		return TRUE;
+
+	MgdTreeCopyColumn columns[] = { { "pid", "mp.new" }, { NULL, NULL } };
+	gchar *joins = g_strdup_printf("JOIN mgd_copy_map_%s AS mp ON mp.old=src.pid", table);
+	gchar *where = g_strdup_printf("%s AND src.ptable='%s'", copy->sgcond, table);
+
+	gint copied = __copy_rows(copy, "blobs", joins, where, columns, 0);
+
+	g_free(joins);
+	g_free(where);
+
+	if(copied < 0)
+		return FALSE;
+
+	return __copy_blob_files(copy) && __copy_finish(copy, "blobs");
+}
+
+/* Copies parameters, attachments and content of copied records of given tables.
+ * Attachments' parameters are copied after all attachments. */
+static gboolean __copy_dependants(MgdTreeCopy *copy, const gchar **tables)
+{
+	guint i;
+
+	for(i = 0; tables[i] != NULL; i++) {
+
+		if(!__copy_parameters(copy, tables[i])
+				|| !__copy_attachments(copy, tables[i]))
+			return FALSE;
+#if HAVE_MIDGARD_MULTILANG
+		if(!__copy_content(copy, tables[i]))
+			return FALSE;
+#endif /* HAVE_MIDGARD_MULTILANG */
+	}
+
+	return __copy_parameters(copy, "blobs");
+}
+
+/* Returns id of root's copy, 0 if root has not been copied */
+static int __copy_root(MgdTreeCopy *copy, const gchar *table, int root)
+{
+	gchar *sql = g_strdup_printf("SELECT new FROM mgd_copy_map_%s WHERE old=%d", table, root);
+	midgard_res *res = mgd_query(copy->mgd, sql);
+	int id = 0;
+
+	g_free(sql);
+
+	if(res && mgd_fetch(res))
+		id = mgd_sql2int(res, 0);
+
+	if(res)
+		mgd_release(res);
+
+	return id;
+}
+
+/* TRUE if subtree can be copied or deleted with set based statements.
+ * Quota is checked, and versioned records are dumped, for every created
+ * or deleted record, so they need per record queries. */
+static gboolean __tree_is_bulk(midgard *mgd)
+{
+#if HAVE_MIDGARD_VC
+	if(mgd->cvs_script)
+		return FALSE;
+#endif /* HAVE_MIDGARD_VC */
+#if HAVE_MIDGARD_QUOTA
+	if(mgd->quota && mgd->current_user->sitegroup > 0)
+		return FALSE;
+#endif /* HAVE_MIDGARD_QUOTA */
+	return TRUE;
+}
+
+/* Copies tree of table with children records, and dependants of them all.
+ * Returns id of root's copy or 0. */
+static int __copy_subtree(midgard *mgd, const gchar *table, int root,
+		const gchar *child, const gchar *parentfield, const gchar **dependants)
+{
+	MgdTreeCopy *copy = __copy_begin(mgd);
+	int newroot = 0;
+
+	if(copy == NULL)
+		return 0;
+
+	gboolean rv = __copy_tree(copy, table, root);
+
+	if(rv && child != NULL) {
+		if(g_str_equal(child, "article"))
+			rv = __copy_articles(copy);
+		else
+			rv = __copy_children(copy, child, parentfield, table, NULL);
+	}
+
+	if(rv)
+		rv = __copy_dependants(copy, dependants);
+
+	if(rv)
+		newroot = __copy_root(copy, table, root);
+
+	if(!__copy_end(copy, rv))
+		return 0;
+
+	return newroot;
+}
+
 static int topic_copier(midgard * mgd, int id, int level, void *xparam)
 {
 	midgard_res *res, *art_res;
@@ -515,6 +1272,12 @@ static int topic_copier(midgard * mgd, int id, int level, void *xparam)
 int mgd_copy_topic(midgard * mgd, int root)
 {
 	int *ups, newroot;
+
+	if(__tree_is_bulk(mgd)) {
+		const gchar *dependants[] = { "topic", "article", NULL };
+		return __copy_subtree(mgd, "topic", root, "article", NULL, dependants);
+	}
+
 	/* This is ugly but how we could find number of sub-topics instead? */
 	ups = mgd_tree(mgd, "topic", "up", root, 0, NULL);
 	mgd_walk_table_tree(mgd, "topic", "up", root, 0, 1, (void *) ups,
@@ -616,6 +1379,12 @@ static int page_copier(midgard * mgd, int id, int level, void *xparam)
 int mgd_copy_page(midgard * mgd, int root)
 {
 	int *ups, newroot;
+
+	if(__tree_is_bulk(mgd)) {
+		const gchar *dependants[] = { "page", "pageelement", NULL };
+		return __copy_subtree(mgd, "page", root, "pageelement", "page", dependants);
+	}
+
 	/* This is ugly but how we could find number of sub-pages instead? */
 	ups = mgd_tree(mgd, "page", "up", root, 0, NULL);
 	mgd_walk_table_tree(mgd, "page", "up", root, 0, 1, (void *) ups,
@@ -667,6 +1436,12 @@ static int style_copier(midgard * mgd, int id, int level, void *xparam)
 int mgd_copy_style(midgard * mgd, int root)
 {
 	int *ups, newroot;
+
+	if(__tree_is_bulk(mgd)) {
+		const gchar *dependants[] = { "style", "element", NULL };
+		return __copy_subtree(mgd, "style", root, "element", "style", dependants);
+	}
+
 	/* This is ugly but how we could find number of sub-topics instead? */
 	ups = mgd_tree(mgd, "style", "up", root, 0, NULL);
 	mgd_walk_table_tree(mgd, "style", "up", root, 0, 1, (void *) ups,
@@ -802,6 +1577,286 @@ int mgd_delete_all_attachments(midgard * mgd, int id, const char * table)
 	return 1;
 }
 
+/* SET BASED SUBTREE DELETE
+ *
+ * Ids of tree nodes are collected with one tree build, and ids of their
+ * children, attachments and parameters with one query per table.
+ * Records, their content and repligard records are deleted with
+ * IN (...) statements of at most MGD_TREE_BATCH ids, in one
+ * transaction. Attachments' files are unlinked when it's committed.
+ * As with subtree copy, failed delete is rolled back only if tables use
+ * transactional storage engine. */
+
+typedef struct {
+	midgard *mgd;
+	/* Sitegroup condition of deleted records. The same condition selects
+	 * records, their repligard records and attachments' files. */
+	gchar *sgcond;
+	/* The same condition for table aliased as t */
+	gchar *sgcond_t;
+	/* Tables whose records are deleted */
+	GSList *tables;
+	/* Attachments' files to unlink */
+	GPtrArray *files;
+} MgdTreeDelete;
+
+/* Selects id (and location) FROM table WHERE field IN (ids) AND where,
+ * adds them to found ids (and locations) */
+static gboolean __delete_collect(MgdTreeDelete *del, const gchar *table,
+		const gchar *field, GArray *ids, const gchar *where,
+		GArray *found, GPtrArray *locations)
+{
+	guint i, j;
+
+	for(i = 0; i < ids->len; i += MGD_TREE_BATCH) {
+
+		GString *sql = g_string_new("");
+		g_string_printf(sql, "SELECT id%s FROM %s WHERE %s AND %s IN (",
+				locations ? ",location" : "", table, del->sgcond, field);
+
+		for(j = i; j < ids->len && j < i + MGD_TREE_BATCH; j++)
+			g_string_append_printf(sql, "%s%d", j > i ? "," : "",
+					g_array_index(ids, gint, j));
+
+		g_string_append_printf(sql, ")%s%s", where ? " AND " : "", where ? where : "");
+
+		midgard_res *res = mgd_query(del->mgd, sql->str);
+		g_string_free(sql, TRUE);
+
+		if(res == NULL && mysql_errno(del->mgd->msql->mysql) != 0)
+			return FALSE;
+
+		while(res && mgd_fetch(res)) {
+
+			gint id = mgd_sql2int(res, 0);
+			g_array_append_val(found, id);
+
+			if(locations)
+				g_ptr_array_add(locations, g_strdup(mgd_colvalue(res, 1)));
+		}
+
+		if(res)
+			mgd_release(res);
+	}
+
+	return TRUE;
+}
+
+/* Marks repligard records of table's records deleted, and deletes records */
+static gboolean __delete_records(MgdTreeDelete *del, const gchar *table, GArray *ids)
+{
+	if(ids->len == 0)
+		return TRUE;
+
+	if(!g_slist_find_custom(del->tables, table, (GCompareFunc) strcmp))
+		del->tables = g_slist_prepend(del->tables, g_strdup(table));
+
+	/* The same as DELETE_REPLIGARD, which ignores multilang content */
+	if(!g_str_has_suffix(table, "_i")) {
+
+		gchar *prefix = g_strdup_printf("UPDATE repligard AS r JOIN %s AS t "
+				"ON r.guid=t.guid AND r.realm='%s' "
+				"SET r.updated=0, r.action='delete' WHERE t.id IN ",
+				table, table);
+		gchar *suffix = g_strdup_printf(" AND %s", del->sgcond_t);
+		gboolean rv = __tree_exec_in(del->mgd, prefix, ids, suffix);
+		g_free(prefix);
+		g_free(suffix);
+
+		if(!rv)
+			return FALSE;
+	}
+
+	gchar *prefix = g_strdup_printf("DELETE FROM %s WHERE id IN ", table);
+	gchar *suffix = g_strdup_printf(" AND %s", del->sgcond);
+	gboolean rv = __tree_exec_in(del->mgd, prefix, ids, suffix);
+	g_free(prefix);
+	g_free(suffix);
+
+	return rv;
+}
+
+/* Deletes parameters of table's records */
+static gboolean __delete_parameters(MgdTreeDelete *del, const gchar *table, GArray *ids)
+{
+	GArray *params = g_array_new(FALSE, FALSE, sizeof(gint));
+	gchar *where = g_strdup_printf("tablename='%s'", table);
+
+	gboolean rv = __delete_collect(del, "record_extension", "oid", ids, where, params, NULL)
+		&& __delete_records(del, "record_extension", params);
+
+	g_free(where);
+	g_array_free(params, TRUE);
+
+	return rv;
+}
+
+#if HAVE_MIDGARD_MULTILANG
+/* Deletes multilang content of table's records */
+static gboolean __delete_content(MgdTreeDelete *del, const gchar *table, GArray *ids)
+{
+	/* Tables with content, the same as in __copy_content */
+	static const gchar *content_tables[] = {
+		"article", "element", "page", "pageelement", NULL
+	};
+	guint i;
+
+	for(i = 0; content_tables[i] != NULL; i++) {
+		if(g_str_equal(table, content_tables[i]))
+			break;
+	}
+
+	if(content_tables[i] == NULL || ids->len == 0)
+		return TRUE;
+
+	gchar *table_i = g_strconcat(table, "_i", NULL);
+	gchar *prefix = g_strdup_printf("DELETE FROM %s WHERE sid IN ", table_i);
+	gboolean rv = __tree_exec_in(del->mgd, prefix, ids, "");
+
+	g_free(prefix);
+	g_free(table_i);
+
+	return rv;
+}
+#endif /* HAVE_MIDGARD_MULTILANG */
+
+/* Deletes attachments of table's records with their parameters,
+ * and remembers their files */
+static gboolean __delete_attachments(MgdTreeDelete *del, const gchar *table, GArray *ids)
+{
+	GArray *blobs = g_array_new(FALSE, FALSE, sizeof(gint));
+	GPtrArray *locations = g_ptr_array_new();
+	gchar *where = g_strdup_printf("ptable='%s'", table);
+	guint i;
+
+	gboolean rv = __delete_collect(del, "blobs", "pid", ids, where, blobs, locations)
+		&& __delete_parameters(del, "blobs", blobs)
+		&& __delete_records(del, "blobs", blobs);
+
+	for(i = 0; i < locations->len; i++) {
+
+		gchar *location = g_ptr_array_index(locations, i);
+
+		if(rv)
+			g_ptr_array_add(del->files, g_strdup_printf("%s/%s",
+						mgd_get_blobdir(del->mgd), location));
+		g_free(location);
+	}
+
+	g_free(where);
+	g_ptr_array_free(locations, TRUE);
+	g_array_free(blobs, TRUE);
+
+	return rv;
+}
+
+/* Deletes table's records, with everything linked to them */
+static gboolean __delete_dependants(MgdTreeDelete *del, const gchar *table, GArray *ids)
+{
+	if(!__delete_attachments(del, table, ids)
+			|| !__delete_parameters(del, table, ids))
+		return FALSE;
+#if HAVE_MIDGARD_MULTILANG
+	if(!__delete_content(del, table, ids))
+		return FALSE;
+#endif /* HAVE_MIDGARD_MULTILANG */
+
+	return __delete_records(del, table, ids);
+}
+
+/* Deletes tree of table with children records, and their dependants.
+ * Returns 1 on success, 0 otherwise. */
+static int __delete_subtree(midgard *mgd, const gchar *table, int root,
+		const gchar *child, const gchar *parentfield)
+{
+	MgdTreeDelete del = { mgd, NULL, NULL, NULL, NULL };
+	GArray *nodes, *children;
+	GSList *l;
+	guint i;
+	int *tree;
+
+	tree = mgd_tree(mgd, table, "up", root, 0, NULL);
+
+	if(tree == NULL)
+		return 0;
+
+	nodes = g_array_new(FALSE, FALSE, sizeof(gint));
+	children = g_array_new(FALSE, FALSE, sizeof(gint));
+
+	for(i = 0; tree[i] != 0; i++)
+		g_array_append_val(nodes, tree[i]);
+	free(tree);
+
+	/* Records of 0 sitegroup are not deleted by mgd_delete, so neither
+	 * their children nor repligard records and files are touched */
+	if(mgd_isroot(mgd)) {
+		del.sgcond = g_strdup("1=1");
+		del.sgcond_t = g_strdup("1=1");
+	} else {
+		del.sgcond = g_strdup_printf("metadata_deleted = FALSE AND sitegroup = %d",
+				mgd_sitegroup(mgd));
+		del.sgcond_t = g_strdup_printf("t.metadata_deleted = FALSE AND t.sitegroup = %d",
+				mgd_sitegroup(mgd));
+	}
+	del.files = g_ptr_array_new();
+
+	gboolean rv = __tree_exec(mgd, "START TRANSACTION");
+
+	if(rv && child != NULL) {
+		rv = __delete_collect(&del, child, parentfield, nodes, NULL, children, NULL)
+			&& __delete_dependants(&del, child, children);
+	}
+
+	/* Tree includes nodes which are not deleted (0 sitegroup ones),
+	 * nothing linked to them is touched */
+	GArray *deleted = g_array_new(FALSE, FALSE, sizeof(gint));
+
+	if(rv)
+		rv = __delete_collect(&del, table, "id", nodes, NULL, deleted, NULL);
+
+#if HAVE_MIDGARD_PAGELINKS
+	if(rv && g_str_equal(table, "page"))
+		rv = __tree_exec_in(mgd, "DELETE FROM pagelink WHERE up IN ", deleted, "");
+#endif
+
+	if(rv)
+		rv = __delete_dependants(&del, table, deleted);
+
+	g_array_free(deleted, TRUE);
+
+	if(rv)
+		rv = __tree_exec(mgd, "COMMIT");
+	else
+		__tree_exec(mgd, "ROLLBACK");
+
+	/* Files are unlinked only when records are gone for sure */
+	for(i = 0; i < del.files->len; i++) {
+
+		const gchar *path = g_ptr_array_index(del.files, i);
+
+		if(rv && unlink(path) != 0 && errno != ENOENT)
+			g_warning("Can not unlink blob file %s: %s", path, g_strerror(errno));
+
+		g_free((gchar *) path);
+	}
+
+	for(l = del.tables; l != NULL; l = l->next) {
+
+		_midgard_core_pagecache_class_changed(__tree_typename((const gchar *) l->data));
+		_midgard_core_acl_class_changed(__tree_typename((const gchar *) l->data));
+		g_free(l->data);
+	}
+
+	g_slist_free(del.tables);
+	g_ptr_array_free(del.files, TRUE);
+	g_free(del.sgcond);
+	g_free(del.sgcond_t);
+	g_array_free(nodes, TRUE);
+	g_array_free(children, TRUE);
+
+	return rv ? 1 : 0;
+}
+
 static int article_deleter(midgard * mgd, int id, int level, void *xparam)
 {
 	int *retcode=xparam;
@@ -902,6 +1957,10 @@ int mgd_delete_article(midgard * mgd, int root)
 int mgd_delete_topic(midgard * mgd, int root)
 {
 	int retcode=1;
+
+	if(__tree_is_bulk(mgd))
+		return __delete_subtree(mgd, "topic", root, "article", "topic");
+
 	mgd_walk_table_tree(mgd, "topic", "up", root, 0, 1, &retcode,
 										topic_deleter, NULL);
 	return retcode;
@@ -956,6 +2015,10 @@ static int page_deleter(midgard * mgd, int id, int level, void *xparam)
 int mgd_delete_page(midgard * mgd, int root)
 {
 	int retcode=1;
+
+	if(__tree_is_bulk(mgd))
+		return __delete_subtree(mgd, "page", root, "pageelement", "page");
+
 	mgd_walk_table_tree(mgd, "page", "up", root, 0, 1, &retcode,
 										page_deleter, NULL);
 	return retcode;
@@ -1075,6 +2138,10 @@ static int style_deleter(midgard * mgd, int id, int level, void *xparam)
 int mgd_delete_style(midgard * mgd, int root)
 {
 	int retcode=1;
+
+	if(__tree_is_bulk(mgd))
+		return __delete_subtree(mgd, "style", root, "element", "style");
+
 	mgd_walk_table_tree(mgd, "style", "up", root, 0, 1, &retcode,
 										style_deleter, NULL);
 	return retcode;
@@ -1086,6 +2153,190 @@ int mgd_move_object(midgard * mgd, const char *table, const char *upfield,
 	return mgd_update(mgd, table, id, "$s=$i", upfield, newup);
 }
 
+/* Loads id, upfield of all table's records visible in current sitegroup.
+ * Returns NULL on failure. */
+static GHashTable *__move_load_tree(midgard *mgd, const char *table, const char *upfield)
+{
+	midgard_res *res = mgd_query(mgd,
+			"SELECT id,$s FROM $s WHERE (sitegroup IN (0,$d) OR $d<>0)",
+			upfield, table, mgd_sitegroup(mgd), mgd_isroot(mgd));
+
+	if(res == NULL && mysql_errno(mgd->msql->mysql) != 0)
+		return NULL;
+
+	GHashTable *tree = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	while(res && mgd_fetch(res))
+		g_hash_table_insert(tree, GINT_TO_POINTER(mgd_sql2int(res, 0)),
+				GINT_TO_POINTER(mgd_sql2int(res, 1)));
+
+	if(res)
+		mgd_release(res);
+
+	return tree;
+}
+
+/* Checks that none of moved records is its own ancestor.
+ * Every record is visited once, records known to reach top level are
+ * remembered in reachable set. */
+static gboolean __move_is_circular(GHashTable *tree, const int *ids, int n)
+{
+	GHashTable *reachable = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GHashTable *path = g_hash_table_new(g_direct_hash, g_direct_equal);
+	gboolean circular = FALSE;
+	int i;
+
+	for(i = 0; i < n && !circular; i++) {
+
+		gint id = ids[i];
+
+		while(id != 0 && !g_hash_table_lookup(reachable, GINT_TO_POINTER(id))) {
+
+			if(g_hash_table_lookup(path, GINT_TO_POINTER(id))) {
+				circular = TRUE;
+				break;
+			}
+
+			g_hash_table_insert(path, GINT_TO_POINTER(id), GINT_TO_POINTER(TRUE));
+			id = GPOINTER_TO_INT(g_hash_table_lookup(tree, GINT_TO_POINTER(id)));
+		}
+
+		/* Whole path reaches top level */
+		if(!circular) {
+
+			GHashTableIter iter;
+			gpointer key;
+
+			g_hash_table_iter_init(&iter, path);
+			while(g_hash_table_iter_next(&iter, &key, NULL))
+				g_hash_table_insert(reachable, key, GINT_TO_POINTER(TRUE));
+		}
+
+		g_hash_table_remove_all(path);
+	}
+
+	g_hash_table_destroy(path);
+	g_hash_table_destroy(reachable);
+
+	return circular;
+}
+
+int mgd_move_objects(midgard * mgd, const char *table, const char *upfield,
+		const int *ids, const int *newups, int n)
+{
+	g_assert(mgd != NULL);
+	g_return_val_if_fail(table != NULL, -1);
+	g_return_val_if_fail(n == 0 || (ids != NULL && newups != NULL), -1);
+
+	int i;
+
+	if(n <= 0)
+		return 0;
+
+	if(!upfield || !(*upfield))
+		upfield = "up";
+
+	GHashTable *tree = __move_load_tree(mgd, table, upfield);
+
+	if(tree == NULL)
+		return -1;
+
+	/* Apply moves in memory, and validate the resulting tree */
+	for(i = 0; i < n; i++) {
+
+		if(!g_hash_table_lookup_extended(tree, GINT_TO_POINTER(ids[i]), NULL, NULL)
+				|| (newups[i] != 0 && !g_hash_table_lookup_extended(tree,
+						GINT_TO_POINTER(newups[i]), NULL, NULL))) {
+
+			g_hash_table_destroy(tree);
+			if(mgd->_mgd) {
+				MIDGARD_ERRNO_SET(mgd, MGD_ERR_NOT_EXISTS);
+			}
+			return -1;
+		}
+
+		g_hash_table_insert(tree, GINT_TO_POINTER(ids[i]), GINT_TO_POINTER(newups[i]));
+	}
+
+	gboolean circular = __move_is_circular(tree, ids, n);
+	g_hash_table_destroy(tree);
+
+	if(circular) {
+
+		if(mgd->_mgd) {
+			MIDGARD_ERRNO_SET(mgd, MGD_ERR_TREE_IS_CIRCULAR);
+		}
+		return -1;
+	}
+
+	if(!__tree_is_bulk(mgd)) {
+
+		for(i = 0; i < n; i++) {
+			if(!mgd_move_object(mgd, table, upfield, ids[i], newups[i]))
+				return i;
+		}
+
+		return n;
+	}
+
+	/* Apply moves with one CASE update and one repligard update per batch.
+	 * The last move of the same record wins, as it does in memory. */
+	GValue tval = {0, };
+	g_value_init(&tval, MIDGARD_TYPE_TIMESTAMP);
+	midgard_timestamp_set_time(&tval, time(NULL));
+	gchar *now = midgard_timestamp_dup_string(&tval);
+	g_value_unset(&tval);
+
+	GArray *moved = g_array_new(FALSE, FALSE, sizeof(gint));
+	gboolean rv = __tree_exec(mgd, "START TRANSACTION");
+
+	for(i = 0; rv && i < n; i += MGD_TREE_BATCH) {
+
+		int j, last = MIN(n, i + MGD_TREE_BATCH);
+		GString *sql = g_string_new("");
+
+		g_array_set_size(moved, 0);
+		g_string_printf(sql, "UPDATE %s SET metadata_revised='%s', `%s`=CASE id",
+				table, now, upfield);
+
+		/* CASE takes the first match, so later moves go first */
+		for(j = last - 1; j >= i; j--) {
+			g_string_append_printf(sql, " WHEN %d THEN %d", ids[j], newups[j]);
+			g_array_append_val(moved, ids[j]);
+		}
+
+		g_string_append_printf(sql, " ELSE `%s` END WHERE (sitegroup = %d OR %d<>0) AND id IN ",
+				upfield, mgd_sitegroup(mgd), mgd_isroot(mgd));
+
+		rv = __tree_exec_in(mgd, sql->str, moved, "");
+		g_string_free(sql, TRUE);
+
+		if(!rv)
+			break;
+
+		/* The same as UPDATE_REPLIGARD */
+		gchar *prefix = g_strdup_printf("UPDATE repligard AS r JOIN %s AS t "
+				"ON r.guid=t.guid AND r.realm='%s' "
+				"SET r.changed=NULL, r.action='update' WHERE t.id IN ",
+				table, table);
+		rv = __tree_exec_in(mgd, prefix, moved, "");
+		g_free(prefix);
+	}
+
+	if(rv)
+		rv = __tree_exec(mgd, "COMMIT");
+	else
+		__tree_exec(mgd, "ROLLBACK");
+
+	g_array_free(moved, TRUE);
+	g_free(now);
+
+	_midgard_core_pagecache_class_changed(__tree_typename(table));
+	_midgard_core_acl_class_changed(__tree_typename(table));
+
+	return rv ? n : -1;
+}
+
 /* mgd_parse_path
     Scans records in a tables 'table' and 'uptable' and returns IDs of
     an object queried in path and its uplink.
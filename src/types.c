@@ -39,6 +39,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "midgard/midgard_dbus.h"
 #include "midgard_core_query.h"
 #include "midgard_core_query_builder.h"
+#include "midgard_core_pagecache.h"
+#include "midgard_core_acl.h"
 
 GType _midgard_attachment_type = 0;
 static gboolean signals_registered = FALSE;
@@ -152,6 +154,10 @@ _object_instance_init(GTypeInstance *instance, gpointer g_class)
     self->private->imported = NULL;
     self->private->read_only = FALSE;
     self->private->_mysql_row = NULL;
+    self->private->projection = NULL;
+    self->private->projection_lang = -1;
+    self->private->projection_unset_lang = FALSE;
+    self->private->projection_mgd_lang = 0;
     
     /* Initialize metadata object */
     self->metadata = (MidgardMetadata *) g_object_new(MIDGARD_TYPE_METADATA, NULL);
@@ -270,6 +276,11 @@ _object_set_property (GObject *object, guint prop_id,
 			break;
 			
 		default:
+			/* Load not selected properties first, so they won't overwrite this one later */
+			if (self->private->projection 
+					&& !g_hash_table_lookup(self->private->projection, pspec->name))
+				_midgard_core_qb_load_projected(self);
+
 			G_MIDGARD_LOOP_HIERARCHY_START
 				prop_id_local = prop_id - priv->base_index - 1;
 			if ((prop_id_local >= 0) && (prop_id_local < priv->num_properties)) {
@@ -287,6 +298,35 @@ _object_set_property (GObject *object, guint prop_id,
 	}
 }
 
+/* Returns storage of property's value, initialized to property's type.
+ * Fetched objects are filled directly, without GValue copies. 
+ * NULL is returned for guid, sitegroup and metadata. */
+GValue *_midgard_core_object_get_property_value(MgdObject *self, GParamSpec *pspec)
+{
+	g_assert(self != NULL);
+	g_assert(pspec != NULL);
+
+	gint prop_id_local = 0;
+	MgdSchemaTypeAttr *priv;
+	GObject *object = G_OBJECT(self);
+	GType current_type = G_TYPE_FROM_INSTANCE(object);
+
+	if (pspec->param_id <= MIDGARD_PROPERTY_METADATA || self->private->read_only)
+		return NULL;
+
+	G_MIDGARD_LOOP_HIERARCHY_START
+		prop_id_local = pspec->param_id - priv->base_index - 1;
+	if ((prop_id_local >= 0) && (prop_id_local < priv->num_properties)) {
+		GValue *value = &priv->properties[prop_id_local]->value;
+		if (!G_IS_VALUE(value))
+			g_value_init(value, pspec->value_type);
+		return value;
+	}
+	G_MIDGARD_LOOP_HIERARCHY_STOP
+
+	return NULL;
+}
+
 static gboolean __set_property_from_mysql_row(MgdObject *self, GValue *value, GParamSpec *pspec)
 {
 	if (!self->private->read_only)
@@ -372,6 +412,9 @@ _object_get_property (GObject *object, guint prop_id,
 			break;
 		
 		default:
+			if (self->private->projection 
+					&& !g_hash_table_lookup(self->private->projection, pspec->name))
+				_midgard_core_qb_load_projected(self);
 			if (__set_property_from_mysql_row(self, value, pspec))
 				return;
 			G_MIDGARD_LOOP_HIERARCHY_START
@@ -415,6 +458,10 @@ static void _object_finalize (GObject *object)
 	g_free((gchar *)self->private->action);
 	g_free(self->private->exported);
 	g_free(self->private->imported);
+
+	if (self->private->projection)
+		g_hash_table_unref(self->private->projection);
+	self->private->projection = NULL;
 	
 	/* Free object's parameters */
 	if(self->private->parameters != NULL) {
@@ -1358,6 +1405,9 @@ gboolean _midgard_object_update(MgdObject *gobj,
 	g_hash_table_destroy(sqls);   
 	MIDGARD_ERRNO_SET(gobj->mgd, MGD_ERR_OK);
 
+	_midgard_core_pagecache_class_changed(G_OBJECT_TYPE_NAME(gobj));
+	_midgard_core_acl_class_changed(G_OBJECT_TYPE_NAME(gobj));
+
 	/* Success, emit done signals */
 	switch(replicate){
 		
@@ -1580,6 +1630,11 @@ gboolean _midgard_object_create(	MgdObject *object,
 		/* Create repligard and other tables entries */
 		if ((rid = mysql_insert_id(object->mgd->msql->mysql))){
 			g_object_set(G_OBJECT(object), "id", rid, NULL); /* FIXME */		
+			/* Record has been created with object's size */
+			if(replicate != OBJECT_UPDATE_EXPORTED) {
+				object->metadata->private->stored_size = object_size;
+				object->metadata->private->stored_size_is_set = TRUE;
+			}
 			midgard_quota_update(object);		
 			
 			if (MGD_CNC_REPLICATION (mgd)) {
@@ -1620,6 +1675,9 @@ gboolean _midgard_object_create(	MgdObject *object,
 			g_log(G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,"Object %s created with id=%d", 
 					G_OBJECT_TYPE_NAME(object), rid);
 
+			_midgard_core_pagecache_class_changed(G_OBJECT_TYPE_NAME(object));
+			_midgard_core_acl_class_changed(G_OBJECT_TYPE_NAME(object));
+
 			/* Emit done signals */
 			switch(replicate){
 				
@@ -2828,6 +2886,8 @@ gboolean midgard_object_delete(MgdObject *object)
 				g_free(keys);
 				g_object_unref (mc);
 
+				_midgard_core_pagecache_class_changed(G_OBJECT_TYPE_NAME(object));
+				_midgard_core_acl_class_changed(G_OBJECT_TYPE_NAME(object));
 				g_signal_emit(object, MIDGARD_OBJECT_GET_CLASS(object)->signal_action_deleted, 0);
 				return TRUE;
 			}
@@ -2918,6 +2978,9 @@ gboolean midgard_object_delete(MgdObject *object)
 	object->metadata->private->revisor = g_strdup(person_guid);
 	object->metadata->private->deleted = TRUE;
 
+	_midgard_core_pagecache_class_changed(G_OBJECT_TYPE_NAME(object));
+	_midgard_core_acl_class_changed(G_OBJECT_TYPE_NAME(object));
+
 	g_signal_emit(object, MIDGARD_OBJECT_GET_CLASS(object)->signal_action_deleted, 0);
 
 	__dbus_send(object, "delete");
@@ -3041,6 +3104,8 @@ gboolean midgard_object_purge(MgdObject *object)
 	}
 	
 	midgard_quota_remove(object, size);
+	_midgard_core_pagecache_class_changed(G_OBJECT_TYPE_NAME(object));
+	_midgard_core_acl_class_changed(G_OBJECT_TYPE_NAME(object));
 
 	GValue tval = {0, };
 	time_t utctime = time(NULL);
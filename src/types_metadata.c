@@ -408,6 +408,8 @@ _metadata_instance_init(GTypeInstance *instance, gpointer g_class)
 	self->private->hidden = FALSE;
 	self->private->nav_noentry = FALSE;
 	self->private->size = 0;
+	self->private->stored_size = 0;
+	self->private->stored_size_is_set = FALSE;
 	self->private->published = NULL;
 	self->private->score = 0;
 	self->private->exported = NULL;
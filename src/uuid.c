@@ -17,8 +17,10 @@
  */
 #include <config.h>
 #include "midgard/uuid.h"
-#include "md5.h"
+#include "midgard_core_hash.h"
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
 
 gboolean midgard_is_uuid(const gchar *uuid) {
         g_assert(uuid != NULL);
@@ -40,58 +42,119 @@ gboolean midgard_is_uuid(const gchar *uuid) {
  * \internal
  * \ingroup uuid
  *
- * The thread synchronization lock used to guarantee UUID uniqueness
- * for all the threads running within a process.
+ * The number of 100ns intervals between the UUID epoch (1582-10-15)
+ * and the Unix epoch.
  */
-G_LOCK_DEFINE_STATIC(uuid);
+#define UUID_EPOCH G_GINT64_CONSTANT(0x01B21DD213814000U)
 
-gchar *midgard_uuid_new(void) {
-        static gboolean initialized = FALSE;
-        static guint64 timestamp;
-        static guint32 advance;
-        static guint16 clockseq;
-        static guint16 node_high;
-        static guint32 node_low;
-        guint64 time;
-        guint16 nowseq;
-        GTimeVal tv;
+/**
+ * \internal
+ * \ingroup uuid
+ *
+ * The per-process node identifier and random clock sequence.
+ * Initialized once, and again in forked child, so the child does
+ * not repeat UUIDs of its parent.
+ */
+typedef struct {
+        guint16 node_high;
+        guint32 node_low;
+        guint16 clockseq;
+} MgdUuidNode;
 
-        G_LOCK(uuid);
+static MgdUuidNode uuid_node;
+
+static void uuid_node_init(void) {
+        GRand *rand = g_rand_new();
+        guint32 r = g_rand_int(rand);
+        uuid_node.clockseq = r >> 16;
+        uuid_node.node_high = r | 0x0100;
+        uuid_node.node_low = g_rand_int(rand);
+        g_rand_free(rand);
+}
+
+static void uuid_atfork_child(void) {
+        uuid_node_init();
+}
+
+static const MgdUuidNode *uuid_node_get(void) {
+        static gsize initialized = 0;
+        if (g_once_init_enter(&initialized)) {
+                uuid_node_init();
+                pthread_atfork(NULL, NULL, uuid_atfork_child);
+                g_once_init_leave(&initialized, 1);
+        }
+        return &uuid_node;
+}
+
+static guint64 uuid_time(void) {
+#ifdef HAVE_CLOCK_GETTIME
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return ((guint64) ts.tv_sec) * 10000000 + ts.tv_nsec / 100 + UUID_EPOCH;
+#else
+        GTimeVal tv;
         g_get_current_time(&tv);
-        time = ((guint64) tv.tv_sec) * G_USEC_PER_SEC + ((guint64) tv.tv_usec);
-        time = time * 10 + G_GINT64_CONSTANT(0x01B21DD213814000U);
-        if (!initialized) {
-                timestamp = time;
-                advance = 0;
-                GRand *rand = g_rand_new();
-                guint32 r = g_rand_int(rand);
-                clockseq = r >> 16;
-                node_high = r | 0x0100;
-                node_low = g_rand_int(rand);
-                g_rand_free(rand);
-                initialized = TRUE;
-        } else if (time < timestamp) {
-                timestamp = time;
-                advance = 0;
-                clockseq++;
-        } else if (time == timestamp) {
-                advance++;
-                time += advance;
-        } else {
-                timestamp = time;
-                advance = 0;
+        return (((guint64) tv.tv_sec) * G_USEC_PER_SEC + tv.tv_usec) * 10 + UUID_EPOCH;
+#endif
+}
+
+/**
+ * \internal
+ * \ingroup uuid
+ *
+ * The last timestamp used by any thread. Every thread shares the node
+ * and the clock sequence, so timestamps are kept unique with compare
+ * and swap instead of a lock. Per-thread clock sequences would repeat
+ * after 16384 threads, as only 14 bits of them are used.
+ */
+static volatile guint64 uuid_last = 0;
+
+static guint16 uuid_clockseq(const MgdUuidNode *node, guint64 *time) {
+        guint64 now = *time;
+        guint64 last;
+        /* Monotonic, even if clock goes back or many UUIDs
+         * are generated within clock's resolution */
+        do {
+                last = uuid_last;
+                *time = now > last ? now : last + 1;
+        } while (!__sync_bool_compare_and_swap(&uuid_last, last, *time));
+        return node->clockseq;
+}
+
+static inline gchar *uuid_hex(gchar *p, guint64 value, gint digits) {
+        static const gchar hex[] = "0123456789abcdef";
+        gint i;
+        for (i = digits - 1; i >= 0; i--) {
+                p[i] = hex[value & 0xf];
+                value >>= 4;
         }
-        nowseq = clockseq;
-        G_UNLOCK(uuid);
+        return p + digits;
+}
 
-        return g_strdup_printf(
-                "%08lx-%04x-%04x-%04x-%04x%08lx",
-                (unsigned long) time,
-                (unsigned int) (time >> 32) & 0xffff,
-                (unsigned int) ((time >> 48) & 0x0ffff) | 0x1000,
-                (unsigned int) (nowseq & 0x3fff) | 0x8000,
-                (unsigned int) node_high,
-                (unsigned long) node_low);
+void midgard_uuid_generate(gchar *uuid) {
+        g_assert(uuid != NULL);
+        const MgdUuidNode *node = uuid_node_get();
+        guint64 time = uuid_time();
+        guint16 clockseq = uuid_clockseq(node, &time);
+
+        gchar *p = uuid;
+        p = uuid_hex(p, time & 0xffffffff, 8);
+        *p++ = '-';
+        p = uuid_hex(p, (time >> 32) & 0xffff, 4);
+        *p++ = '-';
+        p = uuid_hex(p, ((time >> 48) & 0x0fff) | 0x1000, 4);
+        *p++ = '-';
+        p = uuid_hex(p, (clockseq & 0x3fff) | 0x8000, 4);
+        *p++ = '-';
+        p = uuid_hex(p, node->node_high, 4);
+        p = uuid_hex(p, node->node_low, 8);
+        *p = '\0';
+}
+
+gchar *midgard_uuid_new(void) {
+        gchar *uuid = g_malloc(MIDGARD_UUID_BUFFER_SIZE);
+        midgard_uuid_generate(uuid);
+        return uuid;
 }
 
 /**
@@ -110,11 +173,11 @@ gchar *midgard_uuid_external(const gchar *external) {
         g_assert(external != NULL);
         unsigned char uuid[16];
 
-        _MGD_MD5_CTX md5;
-        _MGD_MD5Init(&md5);
-        _MGD_MD5Update(&md5, namespace_uuid, sizeof(namespace_uuid));
-        _MGD_MD5Update(&md5, (unsigned char *) external, strlen(external));
-        _MGD_MD5Final(uuid, &md5);
+        MgdHash md5;
+        _midgard_core_hash_init(&md5, MGD_HASH_MD5);
+        _midgard_core_hash_update(&md5, namespace_uuid, sizeof(namespace_uuid));
+        _midgard_core_hash_update(&md5, (const guchar *) external, strlen(external));
+        _midgard_core_hash_final(&md5, uuid);
 
         return g_strdup_printf(
                 "%08lx-%04x-%04x-%04x-%04x%08lx",
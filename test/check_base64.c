@@ -0,0 +1,162 @@
+/* 
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <string.h>
+#include "check_base64.h"
+#include "midgard_core_base64.h"
+
+static const MgdBase64Impl impls[] = {
+        MGD_BASE64_SCALAR, MGD_BASE64_SSSE3, MGD_BASE64_AVX2
+};
+
+START_TEST(test_base64_vectors)
+{
+        gchar *encoded = _midgard_core_base64_encode((const guchar *) "", 0);
+        fail_unless(g_str_equal(encoded, ""), "encode('') = %s", encoded);
+        g_free(encoded);
+
+        encoded = _midgard_core_base64_encode((const guchar *) "f", 1);
+        fail_unless(g_str_equal(encoded, "Zg=="), "encode('f') = %s", encoded);
+        g_free(encoded);
+
+        encoded = _midgard_core_base64_encode((const guchar *) "fo", 2);
+        fail_unless(g_str_equal(encoded, "Zm8="), "encode('fo') = %s", encoded);
+        g_free(encoded);
+
+        encoded = _midgard_core_base64_encode((const guchar *) "foobar", 6);
+        fail_unless(g_str_equal(encoded, "Zm9vYmFy"), "encode('foobar') = %s", encoded);
+        g_free(encoded);
+
+        gsize len = 0;
+        guchar *decoded = _midgard_core_base64_decode("Zm9v\nYmE=", 9, &len);
+        fail_unless(len == 5 && memcmp(decoded, "fooba", 5) == 0, NULL);
+        g_free(decoded);
+}
+END_TEST
+
+/* Every implementation gives the same result as glib for lengths
+ * around vector block sizes, and for text broken into lines */
+START_TEST(test_base64_impls)
+{
+        GRand *rand = g_rand_new_with_seed(0);
+        guchar data[1024];
+        guint i, len;
+
+        for(i = 0; i < sizeof(data); i++)
+                data[i] = g_rand_int_range(rand, 0, 256);
+
+        g_rand_free(rand);
+
+        for(i = 0; i < G_N_ELEMENTS(impls); i++) {
+
+                if(!_midgard_core_base64_set_impl(impls[i]))
+                        continue;
+
+                for(len = 0; len < sizeof(data); len += (len < 100 ? 1 : 37)) {
+
+                        gchar *expected = g_base64_encode(data, len);
+                        gchar *encoded = _midgard_core_base64_encode(data, len);
+                        fail_unless(g_str_equal(encoded, expected),
+                                        "impl %d, length %d", impls[i], len);
+
+                        gsize declen = 0;
+                        guchar *decoded = _midgard_core_base64_decode(encoded, strlen(encoded), &declen);
+                        fail_unless(declen == len && memcmp(decoded, data, len) == 0,
+                                        "impl %d, length %d", impls[i], len);
+                        g_free(decoded);
+
+                        gchar **lines = g_strsplit(encoded, "A", -1);
+                        gchar *broken = g_strjoinv("A\n", lines);
+                        decoded = _midgard_core_base64_decode(broken, strlen(broken), &declen);
+                        fail_unless(declen == len && memcmp(decoded, data, len) == 0,
+                                        "impl %d, length %d, broken lines", impls[i], len);
+                        g_free(decoded);
+                        g_free(broken);
+                        g_strfreev(lines);
+
+                        g_free(encoded);
+                        g_free(expected);
+                }
+        }
+
+        _midgard_core_base64_set_impl(MGD_BASE64_AUTO);
+}
+END_TEST
+
+/* Text split at every offset decodes the same as glib's whole text,
+ * also when padding of the last quad is split */
+START_TEST(test_base64_steps)
+{
+        guchar data[80];
+        guchar out[80];
+        guint i, j, len, offset;
+
+        for(i = 0; i < sizeof(data); i++)
+                data[i] = i * 7 + 3;
+
+        for(i = 0; i < G_N_ELEMENTS(impls); i++) {
+
+                if(!_midgard_core_base64_set_impl(impls[i]))
+                        continue;
+
+                for(len = 0; len < sizeof(data); len++) {
+
+                        gchar *encoded = g_base64_encode(data, len);
+                        gsize enclen = strlen(encoded);
+
+                        for(offset = 0; offset <= enclen; offset++) {
+
+                                gint state = 0;
+                                guint save = 0;
+                                gsize outlen;
+
+                                outlen = _midgard_core_base64_decode_step(encoded,
+                                                offset, out, &state, &save);
+                                outlen += _midgard_core_base64_decode_step(encoded + offset,
+                                                enclen - offset, out + outlen, &state, &save);
+
+                                fail_unless(outlen == len && memcmp(out, data, len) == 0,
+                                                "impl %d, length %d, split at %d", impls[i], len, offset);
+                        }
+
+                        /* Byte by byte */
+                        gint state = 0;
+                        guint save = 0;
+                        gsize outlen = 0;
+
+                        for(j = 0; j < enclen; j++)
+                                outlen += _midgard_core_base64_decode_step(encoded + j, 1,
+                                                out + outlen, &state, &save);
+
+                        fail_unless(outlen == len && memcmp(out, data, len) == 0,
+                                        "impl %d, length %d, byte steps", impls[i], len);
+
+                        g_free(encoded);
+                }
+        }
+
+        _midgard_core_base64_set_impl(MGD_BASE64_AUTO);
+}
+END_TEST
+
+TCase *midgard_base64_test_case(void) {
+        TCase *test_case = tcase_create("Base64");
+        tcase_add_test(test_case, test_base64_vectors);
+        tcase_add_test(test_case, test_base64_impls);
+        tcase_add_test(test_case, test_base64_steps);
+        return test_case;
+}
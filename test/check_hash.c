@@ -0,0 +1,92 @@
+/* 
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <string.h>
+#include "check_hash.h"
+#include "midgard_core_hash.h"
+
+#define QUICK_FOX "The quick brown fox jumps over the lazy dog"
+
+START_TEST(test_hash_vectors)
+{
+        gchar *hex = _midgard_core_hash_hex(MGD_HASH_MD5, (const guchar *) "", 0);
+        fail_unless(g_str_equal(hex, "d41d8cd98f00b204e9800998ecf8427e"), "md5('') = %s", hex);
+        g_free(hex);
+
+        hex = _midgard_core_hash_hex(MGD_HASH_MD5, (const guchar *) QUICK_FOX, strlen(QUICK_FOX));
+        fail_unless(g_str_equal(hex, "9e107d9d372bb6826bd81d3542a419d6"), "md5(fox) = %s", hex);
+        g_free(hex);
+
+        hex = _midgard_core_hash_hex(MGD_HASH_XXH64, (const guchar *) "", 0);
+        fail_unless(g_str_equal(hex, "ef46db3751d8e999"), "xxh64('') = %s", hex);
+        g_free(hex);
+
+        hex = _midgard_core_hash_hex(MGD_HASH_XXH64, (const guchar *) "abc", 3);
+        fail_unless(g_str_equal(hex, "44bc2cf5ad770999"), "xxh64('abc') = %s", hex);
+        g_free(hex);
+
+        fail_unless(_midgard_core_hash_xxh64((const guchar *) "abc", 3, 0)
+                        == G_GUINT64_CONSTANT(0x44bc2cf5ad770999), NULL);
+}
+END_TEST
+
+/* Data hashed in pieces gives the same digest as data hashed at once */
+START_TEST(test_hash_update)
+{
+        const MgdHashType types[] = { MGD_HASH_MD5, MGD_HASH_XXH64 };
+        GRand *rand = g_rand_new_with_seed(0);
+        guchar data[1024];
+        guint i, len, pos;
+
+        for(i = 0; i < sizeof(data); i++)
+                data[i] = g_rand_int_range(rand, 0, 256);
+
+        for(i = 0; i < G_N_ELEMENTS(types); i++) {
+
+                for(len = 0; len < sizeof(data); len += (len < 100 ? 1 : 37)) {
+
+                        guchar expected[MGD_HASH_MAX_LENGTH];
+                        guchar digest[MGD_HASH_MAX_LENGTH];
+                        gsize dlen = _midgard_core_hash_digest(types[i], data, len, expected);
+                        MgdHash hash;
+
+                        fail_unless(dlen == _midgard_core_hash_length(types[i]), NULL);
+
+                        _midgard_core_hash_init(&hash, types[i]);
+
+                        for(pos = 0; pos < len; ) {
+                                guint part = MIN(len - pos, (guint) g_rand_int_range(rand, 0, 70));
+                                _midgard_core_hash_update(&hash, data + pos, part);
+                                pos += part;
+                        }
+
+                        fail_unless(_midgard_core_hash_final(&hash, digest) == dlen, NULL);
+                        fail_unless(memcmp(digest, expected, dlen) == 0,
+                                        "type %d, length %d", types[i], len);
+                }
+        }
+
+        g_rand_free(rand);
+}
+END_TEST
+
+TCase *midgard_hash_test_case(void) {
+        TCase *test_case = tcase_create("Hash");
+        tcase_add_test(test_case, test_hash_vectors);
+        tcase_add_test(test_case, test_hash_update);
+        return test_case;
+}
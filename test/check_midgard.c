@@ -25,6 +25,8 @@
 #include "check_midgard_timestamp.h"
 #include "check_uuid.h"
 #include "check_guid.h"
+#include "check_base64.h"
+#include "check_hash.h"
 
 /**
  * Test case for verifying the correct functioning of the
@@ -70,6 +72,8 @@ Suite *midgard_suite(void) {
         suite_add_tcase(s, midgard_uuid_test_case());
         suite_add_tcase(s, midgard_guid_test_case());
         suite_add_tcase(s, midgard_timestamp_test_case());
+        suite_add_tcase(s, midgard_base64_test_case());
+        suite_add_tcase(s, midgard_hash_test_case());
 
         return s;
 }
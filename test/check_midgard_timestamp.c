@@ -53,10 +53,39 @@ START_TEST(test_iso8601)
 }
 END_TEST
 
+START_TEST(test_format)
+{
+        gchar buf[MIDGARD_TIMESTAMP_BUFFER_SIZE];
+        GValue *value = g_new0(GValue, 1);
+        g_value_init(value, MIDGARD_TYPE_TIMESTAMP);
+        midgard_timestamp_set_string(value, "2005-09-15 11:46:00+0300");
+        fail_unless(midgard_timestamp_format(value, buf) == 24, NULL);
+        fail_unless(strcmp(buf, "2005-09-15 08:46:00+0000") == 0, "%s", buf);
+        midgard_timestamp_set_string(value, "2005-09-15T11:46:00-0030");
+        midgard_timestamp_format(value, buf);
+        fail_unless(strcmp(buf, "2005-09-15 12:16:00+0000") == 0, "%s", buf);
+        midgard_timestamp_set_string(value, "2005-09-15 11:46+0000");
+        midgard_timestamp_format(value, buf);
+        fail_unless(strcmp(buf, "2005-09-15 11:46:00+0000") == 0, "%s", buf);
+        midgard_timestamp_set_string(value, "2005-09-15 11:46:00");
+        midgard_timestamp_format(value, buf);
+        fail_unless(strcmp(buf, "2005-09-15 11:46:00+0000") == 0, "%s", buf);
+        midgard_timestamp_set_string(value, "2005-09-15 11:46");
+        midgard_timestamp_format(value, buf);
+        fail_unless(strcmp(buf, "2005-09-15 11:46:00+0000") == 0, "%s", buf);
+        midgard_timestamp_set_string(value, "2005-09-15 11:46:00x");
+        fail_unless(midgard_timestamp_get_time(value) == 0, NULL);
+        midgard_timestamp_set_string(value, "0999-12-31 23:59:59+0000");
+        midgard_timestamp_format(value, buf);
+        fail_unless(strcmp(buf, "999-12-31 23:59:59+0000") == 0, "%s", buf);
+}
+END_TEST
+
 TCase *midgard_timestamp_test_case(void) {
         TCase *tc = tcase_create("midgard_timestamp");
         tcase_add_test(tc, test_init);
         tcase_add_test(tc, test_time);
         tcase_add_test(tc, test_iso8601);
+        tcase_add_test(tc, test_format);
         return tc;
 }
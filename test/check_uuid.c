@@ -15,6 +15,7 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
+#include <string.h>
 #include "check_uuid.h"
 #include "midgard/uuid.h"
 
@@ -45,6 +46,23 @@ START_TEST(test_uuid_new)
 }
 END_TEST
 
+START_TEST(test_uuid_generate)
+{
+        gchar uuid[MIDGARD_UUID_BUFFER_SIZE];
+        GHashTable *uuids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        guint i;
+        for (i = 0; i < 10000; i++) {
+                midgard_uuid_generate(uuid);
+                fail_unless(midgard_is_uuid(uuid), "midgard_is_uuid(%s)", uuid);
+                fail_unless(uuid[14] == '1', "version of %s", uuid);
+                fail_unless(strchr("89ab", uuid[19]) != NULL, "variant of %s", uuid);
+                fail_if(g_hash_table_lookup(uuids, uuid) != NULL, "duplicate %s", uuid);
+                g_hash_table_insert(uuids, g_strdup(uuid), GINT_TO_POINTER(TRUE));
+        }
+        g_hash_table_destroy(uuids);
+}
+END_TEST
+
 START_TEST(test_uuid_external)
 {
         static const char *test_uuid = "fa51e40a-898b-3a10-a49f-d79121aa4ca5";
@@ -70,6 +88,7 @@ TCase *midgard_uuid_test_case(void) {
         TCase *test_case = tcase_create("UUID");
         tcase_add_test(test_case, test_is_uuid);
         tcase_add_test(test_case, test_uuid_new);
+        tcase_add_test(test_case, test_uuid_generate);
         tcase_add_test(test_case, test_uuid_external);
         return test_case;
 }
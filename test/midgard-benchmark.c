@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2009 Piotr Pokora <piotrek.pokora@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include "midgard/midgard.h"
+#include "midgard/midgard_config_auto.h"
+#include "midgard/pageresolve.h"
+#include "midgard/midgard_timestamp.h"
+#include "midgard/uuid.h"
+#include "midgard_core_base64.h"
+#include "midgard_core_hash.h"
+
+static gchar *benchmark = NULL;
+static gint iterations = 100;
+static gchar *schema_file = NULL;
+static gchar *cache_dir = NULL;
+static gint data_size = 4;
+static gint threads = 4;
+
+static GOptionEntry entries[] =
+{
+	{ "benchmark", 'b', 0,
+		G_OPTION_ARG_STRING, &benchmark,
+		"Benchmark to run, all by default. Try --list", "NAME" },
+	{ "iterations", 'n', 0,
+		G_OPTION_ARG_INT, &iterations,
+		"Number of iterations", "N" },
+	{ "schema", 's', 0,
+		G_OPTION_ARG_FILENAME, &schema_file,
+		"Schema file read by schema benchmark", "FILE" },
+	{ "cache-dir", 'd', 0,
+		G_OPTION_ARG_FILENAME, &cache_dir,
+		"Directory for compiled schema cache", "DIR" },
+	{ "data-size", 'm', 0,
+		G_OPTION_ARG_INT, &data_size,
+		"Megabytes of data used by base64 and hash benchmarks", "MB" },
+	{ "threads", 't', 0,
+		G_OPTION_ARG_INT, &threads,
+		"Number of threads used by uuid benchmark", "N" },
+	{ NULL }
+};
+
+static void __report(const gchar *name, gdouble seconds)
+{
+	g_print("%-32s %10.3f ms total %12.3f us/iteration\n",
+			name, seconds * 1000, seconds * 1000000 / iterations);
+}
+
+/* SCHEMA */
+
+static gdouble __schema_read(const gchar *file)
+{
+	GTimer *timer = g_timer_new();
+	gint i;
+
+	for(i = 0; i < iterations; i++) {
+
+		/* Do not destroy schema, registered classes share its data */
+		MidgardSchema *schema = g_object_new(MIDGARD_TYPE_SCHEMA, NULL);
+		midgard_schema_read_file(schema, file);
+	}
+
+	gdouble elapsed = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+
+	return elapsed;
+}
+
+static void __benchmark_schema(void)
+{
+	const gchar *file = schema_file ? schema_file : MIDGARD_GLOBAL_SCHEMA;
+	gchar *dir = cache_dir ? g_strdup(cache_dir) :
+		g_build_filename(g_get_tmp_dir(), "midgard-benchmark", NULL);
+
+	/* Register classes first, so only schema reading is measured */
+	midgard_schema_set_cache_dir(NULL);
+	__schema_read(file);
+
+	__report("schema (xml)", __schema_read(file));
+
+	/* First read writes cache */
+	midgard_schema_set_cache_dir(dir);
+	MidgardSchema *schema = g_object_new(MIDGARD_TYPE_SCHEMA, NULL);
+	midgard_schema_read_file(schema, file);
+
+	__report("schema (cache)", __schema_read(file));
+
+	g_free(dir);
+}
+
+/* PREPARSE */
+
+static const gchar *preparse_buffer =
+	"<html><head><title>&(title);</title></head>\n"
+	"<body>\n<(header)>\n"
+	"<?php foreach ($items as $item) { ?>\n"
+	"<li>&(item.title:h); &(item.date:F);</li>\n"
+	"<?php } ?>\n"
+	"<[content]>\n<(footer)>\n</body></html>\n";
+
+static void __preparse_output(char *buffer, int len, void *userdata)
+{
+	*((gsize *) userdata) += len;
+}
+
+static const char *__preparse_element(const char *name, GHashTable *table)
+{
+	return g_hash_table_lookup(table, name);
+}
+
+static gdouble __preparse(mgd_parser_itf_t *itf)
+{
+	GTimer *timer = g_timer_new();
+	gint i;
+
+	for(i = 0; i < iterations; i++)
+		mgd_preparse_buffer(preparse_buffer, itf);
+
+	gdouble elapsed = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+
+	return elapsed;
+}
+
+static void __benchmark_preparse(void)
+{
+	gsize written = 0;
+	mgd_parser_itf_t itf;
+	GHashTable *table = g_hash_table_new(g_str_hash, g_str_equal);
+
+	g_hash_table_insert(table, "header", "<h1>&(title:h);</h1>\n<(menu)>");
+	g_hash_table_insert(table, "menu", "<ul><?php echo $menu; ?></ul>");
+	g_hash_table_insert(table, "footer", "<p>&(author.name:h);</p>");
+
+	itf.output.func = __preparse_output;
+	itf.output.userdata = &written;
+	itf.get_element.func = __preparse_element;
+	itf.get_element.userdata = table;
+
+	mgd_preparse_cache_set_size(0);
+	__report("preparse (lexer)", __preparse(&itf));
+
+	mgd_preparse_cache_set_size(MGD_PREPARSE_CACHE_DEFAULT_SIZE);
+	mgd_preparse_reset_stats();
+	__report("preparse (cache)", __preparse(&itf));
+
+	mgd_preparse_stats_t stats;
+	mgd_preparse_get_stats(&stats);
+	g_print("preparse cache: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses\n",
+			stats.hits, stats.misses);
+
+	g_hash_table_destroy(table);
+}
+
+/* BASE64 */
+
+static void __report_throughput(const gchar *name, gdouble seconds, gsize bytes)
+{
+	__report(name, seconds);
+	g_print("%-32s %10.1f MB/s\n", "", (gdouble) bytes * iterations / seconds / (1024 * 1024));
+}
+
+static void __benchmark_base64(void)
+{
+	const struct {
+		MgdBase64Impl impl;
+		const gchar *encode;
+		const gchar *decode;
+	} impls[] = {
+		{ MGD_BASE64_SCALAR, "base64 encode (scalar)", "base64 decode (scalar)" },
+		{ MGD_BASE64_SSSE3, "base64 encode (ssse3)", "base64 decode (ssse3)" },
+		{ MGD_BASE64_AVX2, "base64 encode (avx2)", "base64 decode (avx2)" }
+	};
+	gsize len = (gsize) data_size * 1024 * 1024;
+	guchar *data = g_malloc(len);
+	GRand *rand = g_rand_new_with_seed(0);
+	guint i;
+	gint j;
+
+	for(i = 0; i < len; i++)
+		data[i] = g_rand_int_range(rand, 0, 256);
+
+	g_rand_free(rand);
+
+	for(i = 0; i < G_N_ELEMENTS(impls); i++) {
+
+		if(!_midgard_core_base64_set_impl(impls[i].impl)) {
+			g_print("%-32s not supported by CPU\n", impls[i].encode);
+			continue;
+		}
+
+		gchar *encoded = NULL;
+		GTimer *timer = g_timer_new();
+
+		for(j = 0; j < iterations; j++) {
+			g_free(encoded);
+			encoded = _midgard_core_base64_encode(data, len);
+		}
+
+		__report_throughput(impls[i].encode, g_timer_elapsed(timer, NULL), len);
+
+		gsize enclen = strlen(encoded);
+		gsize declen = 0;
+		guchar *decoded = NULL;
+
+		g_timer_start(timer);
+
+		for(j = 0; j < iterations; j++) {
+			g_free(decoded);
+			decoded = _midgard_core_base64_decode(encoded, enclen, &declen);
+		}
+
+		__report_throughput(impls[i].decode, g_timer_elapsed(timer, NULL), len);
+
+		if(declen != len || memcmp(decoded, data, len) != 0)
+			g_print("%-32s decoded data differs\n", impls[i].decode);
+
+		g_timer_destroy(timer);
+		g_free(encoded);
+		g_free(decoded);
+	}
+
+	_midgard_core_base64_set_impl(MGD_BASE64_AUTO);
+	g_free(data);
+}
+
+/* Timestamps parsed and formatted in every iteration */
+#define BENCHMARK_TIMESTAMPS 1000
+
+static void __benchmark_timestamp(void)
+{
+	GValue tval = {0, };
+	gchar buf[MIDGARD_TIMESTAMP_BUFFER_SIZE];
+	gchar **strings = g_new(gchar *, BENCHMARK_TIMESTAMPS);
+	guint i, j;
+
+	g_value_init(&tval, MIDGARD_TYPE_TIMESTAMP);
+
+	for(i = 0; i < BENCHMARK_TIMESTAMPS; i++) {
+		midgard_timestamp_set_time(&tval, 1234567890 + i * 86461);
+		strings[i] = midgard_timestamp_dup_string(&tval);
+	}
+
+	GTimer *timer = g_timer_new();
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; j < BENCHMARK_TIMESTAMPS; j++)
+			midgard_timestamp_set_string(&tval, strings[j]);
+	}
+	__report("timestamp (parse)", g_timer_elapsed(timer, NULL));
+
+	/* MySQL datetime layout, without offset */
+	for(i = 0; i < BENCHMARK_TIMESTAMPS; i++)
+		strings[i][19] = '\0';
+
+	g_timer_start(timer);
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; j < BENCHMARK_TIMESTAMPS; j++)
+			midgard_timestamp_set_string(&tval, strings[j]);
+	}
+	__report("timestamp (parse datetime)", g_timer_elapsed(timer, NULL));
+
+	g_timer_start(timer);
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; j < BENCHMARK_TIMESTAMPS; j++)
+			g_free(midgard_timestamp_dup_string(&tval));
+	}
+	__report("timestamp (dup_string)", g_timer_elapsed(timer, NULL));
+
+	g_timer_start(timer);
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; j < BENCHMARK_TIMESTAMPS; j++)
+			midgard_timestamp_format(&tval, buf);
+	}
+	__report("timestamp (format)", g_timer_elapsed(timer, NULL));
+
+	g_timer_destroy(timer);
+	g_value_unset(&tval);
+
+	for(i = 0; i < BENCHMARK_TIMESTAMPS; i++)
+		g_free(strings[i]);
+	g_free(strings);
+}
+
+
+/* UUIDs generated by every thread in every iteration */
+#define BENCHMARK_UUIDS 1000
+
+static gpointer __uuid_new_thread(gpointer data)
+{
+	guint i, j;
+
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; j < BENCHMARK_UUIDS; j++)
+			g_free(midgard_uuid_new());
+	}
+
+	return NULL;
+}
+
+static gpointer __uuid_generate_thread(gpointer data)
+{
+	gchar uuid[MIDGARD_UUID_BUFFER_SIZE];
+	guint i, j;
+
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; j < BENCHMARK_UUIDS; j++)
+			midgard_uuid_generate(uuid);
+	}
+
+	return NULL;
+}
+
+static void __uuid_run(const gchar *name, GThreadFunc func, gint n_threads)
+{
+	GThread **pool = g_new(GThread *, n_threads);
+	gint i;
+
+	GTimer *timer = g_timer_new();
+
+	for(i = 0; i < n_threads; i++) {
+#if GLIB_CHECK_VERSION(2,32,0)
+		pool[i] = g_thread_new("uuid", func, NULL);
+#else
+		pool[i] = g_thread_create(func, NULL, TRUE, NULL);
+#endif
+	}
+
+	for(i = 0; i < n_threads; i++)
+		g_thread_join(pool[i]);
+
+	gdouble seconds = g_timer_elapsed(timer, NULL);
+	g_timer_destroy(timer);
+	g_free(pool);
+
+	gchar *label = g_strdup_printf("%s (%d threads)", name, n_threads);
+	__report(label, seconds);
+	g_print("%-32s %10.0f UUIDs/s\n", "", 
+			(gdouble) n_threads * iterations * BENCHMARK_UUIDS / seconds);
+	g_free(label);
+}
+
+static void __benchmark_uuid(void)
+{
+#if !GLIB_CHECK_VERSION(2,32,0)
+	if(!g_thread_supported())
+		g_thread_init(NULL);
+#endif
+
+	__uuid_run("uuid new", __uuid_new_thread, 1);
+	__uuid_run("uuid generate", __uuid_generate_thread, 1);
+
+	if(threads > 1) {
+		__uuid_run("uuid new", __uuid_new_thread, threads);
+		__uuid_run("uuid generate", __uuid_generate_thread, threads);
+	}
+}
+
+
+/* HASH */
+
+/* Short keys hashed in every iteration, like cache keys and guids */
+#define BENCHMARK_HASH_KEYS 1000
+
+static void __benchmark_hash(void)
+{
+	const struct {
+		MgdHashType type;
+		const gchar *data;
+		const gchar *keys;
+	} types[] = {
+		{ MGD_HASH_MD5, "hash data (md5)", "hash keys (md5)" },
+		{ MGD_HASH_XXH64, "hash data (xxh64)", "hash keys (xxh64)" }
+	};
+	gsize len = (gsize) data_size * 1024 * 1024;
+	guchar *data = g_malloc(len);
+	guchar digest[MGD_HASH_MAX_LENGTH];
+	GRand *rand = g_rand_new_with_seed(0);
+	guint i, k;
+	gint j;
+
+	for(i = 0; i < len; i++)
+		data[i] = g_rand_int_range(rand, 0, 256);
+
+	g_rand_free(rand);
+
+	for(i = 0; i < G_N_ELEMENTS(types); i++) {
+
+		GTimer *timer = g_timer_new();
+
+		for(j = 0; j < iterations; j++)
+			_midgard_core_hash_digest(types[i].type, data, len, digest);
+
+		__report_throughput(types[i].data, g_timer_elapsed(timer, NULL), len);
+
+		g_timer_start(timer);
+
+		for(j = 0; j < iterations; j++) {
+			for(k = 0; k < BENCHMARK_HASH_KEYS; k++)
+				_midgard_core_hash_digest(types[i].type, data + k, 32, digest);
+		}
+
+		__report(types[i].keys, g_timer_elapsed(timer, NULL));
+
+		g_timer_destroy(timer);
+	}
+
+	g_free(data);
+}
+
+
+typedef struct {
+	const gchar *name;
+	void (*func) (void);
+	const gchar *description;
+} MidgardBenchmark;
+
+static MidgardBenchmark benchmarks[] =
+{
+	{ "schema", __benchmark_schema,
+		"Read schema file from xml and compiled cache" },
+	{ "preparse", __benchmark_preparse,
+		"Preparse style elements with and without output cache" },
+	{ "base64", __benchmark_base64,
+		"Encode and decode blob data with every base64 implementation" },
+	{ "timestamp", __benchmark_timestamp,
+		"Parse and format 1000 timestamps" },
+	{ "uuid", __benchmark_uuid,
+		"Generate 1000 UUIDs in one and in many threads" },
+	{ "hash", __benchmark_hash,
+		"Hash blob data and 1000 short keys with md5 and xxh64" },
+	{ NULL, NULL, NULL }
+};
+
+int
+main (int argc, char **argv)
+{
+	GError *error = NULL;
+	gboolean list = FALSE;
+	guint i;
+
+	GOptionEntry list_entries[] =
+	{
+		{ "list", 'l', 0,
+			G_OPTION_ARG_NONE, &list,
+			"List available benchmarks", NULL },
+		{ NULL }
+	};
+
+	GOptionContext *context = g_option_context_new ("- run midgard-core benchmarks");
+	g_option_context_add_main_entries (context, entries, "midgard-benchmark");
+	g_option_context_add_main_entries (context, list_entries, "midgard-benchmark");
+
+	if(!g_option_context_parse (context, &argc, &argv, &error)) {
+
+		g_print("%s. Try --help \n", error->message);
+		return(1);
+	}
+
+	if(list) {
+
+		for(i = 0; benchmarks[i].name != NULL; i++)
+			g_print("%-16s %s\n", benchmarks[i].name, benchmarks[i].description);
+		return(0);
+	}
+
+	if(iterations < 1) {
+
+		g_print("Invalid number of iterations. Try --help \n");
+		return(1);
+	}
+
+	if(data_size < 1) {
+
+		g_print("Invalid data size. Try --help \n");
+		return(1);
+	}
+
+	if(threads < 1) {
+
+		g_print("Invalid number of threads. Try --help \n");
+		return(1);
+	}
+
+	midgard_init();
+
+	gboolean found = FALSE;
+	for(i = 0; benchmarks[i].name != NULL; i++) {
+
+		if(benchmark && !g_str_equal(benchmark, benchmarks[i].name))
+			continue;
+
+		found = TRUE;
+		benchmarks[i].func();
+	}
+
+	if(!found) {
+
+		g_print("Unknown benchmark '%s'. Try --list \n", benchmark);
+		return(1);
+	}
+
+	g_option_context_free(context);
+
+	return(0);
+}